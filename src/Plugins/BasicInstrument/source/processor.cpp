@@ -13,6 +13,9 @@
 
 #include <public.sdk/source/vst/vstaudioprocessoralgo.h>
 #include <vstmath.h>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
 
 namespace Uberton {
 namespace BasicInstrument {
@@ -41,10 +44,14 @@ tresult PLUGIN_API Processor::initialize(FUnknown* context) {
 }
 
 tresult PLUGIN_API Processor::setupProcessing(ProcessSetup& setup) {
-	osc.setSampleRate(setup.sampleRate);
 	resonator.setSampleRate(setup.sampleRate);
-	resonator.setInputPositions({ .3 });
+	const Resonator::SpaceVec inputPosition{ .3 };
+	resonator.setInputPositions({ inputPosition });
+	resonator.strikeVector(inputPosition, noteOnStrike.data());
 	resonator.setOutputPositions({ .7 });
+	for (auto& exciter : exciters) {
+		exciter.setSampleRate(setup.sampleRate);
+	}
 	return ProcessorBase::setupProcessing(setup);
 }
 
@@ -56,12 +63,19 @@ void Processor::processAudio(ProcessData& data) {
 	float volume = paramState.params[kParamVol];
 
 	if (playing) {
-		for (int32 i = 0; i < numSamples; i++) {
-			float sample = osc.get();
-			sample = resonator.next()[0];
-
-			for (int32 channel = 0; channel < numChannels; channel++) {
-				out[channel][i] = sample * volume;
+		for (int32 start = 0; start < numSamples; start += excitationBlockSize) {
+			const int32 length = std::min<int32>(excitationBlockSize, numSamples - start);
+			renderExcitation(length);
+			for (int32 i = 0; i < length; i++) {
+				for (int voice = 0; voice < numVoices; voice++) {
+					resonator.strike(voice, noteOnStrike.data(), excitation[voice][i]); // skips zeros
+				}
+				const auto voiceSamples = resonator.next()[0];
+				const float sample = std::accumulate(voiceSamples.begin(), voiceSamples.end(), 0.f);
+
+				for (int32 channel = 0; channel < numChannels; channel++) {
+					out[channel][start + i] = sample * volume;
+				}
 			}
 		}
 	}
@@ -88,13 +102,15 @@ void Processor::processParameterChanges(IParameterChanges* inputParameterChanges
 void Processor::processEvents(IEventList* eventList) {
 	Algo::foreach (eventList, [&](const Event& event) {
 		switch (event.type) {
-		case Event::kNoteOnEvent:
+		case Event::kNoteOnEvent: {
 			playing = true;
-			osc.setPhase(0.0);
-			osc.setFrequency(Math::frequencyTable[event.noteOn.pitch]);
-			resonator.setFreqDampeningAndVelocity(Math::frequencyTable[event.noteOn.pitch], .1, 10);
-			resonator.delta({ .5 });
+			const int voice = nextVoice;
+			nextVoice = (nextVoice + 1) % numVoices;
+			resonator.clearVoice(voice);
+			resonator.setVoiceFreqDampeningAndVelocity(voice, Math::frequencyTable[event.noteOn.pitch], .1, 10);
+			startExcitation(voice, Math::frequencyTable[event.noteOn.pitch], .5);
 			break;
+		}
 		case Event::kNoteOffEvent:
 			//playing = false;
 
@@ -105,6 +121,30 @@ void Processor::processEvents(IEventList* eventList) {
 	});
 }
 
+void Processor::startExcitation(int voice, float frequency, float amount) {
+	const double period = processSetup.sampleRate / frequency; // in samples
+	excitationLeft[voice] = std::max(1, static_cast<int>(std::lround(.5 * period)));
+	// sampled at the middle of each sample, the sum is period/2pi * 16/15 (the integral of sin^5 over half a period)
+	excitationGain[voice] = static_cast<float>(amount * 15. * Math::pi<double>() / (8. * period));
+	exciters[voice].setFrequency(frequency);
+	exciters[voice].setPhase(Math::pi<double>() / period);
+}
+
+void Processor::renderExcitation(int n) {
+	for (int voice = 0; voice < numVoices; voice++) {
+		float* samples = excitation[voice].data();
+		const int length = std::min(n, excitationLeft[voice]);
+		if (length > 0) {
+			exciters[voice].render(samples, length);
+			for (int i = 0; i < length; i++) {
+				samples[i] *= excitationGain[voice];
+			}
+			excitationLeft[voice] -= length;
+		}
+		std::fill(samples + length, samples + n, 0.f);
+	}
+}
+
 tresult PLUGIN_API Processor::setBusArrangements(SpeakerArrangement* inputs, int32 numIns, SpeakerArrangement* outputs, int32 numOuts) {
 	// one stereo output bus
 	if (numIns == 0 && numOuts == 1 && outputs[0] == SpeakerArr::kStereo) {
@@ -33,13 +33,29 @@ public:
 	void processEvents(IEventList* eventList) override;
 	void processParameterChanges(IParameterChanges* parameterChanges) override;
 
+	/// Start the note-on excitation of voice: half a period of sin^5 at the note frequency,
+	/// i.e. a mallet whose contact time follows the pitch, with the same area as a strike of amount
+	void startExcitation(int voice, float frequency, float amount);
+	/// Render the next n <= excitationBlockSize samples of the excitation of all voices
+	void renderExcitation(int n);
+
 	static FUnknown* createInstance(void*) { return (Vst::IAudioProcessor*)new Processor(); }
 
 
 protected:
+	static constexpr int numVoices = 4;
+
 	bool playing{ false };
-	SineOscillatorPow5 osc;
-	Math::CubeResonator<float, 1, 5, 1> resonator;
+	int nextVoice{ 0 }; // voices are (re)triggered round robin
+	using Resonator = Math::CubeResonatorVoiceBank<float, 1, 5, 1, numVoices>;
+	Resonator resonator;
+	std::array<Resonator::scalar, Resonator::maxOrder()> noteOnStrike{}; // strike vector at the input position
+
+	static constexpr int excitationBlockSize = 64;
+	std::array<QuadratureSinePow5Oscillator, numVoices> exciters;
+	std::array<int, numVoices> excitationLeft{}; // samples of the pulse still to come
+	std::array<float, numVoices> excitationGain{};
+	std::array<std::array<float, excitationBlockSize>, numVoices> excitation{};
 };
 
 }
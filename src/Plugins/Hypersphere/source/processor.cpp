@@ -56,6 +56,7 @@ tresult PLUGIN_API Processor::setActive(TBool state) {
 		}
 		processorImpl->init(processSetup.sampleRate);
 		recomputeParameters();
+		processorImpl->preparePositions(); // cheap if the positions are in the eigenfunction cache already
 	} else {
 		processorImpl.reset();
 		sendMessageID(processorDeactivatedMsgID);
@@ -36,12 +36,19 @@ private:
 template<class Resonator, typename SampleType, int numChannels = 2>
 class SphereProcessorImpl : public ProcessorImpl<Resonator, SampleType, numChannels>
 {
+	using SpaceVec = typename ProcessorImpl<Resonator, SampleType, numChannels>::SpaceVec;
+	using PositionVecArr = typename ProcessorImpl<Resonator, SampleType, numChannels>::PositionVecArr;
+
 	void updateCompensation() override {
 		volumeCompensation = 1.0 / resonator.getDim();
 	}
 
+	// Sets the new positions, they are ramped to and cached like in ProcessorImpl. Only the
+	// coordinates differ: r in [0,4], φ in [0,2π] and θ_i in [ε,π-ε].
 	void updateResonatorInputPosition(const ParamState& paramState) override {
-		PositionVecArr inputPositions;
+		this->inCurveChanged = true;
+		resonatorChanged();
+		PositionVecArr& inputPositions = this->newInputPositions;
 		auto d = inputPositions[0].size();
 
 		auto resultVec = [&](ParamID firstId, SpaceVec& output) {
@@ -66,19 +73,15 @@ class SphereProcessorImpl : public ProcessorImpl<Resonator, SampleType, numChann
 		//if constexpr (numChannels > 1)
 		//	inputPositions[1] += inputPosSpaceCurveSphere(paramState[Params::kParamInPosCurveR]);
 
-		//clamping
-		constexpr SampleType eps = 1e-5;
-		constexpr SampleType piMinusEps = Math::pi<SampleType>() - eps;
-		for (size_t i = 2; i < d; i++) {
-			inputPositions[0][i] = std::max(eps, std::min(piMinusEps, inputPositions[0][i]));
-			if constexpr (numChannels > 1)
-				inputPositions[1][i] = std::max(eps, std::min(piMinusEps, inputPositions[1][i]));
-		}
-		resonator.setInputPositions(inputPositions);
+		this->clampPosition(inputPositions[0]);
+		if constexpr (numChannels > 1)
+			this->clampPosition(inputPositions[1]);
 	}
 
 	void updateResonatorOutputPosition(const ParamState& paramState) override {
-		PositionVecArr outputPositions;
+		this->outCurveChanged = true;
+		resonatorChanged();
+		PositionVecArr& outputPositions = this->newOutputPositions;
 		auto d = outputPositions[0].size();
 
 		auto resultVec = [&](ParamID firstId, SpaceVec& output) {
@@ -103,15 +106,21 @@ class SphereProcessorImpl : public ProcessorImpl<Resonator, SampleType, numChann
 		//if constexpr (numChannels > 1)
 		//	outputPositions[1] += outputPosSpaceCurveSphere(paramState[Params::kParamOutPosCurveR]);
 
-		//clamping
+		this->clampPosition(outputPositions[0]);
+		if constexpr (numChannels > 1)
+			this->clampPosition(outputPositions[1]);
+	}
+
+	// r in [0,4], θ_i in [ε,π-ε] (the eigenfunctions are singular at the poles), φ is periodic
+	void clampPosition(SpaceVec& x) const override {
 		constexpr SampleType eps = 1e-5;
 		constexpr SampleType piMinusEps = Math::pi<SampleType>() - eps;
-		for (size_t i = 2; i < d; i++) {
-			outputPositions[0][i] = std::max(eps, std::min(piMinusEps, outputPositions[0][i]));
-			if constexpr (numChannels > 1)
-				outputPositions[1][i] = std::max(eps, std::min(piMinusEps, outputPositions[1][i]));
+		const SampleType rMin = ParamSpecs::resonatorInputRCoordinate.toScaled(0);
+		const SampleType rMax = ParamSpecs::resonatorInputRCoordinate.toScaled(1);
+		x[0] = std::max(rMin, std::min(rMax, x[0]));
+		for (size_t i = 2; i < x.size(); i++) {
+			x[i] = std::max(eps, std::min(piMinusEps, x[i]));
 		}
-		resonator.setOutputPositions(outputPositions);
 	}
 
 protected:
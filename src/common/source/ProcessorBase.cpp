@@ -18,6 +18,7 @@ namespace Uberton {
 ProcessorBaseA::ProcessorBaseA() {}
 
 tresult PLUGIN_API ProcessorBaseA::process(ProcessData& data) {
+	ProcessorUtilities::DenormalScope denormalScope;
 	processParameterChanges(data.inputParameterChanges);
 	processEvents(data.inputEvents);
 
@@ -99,18 +100,13 @@ bool ProcessorBaseA::bypassProcessing(ProcessData& data) {
 }
 
 void ProcessorBaseA::checkSilence(ProcessData& data) {
+	const auto& kernels = Simd::kernels<float>();
 	for (int32 i = 0; i < data.numOutputs; i++) {
 		auto& bus = data.outputs[i];
 		bus.silenceFlags = 0;
 		if (!getAudioOutput(i)->isActive()) continue;
 		for (int32 ch = 0; ch < bus.numChannels; ch++) {
-			bool isSilent = true;
-			for (int32 sample = 0; sample < data.numSamples; sample += 20) {
-				if (std::abs(bus.channelBuffers32[ch][sample]) > 0.0001) {
-					isSilent = false;
-					break;
-				}
-			}
+			const bool isSilent = !kernels.exceeds(bus.channelBuffers32[ch], data.numSamples, 0.0001f);
 			if (isSilent) {
 				bus.silenceFlags |= (uint64)1 << ch;
 			}
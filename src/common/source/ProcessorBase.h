@@ -19,6 +19,8 @@
 #include <public.sdk/source/vst/vstaudioprocessoralgo.h>
 #include <public.sdk/source/vst/utility/rttransfer.h>
 #include "parameters.h"
+#include "processor_utilities.h"
+#include "simd.h"
 
 
 namespace Uberton {
@@ -30,6 +32,7 @@ using namespace Steinberg::Vst;
  *
  * - Only one bus (with any number of channels) and equal input / output numbers are allowed.
  * - Implements bypass ramping(ramp over one sample buffer)
+ * - Denormals are flushed to zero during process()
  */
 class ProcessorBaseA : public AudioEffect
 {
@@ -69,10 +72,11 @@ private:
 /*
  * Processor base class that uses some kind of global parameter state with specifications
  * as described in parameters.h.
- * The plugins setState/getState functions uses the corresponding functions of ParamState.
+ * The plugins setState/getState functions uses the corresponding functions of ParamState,
+ * a loaded state is applied with assignLoaded().
  * A ramped bypass can be implemented but is only advised for Fx plugins with one bus and
  * as many inputs as outputs. The ParamState class has to provide the actual bypass parameter
- * state.
+ * state. Denormals are flushed to zero during process().
  */
 template<class ParamState, bool hasBypass = ImplementBypass>
 // requires requires (ParamState p, IBStream* stream, EditController& controller, bool b, int i) {
@@ -82,6 +86,7 @@ template<class ParamState, bool hasBypass = ImplementBypass>
 //	{ p[i] } -> std::convertible_to<double>;
 //	{ p.isBypassed() } -> std::convertible_to<bool>;
 //	p.setBypass(b);
+//	p.assignLoaded(p);
 // }
 class ProcessorBase;
 
@@ -112,19 +117,16 @@ public:
 	virtual void processEvents(IEventList* eventList) {}
 	virtual void beforeBypass(ProcessData& data){}; // called during process() when bypass has been activated, before the off ramp is started
 
+	// Every sample is checked (with the vector kernels this is cheaper than the former scan of
+	// every 20th sample), so short clicks in between are not flagged as silence
 	void checkSilence(ProcessData& data) {
+		const auto& kernels = Simd::kernels<float>();
 		for (int32 i = 0; i < data.numOutputs; i++) {
 			auto& bus = data.outputs[i];
 			bus.silenceFlags = 0;
 			if (!getAudioOutput(i)->isActive()) continue;
 			for (int32 ch = 0; ch < bus.numChannels; ch++) {
-				bool isSilent = true;
-				for (int32 sample = 0; sample < data.numSamples; sample += 20) {
-					if (std::abs(bus.channelBuffers32[ch][sample]) > 0.0001) {
-						isSilent = false;
-						break;
-					}
-				}
+				const bool isSilent = !kernels.exceeds(bus.channelBuffers32[ch], data.numSamples, 0.0001f);
 				if (isSilent) {
 					bus.silenceFlags |= (uint64)1 << ch;
 				}
@@ -178,8 +180,9 @@ class ProcessorBase<ParamState, ImplementBypass> : public ProcessorBaseCommon<Pa
 {
 public:
 	tresult PLUGIN_API process(ProcessData& data) SMTG_OVERRIDE {
+		ProcessorUtilities::DenormalScope denormalScope;
 		this->stateTransfer.accessTransferObject_rt([this](const ParamState& stateChanges) {
-			this->paramState = stateChanges;
+			this->paramState.assignLoaded(stateChanges); // older states lack the newest parameters
 		});
 		this->processParameterChanges(data.inputParameterChanges);
 		this->processEvents(data.inputEvents);
@@ -278,8 +281,9 @@ class ProcessorBase<ParamState, NoBypass> : public ProcessorBaseCommon<ParamStat
 {
 public:
 	tresult PLUGIN_API process(ProcessData& data) SMTG_OVERRIDE {
+		ProcessorUtilities::DenormalScope denormalScope;
 		this->stateTransfer.accessTransferObject_rt([this](const ParamState& stateChanges) {
-			this->paramState = stateChanges;
+			this->paramState.assignLoaded(stateChanges); // older states lack the newest parameters
 		});
 		this->processParameterChanges(data.inputParameterChanges);
 		this->processEvents(data.inputEvents);
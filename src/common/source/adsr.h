@@ -15,6 +15,8 @@
 
 #pragma once
 
+#include <algorithm>
+
 namespace Uberton {
 // ADSR evenlope with quadratic attack, decay and release curves:
 //     .
@@ -67,20 +69,44 @@ public:
 		if (constant) return value;
 		value += c0 * (a0 - 1.0 - index);
 		if (++index == nextBreak) {
-			if (nextBreak == attackEnd) { // finished attack period
-				c0 = cd;
-				a0 = decayEnd;
-				nextBreak = decayEnd;
-			} else if (nextBreak == decayEnd) { // finished decay period
-				constant = true;
-			} else if (nextBreak == releaseEnd) { // finished release period
-				value = 0;
-				constant = true;
-			}
+			finishPeriod();
 		}
 		return value;
 	}
 
+	// Fill a whole block with the next n values, the same as static_cast<float>(next()) n times up
+	// to rounding (checked by the adsr_render tool). Within a period the value m samples ahead is
+	// the sum of the increments c0·(a0 - 1 - k) of next() in closed form
+	//     value(m) = value + c0·[m·(a0 - 1 - index) - m(m-1)/2]
+	// which has no dependency between samples and is thus vectorized by the compiler. The block
+	// is only split at period breakpoints and constant periods are a plain fill.
+	void render(float* out, int n) noexcept {
+		int i = 0;
+		while (i < n) {
+			if (constant) {
+				std::fill(out + i, out + n, static_cast<float>(value));
+				return;
+			}
+			int length = nextBreak - index;
+			if (length <= 0 || length > n - i) length = n - i;
+
+			const double v0 = value;
+			const double slope = a0 - 1.0 - index;
+			float* segment = out + i;
+			for (int m = 1; m <= length; m++) {
+				const double dm = m;
+				segment[m - 1] = static_cast<float>(v0 + c0 * dm * (slope - 0.5 * (dm - 1.0)));
+			}
+			value = v0 + c0 * length * (slope - 0.5 * (length - 1.0));
+			index += length;
+			i += length;
+			if (index == nextBreak) {
+				finishPeriod();
+				if (constant) out[i - 1] = static_cast<float>(value); // release may have set value to 0
+			}
+		}
+	}
+
 
 	bool hasReachedSustain() const noexcept {
 		return index == decayEnd;
@@ -92,6 +118,19 @@ public:
 
 
 private:
+	void finishPeriod() noexcept {
+		if (nextBreak == attackEnd) { // finished attack period
+			c0 = cd;
+			a0 = decayEnd;
+			nextBreak = decayEnd;
+		} else if (nextBreak == decayEnd) { // finished decay period
+			constant = true;
+		} else if (nextBreak == releaseEnd) { // finished release period
+			value = 0;
+			constant = true;
+		}
+	}
+
 	int attackEnd{ 1 };
 	int decayEnd{ 1 };
 	int releaseEnd{ 1 };
@@ -170,20 +209,41 @@ public:
 		if (constant) return value;
 		value += currentRamp;
 		if (++index == nextBreak) {
-			if (nextBreak == attackEnd) {
-				currentRamp = (s - 1.) / d;
-				decayEnd = attackEnd + d;
-				nextBreak = decayEnd;
-			} else if (nextBreak == decayEnd) {
-				constant = true;
-			} else if (nextBreak == releaseEnd) {
-				value = 0;
-				constant = true;
-			}
+			finishPeriod();
 		}
 		return value;
 	}
 
+	// Fill a whole block with the next n values, the same as static_cast<float>(next()) n times up
+	// to rounding (checked by the adsr_render tool). Ramps are evaluated as value + m·ramp instead
+	// of being accumulated. The block is only split at period breakpoints and constant periods are
+	// a plain fill.
+	void render(float* out, int n) noexcept {
+		int i = 0;
+		while (i < n) {
+			if (constant) {
+				std::fill(out + i, out + n, static_cast<float>(value));
+				return;
+			}
+			int length = nextBreak - index;
+			if (length <= 0 || length > n - i) length = n - i;
+
+			const double v0 = value;
+			const double ramp = currentRamp;
+			float* segment = out + i;
+			for (int m = 1; m <= length; m++) {
+				segment[m - 1] = static_cast<float>(v0 + m * ramp);
+			}
+			value = v0 + length * ramp;
+			index += length;
+			i += length;
+			if (index == nextBreak) {
+				finishPeriod();
+				if (constant) out[i - 1] = static_cast<float>(value); // release may have set value to 0
+			}
+		}
+	}
+
 	bool hasReachedSustain() const noexcept {
 		return index == decayEnd;
 	}
@@ -194,6 +254,19 @@ public:
 
 
 private:
+	void finishPeriod() noexcept {
+		if (nextBreak == attackEnd) {
+			currentRamp = (s - 1.) / d;
+			decayEnd = attackEnd + d;
+			nextBreak = decayEnd;
+		} else if (nextBreak == decayEnd) {
+			constant = true;
+		} else if (nextBreak == releaseEnd) {
+			value = 0;
+			constant = true;
+		}
+	}
+
 	double currentRamp{};
 
 	int a{}, d{}, r{};
@@ -0,0 +1,576 @@
+
+// FFT and zero-latency partitioned convolution
+//
+// -----------------------------------------------------------------------------------------------------------------------------
+// This file is part of the Überton project. Copyright (C) 2021 Überton
+//
+// Überton is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+// Überton is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details. You should
+// have received a copy of the GNU General Public License along with Überton. If not, see http://www.gnu.org/licenses/.
+// -----------------------------------------------------------------------------------------------------------------------------
+
+
+#pragma once
+
+#include "vstmath.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+
+namespace Uberton {
+namespace Math {
+
+// Iterative radix-2 complex FFT with precomputed twiddle factors and bit reversal table.
+// setSize() allocates, all other methods are real-time safe. butterflies() exposes single passes
+// so that a transform can be split into chunks of work (see PartitionedConvolver).
+template<class T>
+class FFT
+{
+public:
+	using complex = std::complex<T>;
+
+	FFT() = default;
+	explicit FFT(int size) { setSize(size); }
+
+	/// Size needs to be a power of two
+	void setSize(int size) {
+		assert(size > 0 && (size & (size - 1)) == 0);
+		n = size;
+		int bits = 0;
+		while ((1 << bits) < n) ++bits;
+
+		bitReversed.resize(n);
+		for (int i = 0; i < n; i++) {
+			int r = 0;
+			for (int b = 0; b < bits; b++) {
+				if (i & (1 << b)) r |= 1 << (bits - 1 - b);
+			}
+			bitReversed[i] = r;
+		}
+		twiddles.resize(std::max(1, n / 2));
+		for (int k = 0; k < n / 2; k++) {
+			const double phi = -2.0 * pi<double>() * k / n;
+			twiddles[k] = complex(static_cast<T>(std::cos(phi)), static_cast<T>(std::sin(phi)));
+		}
+	}
+
+	int size() const { return n; }
+
+	/// Position of element i in the bit-reversed order the butterflies expect their input in
+	int reversed(int i) const { return bitReversed[i]; }
+
+	/// In-place forward transform (no scaling)
+	void forward(complex* data) const { transform(data, false); }
+
+	/// In-place inverse transform (scaled by 1/size)
+	void inverse(complex* data) const {
+		transform(data, true);
+		const T scale = T{ 1 } / n;
+		for (int i = 0; i < n; i++) {
+			data[i] *= scale;
+		}
+	}
+
+	/// Butterflies [begin, end) of the size/2 butterflies of the pass with sub-transform length len
+	/// (2, 4, ..., size). Running all passes in this order on bit-reversed input is a full
+	/// (unscaled) transform.
+	void butterflies(complex* data, int len, int begin, int end, bool inverse) const {
+		const int half = len >> 1;
+		const int step = n / len;
+		for (int b = begin; b < end; b++) {
+			const int j = b & (half - 1);
+			const int i = ((b - j) << 1) + j; // (b / half) * len + j
+			const T wr = twiddles[j * step].real();
+			const T wi = inverse ? -twiddles[j * step].imag() : twiddles[j * step].imag();
+			const complex u = data[i];
+			const complex v0 = data[i + half];
+			// written out, std::complex multiplication may not be inlined (NaN handling)
+			const complex v(v0.real() * wr - v0.imag() * wi, v0.real() * wi + v0.imag() * wr);
+			data[i] = u + v;
+			data[i + half] = u - v;
+		}
+	}
+
+	/// Rough number of floating point operations of one transform
+	static double flops(int size) {
+		return 5.0 * size * std::log2(static_cast<double>(size));
+	}
+
+private:
+	void transform(complex* data, bool inverse) const {
+		for (int i = 0; i < n; i++) {
+			if (i < bitReversed[i]) std::swap(data[i], data[bitReversed[i]]);
+		}
+		for (int len = 2; len <= n; len <<= 1) {
+			butterflies(data, len, 0, n / 2, inverse);
+		}
+	}
+
+	int n{ 0 };
+	std::vector<int> bitReversed;
+	std::vector<complex> twiddles; // exp(-2πik/n) for k < n/2
+};
+
+
+// Zero-latency convolution of a multichannel input with a (channels × channels) matrix of
+// impulse responses, i.e. output[out] = Σ_in input[in] * h[out][in].
+//
+// The impulse response is split non-uniformly (Gardner): the first headSize taps are
+// applied directly in the time domain and the rest by uniformly partitioned overlap-save
+// stages whose partition size doubles from stage to stage (two partitions per stage)
+// up to maxPartitionSize where the remaining tail is partitioned uniformly.
+//
+//   |head|  64  |  64  | 128 | 128 |  256 |  256 | ... | 8192 | 8192 | 8192 | ...
+//
+// A stage with partition size P starts a job every P samples (at time t, with the input
+// x[t-2P, t)) whose first output sample is only due at t + offset - P. Its work (gathering the
+// input, the FFT passes, the products of all partitions and the inverse FFT) is split into
+// units of similar cost which are spread evenly over the samples until then, so that every
+// sample costs about the average and stages of different sizes do not pile up on their common
+// boundaries. Only the first stage (offset = P = 64) has no slack and runs at once. All stage
+// outputs are summed into an output accumulator.
+//
+// Both input channels are packed into the real and imaginary part of a single complex FFT
+// and so are both output channels for the inverse transform.
+//
+// prepare() allocates for a maximum impulse response length, all other methods are
+// real-time safe. The impulse response is loaded sample by sample (each partition is
+// transformed as soon as it is complete) so that it can be computed incrementally. Loading
+// may happen on another thread as long as process() is not called meanwhile.
+template<class T, int channels>
+class PartitionedConvolver
+{
+	static_assert(channels == 1 || channels == 2, "PartitionedConvolver supports one or two channels");
+
+public:
+	using complex = std::complex<T>;
+	using Frame = std::array<T, channels>;
+	static constexpr int numPaths = channels * channels; // path index: out * channels + in
+	using PathFrame = std::array<T, numPaths>;
+
+	static constexpr int headSize = 64;
+	static constexpr int maxPartitionSize = 8192;
+
+	/// Allocate for impulse responses of up to maxLength samples (not real-time safe)
+	void prepare(int maxLength) {
+		this->maxLength = maxLength;
+		levels.clear();
+		int historySize = headSize;
+		int accumulatorSize = headSize;
+		forEachStage(maxLength, [&](int size, int offset, int numPartitions) {
+			Stage& stage = levels.emplace_back();
+			stage.size = size;
+			stage.offset = offset;
+			stage.fft.setSize(2 * size);
+			stage.spectra.assign(static_cast<size_t>(numPartitions) * numPaths * (size + 1), complex{});
+			stage.fdl.assign(static_cast<size_t>(numPartitions) * channels * (size + 1), complex{});
+			stage.spectrumY.assign(channels * (size + 1), complex{});
+			stage.buffer.assign(2 * size, complex{});
+			// the input frame of a job is read until its deadline t + offset - P
+			historySize = std::max(historySize, offset + size + 1);
+			accumulatorSize = std::max(accumulatorSize, offset + size + 1);
+		});
+		historyMask = nextPowerOfTwo(historySize) - 1;
+		accumulatorMask = nextPowerOfTwo(accumulatorSize) - 1;
+		for (int ch = 0; ch < channels; ch++) {
+			history[ch].assign(2 * (historyMask + 1), T{});
+			accumulator[ch].assign(accumulatorMask + 1, T{});
+		}
+		const int largestSize = levels.empty() ? 0 : levels.back().size;
+		head.assign(numPaths * headSize, T{});
+		pending.assign(numPaths * largestSize, T{});
+		beginImpulseResponse(0);
+	}
+
+	/// Start loading a new impulse response of given length (clamped to the prepared maximum).
+	/// Resets all signal state.
+	void beginImpulseResponse(int length) {
+		irLength = std::min(length, maxLength);
+		loaded = 0;
+		loadStage = 0;
+		loadPartition = 0;
+		std::fill(head.begin(), head.end(), T{});
+		std::fill(pending.begin(), pending.end(), T{});
+		for (auto& stage : levels) stage.numPartitions = 0;
+		int index = 0;
+		forEachStage(irLength, [&](int size, int, int numPartitions) {
+			Stage& stage = levels[index++];
+			stage.numPartitions = numPartitions;
+			stage.units = jobUnits(size, numPartitions);
+		});
+		numStages = index;
+		reset();
+	}
+
+	/// Append the next impulse response sample of all paths
+	void appendImpulseResponse(const PathFrame& h) {
+		if (loaded >= irLength) return;
+		if (loaded < headSize) {
+			for (int path = 0; path < numPaths; path++) {
+				// stored reversed for a forward dot product with the input history
+				head[path * headSize + headSize - 1 - loaded] = h[path];
+			}
+		} else {
+			const Stage& stage = levels[loadStage];
+			const int index = loaded - stage.offset - loadPartition * stage.size;
+			for (int path = 0; path < numPaths; path++) {
+				pending[path * stage.size + index] = h[path];
+			}
+		}
+		++loaded;
+		if (loaded <= headSize) return;
+
+		const Stage& stage = levels[loadStage];
+		const bool partitionComplete = loaded == stage.offset + (loadPartition + 1) * stage.size;
+		if (partitionComplete || loaded == irLength) {
+			transformPending();
+		}
+	}
+
+	bool isComplete() const { return loaded >= irLength; }
+	int length() const { return irLength; }
+
+	/// Clear the signal history (the impulse response is kept)
+	void reset() {
+		for (int ch = 0; ch < channels; ch++) {
+			std::fill(history[ch].begin(), history[ch].end(), T{});
+			std::fill(accumulator[ch].begin(), accumulator[ch].end(), T{});
+		}
+		for (auto& stage : levels) {
+			std::fill(stage.fdl.begin(), stage.fdl.end(), complex{});
+			stage.fdlPos = 0;
+			stage.step = Step::Idle;
+		}
+		counter = 0;
+	}
+
+	/// Process one sample frame
+	Frame process(const Frame& input) {
+		const int historySize = historyMask + 1;
+		const int pos = static_cast<int>(counter & historyMask);
+		for (int ch = 0; ch < channels; ch++) {
+			history[ch][pos] = input[ch];
+			history[ch][pos + historySize] = input[ch]; // mirrored for contiguous reads
+		}
+
+		Frame result{};
+		const int start = pos + historySize - (headSize - 1);
+		for (int out = 0; out < channels; out++) {
+			T sum{ 0 };
+			for (int in = 0; in < channels; in++) {
+				const T* h = head.data() + (out * channels + in) * headSize;
+				const T* x = history[in].data() + start;
+				for (int k = 0; k < headSize; k++) {
+					sum += h[k] * x[k];
+				}
+			}
+			T& acc = accumulator[out][counter & accumulatorMask];
+			result[out] = sum + acc;
+			acc = 0;
+		}
+
+		++counter;
+		constexpr int all = std::numeric_limits<int>::max();
+		for (int s = 0; s < numStages; s++) {
+			Stage& stage = levels[s];
+			if ((counter & (stage.size - 1)) == 0) {
+				advanceStage(stage, all); // the previous job is always done by now
+				stage.step = Step::Gather;
+				stage.index = 0;
+				stage.unitsDone = 0;
+				stage.time = counter;
+			}
+			if (stage.step != Step::Idle) {
+				// evenly spread until the deadline: units · (k + 1) / (slack + 1) done after the k-th sample
+				const int64_t samples = stage.offset - stage.size + 1;
+				const int64_t due = (stage.units * (counter - stage.time + 1) + samples - 1) / samples;
+				advanceStage(stage, due >= stage.units ? all : static_cast<int>(due - stage.unitsDone));
+			}
+		}
+		return result;
+	}
+
+	/// Rough number of floating point operations per sample for an impulse response of given length
+	static double flopsPerSample(int length) {
+		double flops = 2.0 * numPaths * std::min(length, headSize);
+		forEachStage(length, [&](int size, int, int numPartitions) {
+			flops += jobFlops(size, numPartitions) / size;
+		});
+		return flops;
+	}
+
+	/// Upper bound for the floating point operations of any blockSize consecutive samples, the
+	/// cost that decides about dropouts
+	static double peakFlopsPerBlock(int length, int blockSize) {
+		double flops = 2.0 * numPaths * std::min(length, headSize) * blockSize;
+		forEachStage(length, [&](int size, int offset, int numPartitions) {
+			const double job = jobFlops(size, numPartitions);
+			const double jobsPerBlock = std::ceil(double(blockSize) / size) + 1;
+			const double spread = std::ceil(double(blockSize) * jobUnits(size, numPartitions) / (offset - size + 1) + 1) / jobUnits(size, numPartitions);
+			flops += job * std::min(jobsPerBlock, spread);
+		});
+		return flops;
+	}
+
+private:
+	// Steps of a stage job, see advanceStage()
+	enum class Step {
+		Idle,
+		Gather,
+		Forward,
+		Split,
+		Multiply,
+		Pack,
+		Inverse,
+		Accumulate
+	};
+
+	// Elements per unit of work of the FFT, split and pack steps, gather and accumulate take four
+	// times as many and the multiply step numPaths times less
+	static constexpr int unitSize = 128;
+
+	struct Stage
+	{
+		int size{ 0 };	 // partition size P (a job every P samples with FFT size 2P)
+		int offset{ 0 }; // impulse response offset of the first partition
+		int numPartitions{ 0 };
+		int units{ 0 }; // per job
+		FFT<T> fft;
+		std::vector<complex> spectra;	// [partition][path][bin]
+		std::vector<complex> fdl;		// frequency-domain delay line [slot][channel][bin]
+		std::vector<complex> spectrumY; // output spectra [channel][bin]
+		std::vector<complex> buffer;
+		int fdlPos{ 0 };
+
+		// running job
+		Step step{ Step::Idle };
+		int index{ 0 };	   // next element of the step
+		int pass{ 0 };	   // sub-transform length of the FFT steps, partition of the multiply step
+		int unitsDone{ 0 };
+		int64_t time{ 0 }; // counter when the job was started
+	};
+
+	// Calls f(size, offset, numPartitions) for each stage needed for an impulse response of given length
+	template<class F>
+	static void forEachStage(int length, F&& f) {
+		int offset = headSize;
+		int size = headSize;
+		while (offset < length) {
+			const int remainingPartitions = (length - offset + size - 1) / size;
+			const int numPartitions = size < maxPartitionSize ? std::min(2, remainingPartitions) : remainingPartitions;
+			f(size, offset, numPartitions);
+			offset += numPartitions * size;
+			size = std::min(2 * size, maxPartitionSize);
+		}
+	}
+
+	static int nextPowerOfTwo(int n) {
+		int p = 1;
+		while (p < n) p <<= 1;
+		return p;
+	}
+
+	static int numUnits(int elements, int unit) { return (elements + unit - 1) / unit; }
+
+	// Units of work of one job of a stage, as counted by advanceStage()
+	static int jobUnits(int size, int numPartitions) {
+		int passes = 0;
+		while ((2 << passes) <= 2 * size) ++passes;
+		const int bins = size + 1;
+		return numUnits(2 * size, 4 * unitSize) + 2 * passes * numUnits(size, unitSize) + 2 * numUnits(bins, unitSize)
+			   + numPartitions * numUnits(bins, unitSize / numPaths) + numUnits(size, 4 * unitSize);
+	}
+
+	static double jobFlops(int size, int numPartitions) {
+		return 2 * FFT<T>::flops(2 * size) + 8.0 * numPartitions * numPaths * (size + 1);
+	}
+
+	// Transform the pending (complete or final) partition into the spectra of the current stage
+	void transformPending() {
+		Stage& stage = levels[loadStage];
+		const int P = stage.size;
+		const int bins = P + 1;
+		complex* buffer = stage.buffer.data();
+		complex* spectra = stage.spectra.data() + static_cast<size_t>(loadPartition) * numPaths * bins;
+
+		// two real paths per complex transform
+		for (int path = 0; path < numPaths; path += 2) {
+			const T* a = pending.data() + path * P;
+			const T* b = (path + 1 < numPaths) ? pending.data() + (path + 1) * P : nullptr;
+			for (int k = 0; k < P; k++) {
+				buffer[k] = complex(a[k], b ? b[k] : T{ 0 });
+				buffer[k + P] = 0;
+			}
+			stage.fft.forward(buffer);
+			splitSpectra(buffer, 2 * P, spectra + path * bins, b ? spectra + (path + 1) * bins : nullptr, 0, bins);
+		}
+		std::fill(pending.begin(), pending.end(), T{});
+
+		if (++loadPartition == stage.numPartitions) {
+			++loadStage;
+			loadPartition = 0;
+		}
+	}
+
+	// Separate the spectra A and B (bins [begin, end) of 0..N/2) of two real signals a, b from FFT(a + ib)
+	static void splitSpectra(const complex* z, int N, complex* A, complex* B, int begin, int end) {
+		const complex half_i(0, T{ -.5 });
+		for (int k = begin; k < end; k++) {
+			const complex zk = z[k];
+			const complex zc = std::conj(z[(N - k) & (N - 1)]);
+			A[k] = T{ .5 } * (zk + zc);
+			if (B) B[k] = half_i * (zk - zc);
+		}
+	}
+
+	// Runs up to numUnits units of the running job of a stage, each one a chunk of elements of a
+	// step. The steps are those of uniformly partitioned overlap-save: forward FFT of the input
+	// frame, multiply-accumulate Y[out] = Σ_p Σ_in X_in(t - pP) · H_p[out][in] over all partitions
+	// and inverse FFT of both output spectra packed into one. The input is gathered and the output
+	// spectrum packed in bit-reversed order so that the FFTs are butterfly passes only.
+	void advanceStage(Stage& stage, int numUnits) {
+		const int P = stage.size;
+		const int N = 2 * P;
+		const int bins = P + 1;
+		complex* buffer = stage.buffer.data();
+		complex* Y0 = stage.spectrumY.data();
+		complex* Y1 = channels > 1 ? Y0 + bins : nullptr;
+
+		for (; numUnits > 0 && stage.step != Step::Idle; --numUnits) {
+			++stage.unitsDone;
+			const int begin = stage.index;
+			switch (stage.step) {
+			case Step::Gather: {
+				// input frame x[t-2P, t)
+				const int end = std::min(N, begin + 4 * unitSize);
+				const int64_t start = stage.time - N;
+				for (int k = begin; k < end; k++) {
+					const size_t index = (start + k) & historyMask;
+					buffer[stage.fft.reversed(k)] = complex(history[0][index], channels > 1 ? history[channels - 1][index] : T{ 0 });
+				}
+				nextChunk(stage, end, N, Step::Forward);
+				break;
+			}
+			case Step::Forward:
+			case Step::Inverse: {
+				const int end = std::min(P, begin + unitSize);
+				stage.fft.butterflies(buffer, stage.pass, begin, end, stage.step == Step::Inverse);
+				stage.index = end;
+				if (end == P) {
+					stage.index = 0;
+					stage.pass <<= 1;
+					if (stage.pass > N) {
+						stage.step = stage.step == Step::Forward ? Step::Split : Step::Accumulate;
+						stage.pass = 0;
+					}
+				}
+				break;
+			}
+			case Step::Split: {
+				if (begin == 0) stage.fdlPos = (stage.fdlPos == 0 ? stage.numPartitions : stage.fdlPos) - 1;
+				complex* X = stage.fdl.data() + static_cast<size_t>(stage.fdlPos) * channels * bins;
+				const int end = std::min(bins, begin + unitSize);
+				splitSpectra(buffer, N, X, channels > 1 ? X + bins : nullptr, begin, end);
+				nextChunk(stage, end, bins, Step::Multiply);
+				break;
+			}
+			case Step::Multiply: {
+				const int end = std::min(bins, begin + unitSize / numPaths);
+				const int p = stage.pass;
+				const int slot = (stage.fdlPos + p) % stage.numPartitions;
+				const complex* Xp = stage.fdl.data() + static_cast<size_t>(slot) * channels * bins;
+				const complex* Hp = stage.spectra.data() + static_cast<size_t>(p) * numPaths * bins;
+				for (int out = 0; out < channels; out++) {
+					complex* y = Y0 + out * bins;
+					if (p == 0) std::fill(y + begin, y + end, complex{});
+					for (int in = 0; in < channels; in++) {
+						const complex* x = Xp + in * bins;
+						const complex* h = Hp + (out * channels + in) * bins;
+						for (int k = begin; k < end; k++) {
+							y[k] += complex(x[k].real() * h[k].real() - x[k].imag() * h[k].imag(),
+											x[k].real() * h[k].imag() + x[k].imag() * h[k].real());
+						}
+					}
+				}
+				stage.index = end;
+				if (end == bins) {
+					stage.index = 0;
+					if (++stage.pass == stage.numPartitions) {
+						stage.step = Step::Pack;
+						stage.pass = 0;
+					}
+				}
+				break;
+			}
+			case Step::Pack: {
+				// both (hermitian) output spectra in one complex spectrum: W = Y0 + i·Y1
+				const complex i(0, 1);
+				const int end = std::min(bins, begin + unitSize);
+				for (int k = begin; k < end; k++) {
+					buffer[stage.fft.reversed(k)] = Y1 ? Y0[k] + i * Y1[k] : Y0[k];
+					if (k > 0 && k < P) {
+						buffer[stage.fft.reversed(N - k)] = Y1 ? std::conj(Y0[k]) + i * std::conj(Y1[k]) : std::conj(Y0[k]);
+					}
+				}
+				nextChunk(stage, end, bins, Step::Inverse);
+				break;
+			}
+			case Step::Accumulate: {
+				// the last P samples are valid and belong to the times [t - P + offset, t + offset)
+				const T scale = T{ 1 } / N;
+				const int end = std::min(P, begin + 4 * unitSize);
+				const int64_t first = stage.time - P + stage.offset;
+				for (int k = begin; k < end; k++) {
+					const size_t index = (first + k) & accumulatorMask;
+					accumulator[0][index] += scale * buffer[P + k].real();
+					if constexpr (channels > 1) {
+						accumulator[1][index] += scale * buffer[P + k].imag();
+					}
+				}
+				nextChunk(stage, end, P, Step::Idle);
+				break;
+			}
+			case Step::Idle: break;
+			}
+		}
+	}
+
+	static void nextChunk(Stage& stage, int end, int count, Step next) {
+		stage.index = end;
+		if (end == count) {
+			stage.index = 0;
+			stage.step = next;
+			stage.pass = 2; // first FFT pass, ignored otherwise
+			if (next == Step::Multiply) stage.pass = 0;
+		}
+	}
+
+	std::vector<Stage> levels;
+	int numStages{ 0 };
+	int maxLength{ 0 };
+	int irLength{ 0 };
+
+	// impulse response loading
+	int loaded{ 0 };
+	int loadStage{ 0 };
+	int loadPartition{ 0 };
+	std::vector<T> pending; // [path][sample] of the partition being loaded
+	std::vector<T> head;	// [path][tap] reversed
+
+	std::array<std::vector<T>, channels> history;	  // input ring buffer (mirrored)
+	std::array<std::vector<T>, channels> accumulator; // output ring buffer
+	int64_t historyMask{ 0 };
+	int64_t accumulatorMask{ 0 };
+	int64_t counter{ 0 }; // number of processed samples
+};
+
+}
+}
@@ -0,0 +1,213 @@
+
+// Process-wide cache of eigenfunction evaluations at resonator positions
+//
+// -----------------------------------------------------------------------------------------------------------------------------
+// This file is part of the Überton project. Copyright (C) 2021 Überton
+//
+// Überton is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+// Überton is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details. You should
+// have received a copy of the GNU General Public License along with Überton. If not, see http://www.gnu.org/licenses/.
+// -----------------------------------------------------------------------------------------------------------------------------
+
+
+#pragma once
+
+#include "vstmath.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace Uberton {
+namespace Math {
+
+// Bounded least recently used cache for the eigenfunctions of all N modes of a shape, evaluated
+// at one position. Entries are keyed by the shape, its dimension and the position quantized to
+// 1/quantization (the order is N and part of the type). All instances of a plugin share one cache
+// per sample type through shared(), so positions from presets are only evaluated once.
+//
+// The table has a fixed capacity and is allocated in the constructor, find() and insert() don't
+// allocate. Access is guarded by a mutex: the tryFind()/tryInsert() variants for the audio thread
+// only try to lock it and report a miss instead of waiting when another thread holds it, find()
+// and insert() block and are meant for other threads (e.g. filling the cache in setActive()).
+// Lookups are not wait-free: on a miss (or a contended lock) the caller evaluates the
+// eigenfunctions itself, on the audio thread that is the full cost of an uncached position
+// update plus two linear scans of the table.
+//
+// Usage example:
+//
+//   auto& cache = EigenFunctionCache<float, 10, 200>::shared();
+//   const auto key = cache.makeKey(shapeId, dim, x);
+//   if (!cache.tryFind(key, values)) {
+//       evaluate(cache.position(key), values);
+//       cache.tryInsert(key, values);
+//   }
+//
+template<class T, int d, int N>
+class EigenFunctionCache
+{
+public:
+	using real = T;
+	using scalar = std::complex<T>;
+	using Vec = Vector<T, d>;
+
+	static constexpr real quantization = real(1 << 20); // steps per unit, ~1e-6
+	static constexpr int defaultCapacity = 128;
+
+	struct Key
+	{
+		std::size_t shape{ 0 };
+		int dim{ 0 };
+		std::array<std::int32_t, d> coords{};
+		std::size_t hash{ 0 };
+
+		bool operator==(const Key& other) const {
+			return hash == other.hash && shape == other.shape && dim == other.dim && coords == other.coords;
+		}
+	};
+
+	struct Stats
+	{
+		std::uint64_t hits{ 0 };
+		std::uint64_t misses{ 0 };
+		std::uint64_t contended{ 0 }; // tryFind()/tryInsert() calls that did not get the lock
+		int size{ 0 };
+	};
+
+	explicit EigenFunctionCache(int capacity = defaultCapacity)
+		: slots(std::max(1, capacity)), values(static_cast<std::size_t>(std::max(1, capacity)) * N) {}
+
+	EigenFunctionCache(const EigenFunctionCache&) = delete;
+	EigenFunctionCache& operator=(const EigenFunctionCache&) = delete;
+
+	/// The cache shared by all users in the process (per T, d and N). The first call allocates,
+	/// make it outside of the audio thread.
+	static EigenFunctionCache& shared() {
+		static EigenFunctionCache cache;
+		return cache;
+	}
+
+	/// shape identifies the eigenfunctions (e.g. a hash of the type of the shape), only the
+	/// first dim coordinates of x are used.
+	static Key makeKey(std::size_t shape, int dim, const Vec& x) {
+		Key key;
+		key.shape = shape;
+		key.dim = dim;
+		std::size_t hash = shape ^ (std::size_t(dim) * 0x9e3779b97f4a7c15ull);
+		for (int j = 0; j < std::min(d, dim); j++) {
+			key.coords[j] = static_cast<std::int32_t>(std::lround(x[j] * quantization));
+			hash = (hash ^ static_cast<std::uint32_t>(key.coords[j])) * 0x100000001b3ull; // FNV-1a
+		}
+		key.hash = hash;
+		return key;
+	}
+
+	/// The quantized position of the key. Evaluating there (instead of at the original position)
+	/// makes the cached values independent of which of the nearby positions was looked up first.
+	static Vec position(const Key& key) {
+		Vec x;
+		for (int j = 0; j < d; j++) {
+			x[j] = key.coords[j] / quantization;
+		}
+		return x;
+	}
+
+	/// Copy the N values of key to out, returns false on a miss
+	bool find(const Key& key, scalar* out) {
+		std::lock_guard<std::mutex> lock(mutex);
+		return findLocked(key, out);
+	}
+
+	/// Like find() but never waits for the lock, a contended lookup is a miss
+	bool tryFind(const Key& key, scalar* out) {
+		std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+		if (!lock.owns_lock()) {
+			++contended;
+			return false;
+		}
+		return findLocked(key, out);
+	}
+
+	/// Store the N values of key, replaces the least recently used entry if the cache is full
+	void insert(const Key& key, const scalar* in) {
+		std::lock_guard<std::mutex> lock(mutex);
+		insertLocked(key, in);
+	}
+
+	/// Like insert() but never waits for the lock, returns false if the values were not stored
+	bool tryInsert(const Key& key, const scalar* in) {
+		std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+		if (!lock.owns_lock()) {
+			++contended;
+			return false;
+		}
+		insertLocked(key, in);
+		return true;
+	}
+
+	void clear() {
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto& slot : slots) slot.lastUse = 0;
+		size = 0;
+	}
+
+	Stats getStats() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return { hits, misses, contended.load(), size };
+	}
+
+	int capacity() const { return static_cast<int>(slots.size()); }
+
+private:
+	struct Slot
+	{
+		Key key;
+		std::uint64_t lastUse{ 0 }; // 0 = empty
+	};
+
+	bool findLocked(const Key& key, scalar* out) {
+		for (std::size_t s = 0; s < slots.size(); s++) {
+			if (slots[s].lastUse != 0 && slots[s].key == key) {
+				slots[s].lastUse = ++clock;
+				std::copy_n(values.begin() + s * N, N, out);
+				++hits;
+				return true;
+			}
+		}
+		++misses;
+		return false;
+	}
+
+	void insertLocked(const Key& key, const scalar* in) {
+		std::size_t target = 0;
+		for (std::size_t s = 0; s < slots.size(); s++) {
+			if (slots[s].lastUse != 0 && slots[s].key == key) {
+				target = s; // already there (inserted by another thread since the lookup)
+				break;
+			}
+			if (slots[s].lastUse < slots[target].lastUse) target = s;
+		}
+		if (slots[target].lastUse == 0) ++size;
+		slots[target].key = key;
+		slots[target].lastUse = ++clock;
+		std::copy_n(in, N, values.begin() + target * N);
+	}
+
+	std::mutex mutex;
+	std::vector<Slot> slots;
+	std::vector<scalar> values; // N per slot
+	std::uint64_t clock{ 0 };
+	int size{ 0 };
+	std::uint64_t hits{ 0 };
+	std::uint64_t misses{ 0 };
+	std::atomic<std::uint64_t> contended{ 0 };
+};
+
+}
+}
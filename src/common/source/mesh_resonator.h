@@ -0,0 +1,416 @@
+
+// Resonator with the modes of an arbitrary triangle or tetrahedral mesh, loaded from a mode table
+// that is computed offline with the mesh_modes tool
+//
+// -----------------------------------------------------------------------------------------------------------------------------
+// This file is part of the Überton project. Copyright (C) 2021 Überton
+//
+// Überton is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+// Überton is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details. You should
+// have received a copy of the GNU General Public License along with Überton. If not, see http://www.gnu.org/licenses/.
+// -----------------------------------------------------------------------------------------------------------------------------
+
+
+#pragma once
+
+#include "resonator.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Uberton {
+namespace Math {
+
+// Eigenvalues and eigenfunctions (sampled at the vertices) of the Laplacian on a mesh of
+// triangles (membranes, plates, shells) or tetrahedra (solid bodies, cavities).
+//
+// Binary format (little endian, as written by save()):
+//     uint32  magic ("UBMT"), version
+//     uint32  numVertices, numElements, verticesPerElement (3 or 4), numModes
+//     float   vertices[numVertices][3]
+//     uint32  elements[numElements][verticesPerElement]
+//     double  eigenvalues[numModes]              k², ascending, in units of the mesh coordinates
+//     float   values[numVertices][numModes]      eigenfunctions at the vertices
+//
+// Positions are given relative to the bounding box of the vertices, [0,1]³. locate() finds the
+// element at a position (or the closest one for positions outside of the mesh) through a uniform
+// grid and returns the vertices and barycentric weights for interpolating the eigenfunctions.
+struct MeshModeTable
+{
+	static constexpr std::uint32_t magic = 0x544d4255; // "UBMT"
+	static constexpr std::uint32_t version = 1;
+
+	int verticesPerElement{ 3 };
+	std::vector<std::array<float, 3>> vertices;
+	std::vector<std::uint32_t> elements; // verticesPerElement indices per element
+	std::vector<double> eigenvalues;
+	std::vector<float> values; // [vertex][mode]
+	std::uint64_t fingerprint{ 0 }; // hash of the content, set in buildLocator()
+
+	struct Location
+	{
+		std::array<int, 4> vertices{};
+		std::array<float, 4> weights{}; // unused entries are 0
+	};
+
+	int numVertices() const { return static_cast<int>(vertices.size()); }
+	int numElements() const { return static_cast<int>(elements.size()) / verticesPerElement; }
+	int numModes() const { return static_cast<int>(eigenvalues.size()); }
+
+	/// Value of the eigenfunction of mode at a vertex
+	float value(int vertex, int mode) const { return values[static_cast<std::size_t>(vertex) * numModes() + mode]; }
+
+	bool save(const std::string& filename) const {
+		std::ofstream file(filename, std::ios::binary);
+		if (!file) return false;
+		const std::uint32_t header[] = { magic, version, static_cast<std::uint32_t>(numVertices()), static_cast<std::uint32_t>(numElements()),
+										 static_cast<std::uint32_t>(verticesPerElement), static_cast<std::uint32_t>(numModes()) };
+		file.write(reinterpret_cast<const char*>(header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(vertices.data()), vertices.size() * sizeof(vertices[0]));
+		file.write(reinterpret_cast<const char*>(elements.data()), elements.size() * sizeof(elements[0]));
+		file.write(reinterpret_cast<const char*>(eigenvalues.data()), eigenvalues.size() * sizeof(eigenvalues[0]));
+		file.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(values[0]));
+		return static_cast<bool>(file);
+	}
+
+	/// Read a table written by save(), returns false if the file can't be read or is damaged.
+	/// The counts in the header have to match the file size (before anything is allocated) and
+	/// the eigenvalues have to be finite, non-negative and ascending. Allocates and builds the
+	/// locator, call it outside of the audio thread.
+	bool load(const std::string& filename) {
+		std::ifstream file(filename, std::ios::binary | std::ios::ate);
+		if (!file) return false;
+		const std::streamoff fileSize = file.tellg();
+		if (fileSize < std::streamoff(6 * sizeof(std::uint32_t))) return false;
+		file.seekg(0);
+		std::uint32_t header[6]{};
+		file.read(reinterpret_cast<char*>(header), sizeof(header));
+		if (!file || header[0] != magic || header[1] != version) return false;
+		const std::uint32_t numV = header[2], numE = header[3], perElement = header[4], numM = header[5];
+		if ((perElement != 3 && perElement != 4) || numV == 0 || numE == 0 || numM == 0) return false;
+		// numVertices·numModes values may not fit into 64 bits, they are checked row by row
+		const std::uint64_t payload = static_cast<std::uint64_t>(fileSize) - sizeof(header);
+		const std::uint64_t tableBytes = std::uint64_t(numV) * sizeof(vertices[0]) + std::uint64_t(numE) * perElement * sizeof(elements[0]) +
+										 std::uint64_t(numM) * sizeof(eigenvalues[0]);
+		const std::uint64_t rowBytes = std::uint64_t(numM) * sizeof(values[0]);
+		if (tableBytes > payload || (payload - tableBytes) % rowBytes != 0 || (payload - tableBytes) / rowBytes != numV) return false;
+
+		verticesPerElement = static_cast<int>(perElement);
+		vertices.resize(numV);
+		elements.resize(static_cast<std::size_t>(numE) * perElement);
+		eigenvalues.resize(numM);
+		values.resize(static_cast<std::size_t>(numV) * numM);
+		file.read(reinterpret_cast<char*>(vertices.data()), vertices.size() * sizeof(vertices[0]));
+		file.read(reinterpret_cast<char*>(elements.data()), elements.size() * sizeof(elements[0]));
+		file.read(reinterpret_cast<char*>(eigenvalues.data()), eigenvalues.size() * sizeof(eigenvalues[0]));
+		file.read(reinterpret_cast<char*>(values.data()), values.size() * sizeof(values[0]));
+		if (!file) return false;
+		for (auto index : elements) {
+			if (index >= numV) return false;
+		}
+		for (std::size_t i = 0; i < eigenvalues.size(); i++) {
+			if (!std::isfinite(eigenvalues[i]) || eigenvalues[i] < 0 || (i > 0 && eigenvalues[i] < eigenvalues[i - 1])) return false;
+		}
+		buildLocator();
+		return true;
+	}
+
+	/// Set up the grid for locate() (and the fingerprint), needed after filling a table by hand
+	void buildLocator() {
+		boxMin = boxMax = vertices.empty() ? std::array<float, 3>{} : vertices[0];
+		for (const auto& v : vertices) {
+			for (int a = 0; a < 3; a++) {
+				boxMin[a] = std::min(boxMin[a], v[a]);
+				boxMax[a] = std::max(boxMax[a], v[a]);
+			}
+		}
+		// about one element per cell, flat axes get a single cell
+		const float maxExtent = std::max({ boxMax[0] - boxMin[0], boxMax[1] - boxMin[1], boxMax[2] - boxMin[2] });
+		int numFlat = 0;
+		for (int a = 0; a < 3; a++) numFlat += boxMax[a] - boxMin[a] <= 1e-6f * maxExtent;
+		const int cellsPerAxis = std::clamp(static_cast<int>(std::pow(numElements(), 1.0 / std::max(1, 3 - numFlat))), 1, 64);
+		for (int a = 0; a < 3; a++) {
+			gridSize[a] = boxMax[a] - boxMin[a] <= 1e-6f * maxExtent ? 1 : cellsPerAxis;
+		}
+
+		// elements per cell by their bounding boxes (counting sort)
+		const int numCells = gridSize[0] * gridSize[1] * gridSize[2];
+		cellStart.assign(numCells + 1, 0);
+		for (int pass = 0; pass < 2; pass++) {
+			std::vector<int> fill(cellStart.begin(), cellStart.end() - 1);
+			if (pass == 1) cellElements.resize(cellStart.back());
+			for (int e = 0; e < numElements(); e++) {
+				std::array<int, 3> lo, hi;
+				elementCells(e, lo, hi);
+				for (int z = lo[2]; z <= hi[2]; z++) {
+					for (int y = lo[1]; y <= hi[1]; y++) {
+						for (int x = lo[0]; x <= hi[0]; x++) {
+							const int cell = (z * gridSize[1] + y) * gridSize[0] + x;
+							if (pass == 0) cellStart[cell + 1]++;
+							else cellElements[fill[cell]++] = e;
+						}
+					}
+				}
+			}
+			if (pass == 0) {
+				for (int c = 0; c < numCells; c++) cellStart[c + 1] += cellStart[c];
+			}
+		}
+
+		std::uint64_t hash = 0xcbf29ce484222325ull; // FNV-1a of the eigenvalues and the first vertex values
+		auto add = [&](const void* data, std::size_t size) {
+			const auto* bytes = static_cast<const unsigned char*>(data);
+			for (std::size_t i = 0; i < size; i++) hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+		};
+		add(eigenvalues.data(), eigenvalues.size() * sizeof(eigenvalues[0]));
+		add(values.data(), std::min<std::size_t>(values.size(), 4096) * sizeof(values[0]));
+		fingerprint = hash;
+	}
+
+	/// Element at (or closest to) the position x ∈ [0,1]³ relative to the bounding box. Searches
+	/// the grid cell of x and, if it is empty, the rings of cells around it. Doesn't allocate.
+	Location locate(const std::array<float, 3>& x) const {
+		std::array<float, 3> p;
+		std::array<int, 3> cell;
+		for (int a = 0; a < 3; a++) {
+			p[a] = boxMin[a] + x[a] * (boxMax[a] - boxMin[a]);
+			cell[a] = std::clamp(static_cast<int>(x[a] * gridSize[a]), 0, gridSize[a] - 1);
+		}
+		Location best;
+		float bestDistance = std::numeric_limits<float>::max();
+		const int maxRing = std::max({ gridSize[0], gridSize[1], gridSize[2] });
+		for (int ring = 0; ring < maxRing && bestDistance == std::numeric_limits<float>::max(); ring++) {
+			for (int z = cell[2] - ring; z <= cell[2] + ring; z++) {
+				for (int y = cell[1] - ring; y <= cell[1] + ring; y++) {
+					for (int x = cell[0] - ring; x <= cell[0] + ring; x++) {
+						if (std::max({ std::abs(x - cell[0]), std::abs(y - cell[1]), std::abs(z - cell[2]) }) != ring) continue;
+						if (x < 0 || y < 0 || z < 0 || x >= gridSize[0] || y >= gridSize[1] || z >= gridSize[2]) continue;
+						const int c = (z * gridSize[1] + y) * gridSize[0] + x;
+						for (int k = cellStart[c]; k < cellStart[c + 1]; k++) {
+							Location location;
+							const float distance = closestPoint(cellElements[k], p, location);
+							if (distance < bestDistance) {
+								bestDistance = distance;
+								best = location;
+							}
+						}
+					}
+				}
+			}
+		}
+		return best;
+	}
+
+private:
+	using Point = std::array<float, 3>;
+
+	static Point sub(const Point& a, const Point& b) { return { a[0] - b[0], a[1] - b[1], a[2] - b[2] }; }
+	static float dot(const Point& a, const Point& b) { return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]; }
+
+	void elementCells(int e, std::array<int, 3>& lo, std::array<int, 3>& hi) const {
+		for (int a = 0; a < 3; a++) {
+			float minCoord = std::numeric_limits<float>::max(), maxCoord = std::numeric_limits<float>::lowest();
+			for (int k = 0; k < verticesPerElement; k++) {
+				const float coord = vertices[elements[e * verticesPerElement + k]][a];
+				minCoord = std::min(minCoord, coord);
+				maxCoord = std::max(maxCoord, coord);
+			}
+			const float scale = boxMax[a] > boxMin[a] ? gridSize[a] / (boxMax[a] - boxMin[a]) : 0;
+			lo[a] = std::clamp(static_cast<int>((minCoord - boxMin[a]) * scale), 0, gridSize[a] - 1);
+			hi[a] = std::clamp(static_cast<int>((maxCoord - boxMin[a]) * scale), 0, gridSize[a] - 1);
+		}
+	}
+
+	// Barycentric weights of the point of triangle abc that is closest to p (Ericson, Real-Time
+	// Collision Detection, 5.1.5)
+	static std::array<float, 3> closestOnTriangle(const Point& p, const Point& a, const Point& b, const Point& c) {
+		const Point ab = sub(b, a), ac = sub(c, a), ap = sub(p, a);
+		const float d1 = dot(ab, ap), d2 = dot(ac, ap);
+		if (d1 <= 0 && d2 <= 0) return { 1, 0, 0 };
+		const Point bp = sub(p, b);
+		const float d3 = dot(ab, bp), d4 = dot(ac, bp);
+		if (d3 >= 0 && d4 <= d3) return { 0, 1, 0 };
+		const float vc = d1 * d4 - d3 * d2;
+		if (vc <= 0 && d1 >= 0 && d3 <= 0) {
+			const float v = d1 / (d1 - d3);
+			return { 1 - v, v, 0 };
+		}
+		const Point cp = sub(p, c);
+		const float d5 = dot(ab, cp), d6 = dot(ac, cp);
+		if (d6 >= 0 && d5 <= d6) return { 0, 0, 1 };
+		const float vb = d5 * d2 - d1 * d6;
+		if (vb <= 0 && d2 >= 0 && d6 <= 0) {
+			const float w = d2 / (d2 - d6);
+			return { 1 - w, 0, w };
+		}
+		const float va = d3 * d6 - d5 * d4;
+		if (va <= 0 && d4 - d3 >= 0 && d5 - d6 >= 0) {
+			const float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+			return { 0, 1 - w, w };
+		}
+		const float denominator = 1 / (va + vb + vc);
+		const float v = vb * denominator, w = vc * denominator;
+		return { 1 - v - w, v, w };
+	}
+
+	// Squared distance of p to element e, location gets the weights of the closest point
+	float closestPoint(int e, const Point& p, Location& location) const {
+		const std::uint32_t* indices = &elements[e * verticesPerElement];
+		auto distanceTo = [&](const std::array<int, 4>& corners, const std::array<float, 4>& weights) {
+			Point q{};
+			for (int k = 0; k < 4; k++) {
+				for (int a = 0; a < 3; a++) q[a] += weights[k] * vertices[corners[k]][a];
+			}
+			const Point d = sub(p, q);
+			return dot(d, d);
+		};
+		auto triangle = [&](int i0, int i1, int i2, Location& result) {
+			const auto w = closestOnTriangle(p, vertices[i0], vertices[i1], vertices[i2]);
+			result.vertices = { i0, i1, i2, i0 };
+			result.weights = { w[0], w[1], w[2], 0 };
+			return distanceTo(result.vertices, result.weights);
+		};
+
+		if (verticesPerElement == 3) {
+			return triangle(indices[0], indices[1], indices[2], location);
+		}
+
+		// tetrahedron: barycentric coordinates, inside if all are positive
+		const Point& v0 = vertices[indices[0]];
+		const Point e1 = sub(vertices[indices[1]], v0), e2 = sub(vertices[indices[2]], v0), e3 = sub(vertices[indices[3]], v0);
+		const Point r = sub(p, v0);
+		auto det = [](const Point& a, const Point& b, const Point& c) {
+			return a[0] * (b[1] * c[2] - b[2] * c[1]) - a[1] * (b[0] * c[2] - b[2] * c[0]) + a[2] * (b[0] * c[1] - b[1] * c[0]);
+		};
+		const float volume = det(e1, e2, e3);
+		if (volume != 0) {
+			const float w1 = det(r, e2, e3) / volume, w2 = det(e1, r, e3) / volume, w3 = det(e1, e2, r) / volume;
+			const float w0 = 1 - w1 - w2 - w3;
+			if (w0 >= 0 && w1 >= 0 && w2 >= 0 && w3 >= 0) {
+				location.vertices = { int(indices[0]), int(indices[1]), int(indices[2]), int(indices[3]) };
+				location.weights = { w0, w1, w2, w3 };
+				return 0;
+			}
+		}
+		// outside: closest of the faces
+		static constexpr int faces[4][3] = { { 1, 2, 3 }, { 0, 2, 3 }, { 0, 1, 3 }, { 0, 1, 2 } };
+		float best = std::numeric_limits<float>::max();
+		for (const auto& face : faces) {
+			Location candidate;
+			const float distance = triangle(indices[face[0]], indices[face[1]], indices[face[2]], candidate);
+			if (distance < best) {
+				best = distance;
+				location = candidate;
+			}
+		}
+		return best;
+	}
+
+	Point boxMin{}, boxMax{};
+	std::array<int, 3> gridSize{ 1, 1, 1 };
+	std::vector<int> cellStart;	   // numCells + 1 offsets into cellElements
+	std::vector<int> cellElements; // elements overlapping each cell
+};
+
+
+// Shape for ResonatorBase with the modes of a MeshModeTable. The eigenfunctions at a position are
+// interpolated linearly from the vertex values of the element there, so evaluating all modes
+// costs one lookup in the grid of the table and 3-4 multiply-adds per mode.
+//
+// Without a table (or beyond its number of modes) the eigenvalues are those of a string and the
+// eigenfunctions 0, limit the order to numModes() with setOrder().
+template<class T, int N>
+class MeshEigenValues
+{
+public:
+	using real = T;
+	using scalar = std::complex<real>;
+	using SpaceVec = Uberton::Math::Vector<real, 3>;
+
+	MeshEigenValues() {
+		for (int i = 0; i < N; i++) ks[i] = static_cast<real>(i + 1);
+	}
+
+	/// Use the modes of table (shared between all instances using it). Like setDim() with other
+	/// shapes the frequencies and positions need to be set again afterwards.
+	void setTable(std::shared_ptr<const MeshModeTable> newTable) {
+		table = std::move(newTable);
+		tableModes = table ? std::min(N, table->numModes()) : 0;
+		for (int i = 0; i < N; i++) {
+			if (i < tableModes) ks[i] = static_cast<real>(std::sqrt(std::max(0.0, table->eigenvalues[i])));
+			else ks[i] = tableModes > 0 ? ks[tableModes - 1] : static_cast<real>(i + 1);
+		}
+	}
+
+	const std::shared_ptr<const MeshModeTable>& getTable() const { return table; }
+
+	/// Number of modes of the table (at most N)
+	int numModes() const { return tableModes; }
+
+	/// Distinguishes the eigenfunctions of different tables in an EigenFunctionCache
+	std::size_t shapeId() const { return table ? static_cast<std::size_t>(table->fingerprint) : 0; }
+
+	scalar eigenValueSqrt(int i) const {
+		return ks[i] / length;
+	}
+
+	scalar eigenFunction(int i, const SpaceVec& x) const {
+		if (i >= tableModes) return 0;
+		const auto location = table->locate({ float(x[0]), float(x[1]), float(x[2]) });
+		real result = 0;
+		for (int k = 0; k < 4; k++) {
+			result += location.weights[k] * table->value(location.vertices[k], i);
+		}
+		return result;
+	}
+
+	/// Evaluate the first n eigenfunctions at x, same results as eigenFunction()
+	void eigenFunctions(const SpaceVec& x, scalar* out, int n) const {
+		const int numInterpolated = std::min(n, tableModes);
+		if (numInterpolated > 0) {
+			const auto location = table->locate({ float(x[0]), float(x[1]), float(x[2]) });
+			std::array<const float*, 4> rows;
+			for (int k = 0; k < 4; k++) {
+				rows[k] = &table->values[static_cast<std::size_t>(location.vertices[k]) * table->numModes()];
+			}
+			for (int i = 0; i < numInterpolated; i++) {
+				real result = 0;
+				for (int k = 0; k < 4; k++) {
+					result += location.weights[k] * rows[k][i];
+				}
+				out[i] = result;
+			}
+		}
+		for (int i = numInterpolated; i < n; i++) out[i] = 0;
+	}
+
+	void setDesiredBaseFrequency(real f, real b, real c) {
+		const real w = 2 * pi<real>() * f;
+		// scale of the mesh so that the lowest mode has the frequency f
+		length = c * (ks[0] > 0 ? ks[0] : 1) / std::sqrt(w * w + b * b);
+	}
+
+private:
+	std::shared_ptr<const MeshModeTable> table;
+	int tableModes{ 0 };
+	std::array<real, N> ks{}; // eigenvalue sqrt in mesh units
+	real length{ 1 };
+};
+
+
+template<class T, int N, int channels>
+class MeshResonator : public ResonatorBase<MeshEigenValues<T, N>, T, 3, N, channels>
+{
+};
+
+}
+}
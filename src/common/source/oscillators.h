@@ -15,9 +15,13 @@
 #pragma once
 
 #include "vstmath.h"
+#include <algorithm>
+#include <cmath>
 
 namespace Uberton {
 
+// Simple per-sample oscillators with a virtual get(). Prefer the block oscillators
+// further below for anything that runs in the audio thread.
 class Oscillator
 {
 protected:
@@ -98,6 +102,198 @@ public:
 };
 
 
+
+// ---- Block oscillators ----
+//
+// Statically dispatched (CRTP) oscillators that render whole blocks. The derived class
+// implements tick() which is inlined into render(), there are no virtual calls and no
+// transcendental functions per sample.
+//
+// The phase is normalized to [0, 1) (one period), setPhase() takes radians like Oscillator.
+//
+template<class Derived>
+class BlockOscillator
+{
+public:
+	void setSampleRate(double sampleRate) {
+		this->sampleRate = sampleRate;
+		phaseInc = freq / sampleRate;
+		derived().frequencyChanged();
+	}
+
+	void setFrequency(double frequency) {
+		freq = frequency;
+		phaseInc = freq / sampleRate;
+		derived().frequencyChanged();
+	}
+
+	void setPhase(double phase) {
+		this->phase = phase * Math::r_twopi<double>();
+		this->phase -= std::floor(this->phase);
+		derived().phaseChanged();
+	}
+
+	// Generate a single sample
+	double get() {
+		if (++ticks == blockSize) {
+			ticks = 0;
+			derived().endBlock();
+		}
+		return derived().tick();
+	}
+
+	// Fill out[0..n)
+	template<class T>
+	void render(T* out, int n) {
+		for (int i = 0; i < n; i++) {
+			out[i] = static_cast<T>(derived().tick());
+		}
+		derived().endBlock();
+	}
+
+protected:
+	Derived& derived() { return static_cast<Derived&>(*this); }
+
+	// hooks for the derived class
+	void frequencyChanged() {}
+	void phaseChanged() {}
+	void endBlock() {}
+
+	void advancePhase() {
+		phase += phaseInc;
+		if (phase >= 1.0) phase -= 1.0;
+	}
+
+	double freq{ 0 };
+	double phase{ 0 };
+	double phaseInc{ 0 }; // in periods per sample
+	double sampleRate{ 44100 };
+
+private:
+	static constexpr int blockSize = 64; // endBlock() interval when using get()
+	int ticks{ 0 };
+};
+
+
+// Sine oscillator based on the quadrature recursion z[n+1] = z[n]·exp(i·ω), sin = Im(z).
+// The magnitude of z is renormalized after each block so that rounding errors can not
+// accumulate over time.
+class QuadratureSineOscillator : public BlockOscillator<QuadratureSineOscillator>
+{
+public:
+	double tick() {
+		const double sample = im;
+		const double newRe = re * rotRe - im * rotIm;
+		im = re * rotIm + im * rotRe;
+		re = newRe;
+		return sample;
+	}
+
+	void renormalize() {
+		// first order approximation of 1/|z|, |z| is always very close to 1
+		const double gain = 1.5 - 0.5 * (re * re + im * im);
+		re *= gain;
+		im *= gain;
+	}
+
+protected:
+	friend class BlockOscillator<QuadratureSineOscillator>;
+
+	void frequencyChanged() {
+		rotRe = std::cos(Math::twopi<double>() * phaseInc);
+		rotIm = std::sin(Math::twopi<double>() * phaseInc);
+	}
+	void phaseChanged() {
+		re = std::cos(Math::twopi<double>() * phase);
+		im = std::sin(Math::twopi<double>() * phase);
+	}
+	void endBlock() { renormalize(); }
+
+	double re{ 1 }, im{ 0 };
+	double rotRe{ 1 }, rotIm{ 0 };
+};
+
+
+// sin^5 (the fifth power is computed with three multiplications)
+class QuadratureSinePow5Oscillator : public BlockOscillator<QuadratureSinePow5Oscillator>
+{
+public:
+	double tick() {
+		const double s = sine.tick();
+		const double s2 = s * s;
+		return s2 * s2 * s;
+	}
+
+protected:
+	friend class BlockOscillator<QuadratureSinePow5Oscillator>;
+
+	void frequencyChanged() {
+		sine.setSampleRate(sampleRate);
+		sine.setFrequency(freq);
+	}
+	void phaseChanged() { sine.setPhase(phase * Math::twopi<double>()); }
+	void endBlock() { sine.renormalize(); }
+
+	QuadratureSineOscillator sine;
+};
+
+
+namespace Detail {
+// Polynomial band-limited step residual, t is the phase in periods and dt the phase
+// increment. Add to a naive waveform at every upward discontinuity of height 2 and subtract
+// at every downward one (i.e. the reset of a rising sawtooth).
+inline double polyBLEP(double t, double dt) {
+	if (t < dt) {
+		t /= dt;
+		return t + t - t * t - 1.0;
+	}
+	if (t > 1.0 - dt) {
+		t = (t - 1.0) / dt;
+		return t * t + t + t + 1.0;
+	}
+	return 0.0;
+}
+}
+
+
+// Rising sawtooth from -1 to 1 with polyBLEP anti-aliasing.
+class PolyBLEPSawOscillator : public BlockOscillator<PolyBLEPSawOscillator>
+{
+public:
+	double tick() {
+		const double sample = 2.0 * phase - 1.0 - Detail::polyBLEP(phase, phaseInc);
+		advancePhase();
+		return sample;
+	}
+};
+
+
+// Pulse wave (-1 during the first (1 - pulseWidth) of the period, then 1) with polyBLEP
+// anti-aliasing. A pulse width of .5 gives the same wave shape as RectOscillator.
+class PolyBLEPPulseOscillator : public BlockOscillator<PolyBLEPPulseOscillator>
+{
+public:
+	void setPulseWidth(double pulseWidth) {
+		this->pulseWidth = std::clamp(pulseWidth, 0.0, 1.0);
+	}
+
+	double tick() {
+		const double edge = 1.0 - pulseWidth; // position of the rising edge
+		double sample = phase < edge ? -1.0 : 1.0;
+
+		double risingPhase = phase - edge; // phase relative to rising edge
+		if (risingPhase < 0.0) risingPhase += 1.0;
+		sample += Detail::polyBLEP(risingPhase, phaseInc);
+		sample -= Detail::polyBLEP(phase, phaseInc); // falling edge at phase 0
+		advancePhase();
+		return sample;
+	}
+
+private:
+	double pulseWidth{ .5 };
+};
+
+
 // Performance-optimized triangle oscillator with adjustable duty cycle to morph continously
 // between symmetric triangle and sawtooth.
 //
@@ -163,6 +359,46 @@ struct TriangleDutyOscillator
 		return value;
 	}
 
+	// Fill out[0..n) with the same output as n calls to next() (up to rounding). With s the
+	// position in samples since the last minimum, one period is the minimum of the rising and
+	// the falling line
+	//     value(s) = min(-1 + s·upPhaseInc, 1 + (s - rise)·downPhaseInc),   s ∈ [0, rise + fall)
+	// which is continuous at the wrap, so the inner loop has no branches and is only split once per
+	// period. A parameter change that is still pending (see above) is finished with next(),
+	// as are the overshoots past ±1 that can follow it.
+	void render(float* out, int n) {
+		int i = 0;
+		while (i < n && (phaseInc != (phaseInc > 0 ? upPhaseInc : downPhaseInc) || std::abs(phase) > 1.0)) {
+			out[i++] = static_cast<float>(next());
+		}
+		if (i == n) return;
+
+		const double up = upPhaseInc, down = downPhaseInc;
+		const double rise = 2.0 * upPhaseInc_inv; // samples from -1 to 1
+		const double period = rise - 2.0 * downPhaseInc_inv;
+		double s0 = phaseInc > 0 ? (phase + 1.0) * upPhaseInc_inv : rise + (phase - 1.0) * downPhaseInc_inv;
+		while (i < n) {
+			// up to the end of the current period
+			const int length = std::min(n - i, std::max(1, static_cast<int>(std::ceil(period - s0))));
+			const double rising = -1.0 + s0 * up, falling = 1.0 + (s0 - rise) * down;
+			float* block = out + i;
+			for (int m = 0; m < length; m++) {
+				block[m] = static_cast<float>(std::min(rising + m * up, falling + m * down));
+			}
+			i += length;
+			s0 += length;
+			if (s0 >= period) s0 -= period;
+		}
+		const double s = s0;
+		if (s < rise) {
+			phase = -1.0 + s * up;
+			phaseInc = up;
+		} else {
+			phase = 1.0 + (s - rise) * down;
+			phaseInc = down;
+		}
+	}
+
 private:
 	void update() {
 		/*
@@ -0,0 +1,149 @@
+// Modal resonator bank distributed over multiple threads for very high orders
+//
+// -----------------------------------------------------------------------------------------------------------------------------
+// This file is part of the Überton project. Copyright (C) 2021 Überton
+//
+// Überton is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+// Überton is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details. You should
+// have received a copy of the GNU General Public License along with Überton. If not, see http://www.gnu.org/licenses/.
+// -----------------------------------------------------------------------------------------------------------------------------
+
+
+#pragma once
+
+#include "resonator.h"
+#include "worker_pool.h"
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <vector>
+
+namespace Uberton {
+namespace Math {
+
+// Wraps a resonator (any ResonatorBase, typically with N in the thousands) and processes whole
+// blocks with the modes partitioned across a WorkerPool. Each thread evolves its own contiguous
+// range of modes (aligned to cache lines) for the whole block and writes into its own partial
+// output bus, the partial buses are summed at the end.
+//
+// The resonator lives on the heap (its arrays get large) and is configured as usual through
+// resonator() - but not concurrently with process().
+//
+// The idle workers spin between blocks, so there are never more workers than cores besides the
+// one of the calling (audio) thread. Without a spare core the bank processes everything inline.
+//
+// Usage example:
+//
+//   ParallelResonatorBank<CubeResonator<float, 3, 4000, 2>> bank(4, 512);
+//   bank.resonator().setSampleRate(44100);
+//   ...
+//   bank.process(in, out, numSamples);
+//
+template<class Resonator>
+class ParallelResonatorBank
+{
+public:
+	using real = typename Resonator::real;
+	static constexpr int channels = Resonator::numChannels();
+
+	static constexpr int modeAlignment = 16;		// mode ranges start at multiples of this (cache line)
+	static constexpr int minModesPerThread = 256; // fewer modes are not worth the synchronization
+
+	/// numThreads includes the calling thread, so numThreads = 1 runs without workers. It is
+	/// limited to the number of hardware threads (see maxWorkers()).
+	ParallelResonatorBank(int numThreads, int maxBlockSize, bool pinThreads = true)
+		: res(std::make_unique<Resonator>()),
+		  pool(std::clamp(numThreads - 1, 0, maxWorkers()), pinThreads),
+		  maxBlockSize(maxBlockSize),
+		  buses(pool.numWorkers() + 1) {
+		for (auto& bus : buses) {
+			bus.resize(channels * maxBlockSize);
+		}
+	}
+
+	Resonator& resonator() { return *res; }
+	const Resonator& resonator() const { return *res; }
+
+	int numThreads() const { return pool.numWorkers() + 1; }
+
+	/// Hardware threads minus the one of the calling thread
+	static int maxWorkers() { return WorkerPool::hardwareConcurrency() - 1; }
+
+	/// Process numSamples samples of all channels, out is overwritten
+	void process(const real* const* in, real* const* out, int numSamples) {
+		for (int offset = 0; offset < numSamples; offset += maxBlockSize) {
+			const int n = std::min(maxBlockSize, numSamples - offset);
+			for (int ch = 0; ch < channels; ch++) {
+				blockIn[ch] = in[ch] + offset;
+				blockOut[ch] = out[ch] + offset;
+			}
+			processBlock(n);
+		}
+	}
+
+private:
+	void processBlock(int n) {
+		blockSize = n;
+		const int order = res->order();
+		activeThreads = std::clamp(order / minModesPerThread, 1, numThreads());
+		modesPerThread = (order + activeThreads - 1) / activeThreads;
+		modesPerThread = (modesPerThread + modeAlignment - 1) / modeAlignment * modeAlignment;
+
+		if (activeThreads == 1) {
+			for (int ch = 0; ch < channels; ch++) {
+				std::fill(blockOut[ch], blockOut[ch] + n, real{ 0 });
+			}
+			res->processModes(blockIn.data(), blockOut.data(), n, 0, order);
+			res->finishModes(blockIn.data(), n);
+			return;
+		}
+
+		pool.run(&ParallelResonatorBank::job, this);
+		res->finishModes(blockIn.data(), n);
+
+		for (int ch = 0; ch < channels; ch++) {
+			real* o = blockOut[ch];
+			std::copy(buses[0].data() + ch * maxBlockSize, buses[0].data() + ch * maxBlockSize + n, o);
+			for (int t = 1; t < activeThreads; t++) {
+				const real* partial = buses[t].data() + ch * maxBlockSize;
+				for (int i = 0; i < n; i++) {
+					o[i] += partial[i];
+				}
+			}
+		}
+	}
+
+	static void job(void* context, int index) {
+		auto& self = *static_cast<ParallelResonatorBank*>(context);
+		// the calling thread has the highest index, give it the first range
+		const int range = index == self.pool.numWorkers() ? 0 : index + 1;
+		if (range >= self.activeThreads) return;
+
+		std::array<real*, channels> bus;
+		for (int ch = 0; ch < channels; ch++) {
+			bus[ch] = self.buses[range].data() + ch * self.maxBlockSize;
+			std::fill(bus[ch], bus[ch] + self.blockSize, real{ 0 });
+		}
+		const int order = self.res->order();
+		const int begin = std::min(order, range * self.modesPerThread);
+		const int end = std::min(order, begin + self.modesPerThread);
+		self.res->processModes(self.blockIn.data(), bus.data(), self.blockSize, begin, end);
+	}
+
+	std::unique_ptr<Resonator> res;
+	WorkerPool pool;
+	int maxBlockSize;
+	std::vector<std::vector<real>> buses; // partial output per thread [channel][sample]
+
+	// current block
+	std::array<const real*, channels> blockIn{};
+	std::array<real*, channels> blockOut{};
+	int blockSize{ 0 };
+	int activeThreads{ 1 };
+	int modesPerThread{ 0 };
+};
+
+}
+}
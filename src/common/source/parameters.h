@@ -32,6 +32,10 @@ using namespace Steinberg::Vst;
  * A bypass is always implemented and stored/loaded as well as a version number
  * because adding a bypass parameter in a later version of a plugin would be hard
  * otherwise.
+ *
+ * Parameters are only ever appended, so states saved by a version with fewer
+ * parameters are shorter. Loading reads as many as the stream contains and the
+ * others keep their values (the defaults when a project is opened).
  */
 template<uint32 N>
 struct UniformParamState
@@ -59,8 +63,10 @@ struct UniformParamState
 		if (!s.readInt64u(version)) return kResultFalse;
 		if (!s.readBool(bypass)) return kResultFalse;
 
-		for (uint32 id = 0; id < N; id++) {
-			if (!s.readDouble(params[id])) return kResultFalse;
+		loaded = 0;
+		ParamValue value;
+		while (loaded < N && s.readDouble(value)) {
+			params[loaded++] = value;
 		}
 		return kResultOk;
 	}
@@ -68,12 +74,23 @@ struct UniformParamState
 	tresult setComponentState(IBStream* stream, EditController& controller) {
 		if (setState(stream) != kResultOk) return kResultFalse;
 
-		for (uint32 id = 0; id < N; id++) {
+		for (uint32 id = 0; id < loaded; id++) {
 			controller.setParamNormalized(id, params[id]);
 		}
 		return kResultOk;
 	}
 
+	/// Number of parameters read by the last setState() (N if it has not been called)
+	uint32 numLoaded() const { return loaded; }
+
+	/// Take over the bypass and the parameters that other has loaded, the others stay as they are
+	void assignLoaded(const UniformParamState& other) {
+		bypass = other.bypass;
+		for (uint32 id = 0; id < other.loaded; id++) {
+			params[id] = other.params[id];
+		}
+	}
+
 	ParamValue& operator[](size_t id) {
 #ifdef _DEBUG
 		if (id < 0 || id >= N) throw std::exception("Invalid param id");
@@ -91,6 +108,7 @@ struct UniformParamState
 private:
 	std::array<ParamValue, N> params{};
 	bool bypass{ false };
+	uint32 loaded{ N };
 };
 
 
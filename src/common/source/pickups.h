@@ -0,0 +1,124 @@
+
+// Packed output projection of a resonator onto many pickup positions
+//
+// -----------------------------------------------------------------------------------------------------------------------------
+// This file is part of the Überton project. Copyright (C) 2021 Überton
+//
+// Überton is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+// Überton is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details. You should
+// have received a copy of the GNU General Public License along with Überton. If not, see http://www.gnu.org/licenses/.
+// -----------------------------------------------------------------------------------------------------------------------------
+
+
+#pragma once
+
+#include "resonator.h"
+#include <algorithm>
+#include <array>
+#include <vector>
+
+namespace Uberton {
+namespace Math {
+
+// Evaluates a resonator (any ResonatorBase) at up to maxPickups output positions at once. The
+// output is one matrix-vector product y = Re(E·a) of the mode amplitudes a with the eigenfunctions
+// E at the pickup positions. E is stored mode by mode with the pickups padded to a multiple of
+// lanes, real parts first and negated imaginary parts second, so that for each mode the
+// contribution to all pickups is a few fused multiply-adds over contiguous memory that compilers
+// vectorize. Each pickup costs 2 multiply-adds per mode and sample which is a fraction of what
+// a separate resonator instance costs (excitation, evolution and output of every mode).
+//
+// The resonator is evolved as usual with delta() and step() (or next()). The storage is allocated
+// for maxPickups on construction, so setting and moving positions is real-time safe.
+//
+// Usage example:
+//
+//   ResonatorPickups<CubeResonator<float, 3, 200, 2>> pickups;
+//   pickups.setPositions(resonator, positions.data(), 6);
+//   ...
+//   resonator.delta(input);
+//   resonator.step();
+//   pickups.project(resonator, output.data());
+//
+template<class Resonator, int maxPickups = 16>
+class ResonatorPickups
+{
+public:
+	using real = typename Resonator::real;
+	using SpaceVec = typename Resonator::SpaceVec;
+
+	static constexpr int lanes = 8; // 256 bit of float
+	static_assert(maxPickups > 0, "template parameter maxPickups needs to be greater than 0");
+
+	ResonatorPickups() {
+		matrix.reserve(size_t(Resonator::maxOrder()) * 2 * maxStride);
+		evaluations.resize(Resonator::maxOrder());
+	}
+
+	/// Evaluate the eigenfunctions of resonator at numPickups positions (clamped to maxPickups)
+	void setPositions(Resonator& resonator, const SpaceVec* positions, int numPickups) {
+		pickups = std::clamp(numPickups, 0, maxPickups);
+		stride = (pickups + lanes - 1) / lanes * lanes;
+		matrix.assign(size_t(Resonator::maxOrder()) * 2 * stride, real{ 0 });
+		for (int p = 0; p < pickups; p++) {
+			evaluate(resonator, positions[p], p);
+		}
+		nextPickup = 0;
+	}
+
+	/// Move the pickups to positions that change continuously (ramps, modulation). Only one
+	/// pickup is evaluated per call, in turn, so the others follow within numPickups() calls at
+	/// the cost of a single evaluation. A different number of pickups is set at once.
+	void movePositions(Resonator& resonator, const SpaceVec* positions, int numPickups) {
+		if (std::clamp(numPickups, 0, maxPickups) != pickups) {
+			setPositions(resonator, positions, numPickups);
+			return;
+		}
+		if (pickups == 0) return;
+		evaluate(resonator, positions[nextPickup], nextPickup);
+		nextPickup = (nextPickup + 1) % pickups;
+	}
+
+	int numPickups() const { return pickups; }
+
+	/// Output of the current amplitudes of resonator at all pickups, out needs numPickups() elements
+	void project(const Resonator& resonator, real* out) const {
+		alignas(32) std::array<real, maxStride> sum{};
+		const int order = resonator.order();
+		const real* column = matrix.data();
+		for (int i = 0; i < order; i++, column += 2 * stride) {
+			const real aRe = resonator.amplitudes[i].real();
+			const real aIm = resonator.amplitudes[i].imag();
+			for (int p = 0; p < stride; p += lanes) {
+				for (int l = 0; l < lanes; l++) {
+					sum[p + l] += aRe * column[p + l] + aIm * column[stride + p + l];
+				}
+			}
+		}
+		std::copy(sum.begin(), sum.begin() + pickups, out);
+	}
+
+private:
+	static constexpr int maxStride = (maxPickups + lanes - 1) / lanes * lanes;
+
+	void evaluate(Resonator& resonator, const SpaceVec& position, int p) {
+		const int N = Resonator::maxOrder();
+		resonator.evaluateEigenFunctions(position, evaluations.data(), N);
+		for (int i = 0; i < N; i++) {
+			real* column = matrix.data() + size_t(i) * 2 * stride;
+			column[p] = evaluations[i].real();
+			column[stride + p] = -evaluations[i].imag();
+		}
+	}
+
+	std::vector<real> matrix; // [mode][real parts, negated imaginary parts][padded pickup]
+	std::vector<typename Resonator::scalar> evaluations; // eigenfunctions at one pickup
+	int pickups{ 0 };
+	int stride{ 0 };
+	int nextPickup{ 0 }; // evaluated by the next movePositions()
+};
+
+}
+}
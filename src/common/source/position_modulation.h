@@ -0,0 +1,119 @@
+
+// Audio rate modulation source for resonator positions
+//
+// -----------------------------------------------------------------------------------------------------------------------------
+// This file is part of the Überton project. Copyright (C) 2021 Überton
+//
+// Überton is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+// Überton is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details. You should
+// have received a copy of the GNU General Public License along with Überton. If not, see http://www.gnu.org/licenses/.
+// -----------------------------------------------------------------------------------------------------------------------------
+
+
+#pragma once
+
+#include "vstmath.h"
+#include <array>
+#include <cmath>
+#include <complex>
+
+namespace Uberton {
+namespace Math {
+
+// Computes a position offset per sample from an LFO and an envelope follower of the input.
+//
+// Every coordinate j is driven by the same sine LFO but with the phase shifted by 2πj/dim, so a
+// position moves along a closed curve instead of a line. The LFO is a complex phasor that is
+// rotated each sample (no transcendental functions per sample). The envelope follower output
+// (peak level of the input with attack and release) moves all coordinates by the same amount.
+//
+// Usage example:
+//
+//   PositionModulator<float, 3> modulator;
+//   modulator.setSampleRate(44100);
+//   modulator.setLFO(.5f, .1f);
+//   ...
+//   if (modulator.active()) resonator.moveInputPositions({ position + modulator.next(std::abs(input)) });
+//
+template<class T, int d>
+class PositionModulator
+{
+public:
+	using Vec = Vector<T, d>;
+
+	static constexpr T attackTime = T(.005);  // in seconds
+	static constexpr T releaseTime = T(.2);	  // in seconds
+	static constexpr int normalizeInterval = 256; // samples between renormalizations of the phasor
+
+	PositionModulator() { setDimension(d); }
+
+	/// Number of used coordinates (the phases are spread over them), at most d
+	void setDimension(int dim) {
+		for (int j = 0; j < d; j++) {
+			const T phi = 2 * pi<T>() * j / std::max(1, std::min(d, dim));
+			phaseCos[j] = std::cos(phi);
+			phaseSin[j] = std::sin(phi);
+		}
+	}
+
+	void setSampleRate(T sampleRate) {
+		this->sampleRate = sampleRate;
+		attack = 1 - std::exp(-1 / (attackTime * sampleRate));
+		release = 1 - std::exp(-1 / (releaseTime * sampleRate));
+		setLFO(lfoRate, lfoDepth);
+	}
+
+	/// Rate in Hz and depth (amplitude of the offset in position units)
+	void setLFO(T rate, T depth) {
+		lfoRate = rate;
+		lfoDepth = depth;
+		rotation = std::polar(T(1), 2 * pi<T>() * rate / sampleRate);
+	}
+
+	/// Offset per unit of input level
+	void setEnvelopeDepth(T depth) { envelopeDepth = depth; }
+
+	bool active() const { return lfoDepth != 0 || envelopeDepth != 0; }
+
+	/// Offset for the next sample, inputLevel is the absolute value of the current input
+	Vec next(T inputLevel) {
+		envelope += (inputLevel - envelope) * (inputLevel > envelope ? attack : release);
+		phasor *= rotation;
+		if (++counter == normalizeInterval) {
+			counter = 0;
+			phasor /= std::abs(phasor);
+		}
+		// Im(phasor·exp(iφ_j))
+		const T re = lfoDepth * phasor.real(), im = lfoDepth * phasor.imag();
+		const T env = envelopeDepth * envelope;
+		Vec offset;
+		for (int j = 0; j < d; j++) {
+			offset[j] = im * phaseCos[j] + re * phaseSin[j] + env;
+		}
+		return offset;
+	}
+
+	void reset() {
+		phasor = 1;
+		envelope = 0;
+		counter = 0;
+	}
+
+private:
+	T sampleRate{ 44100 };
+	T lfoRate{ 0 };
+	T lfoDepth{ 0 };
+	T envelopeDepth{ 0 };
+	T attack{ 1 };
+	T release{ 1 };
+	T envelope{ 0 };
+	std::complex<T> phasor{ 1 };
+	std::complex<T> rotation{ 1 };
+	int counter{ 0 };
+	std::array<T, d> phaseCos{}, phaseSin{};
+};
+
+}
+}
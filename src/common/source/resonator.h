@@ -3,6 +3,8 @@
 // - String
 // - 3D Sphere
 // - ND Cube
+// - ND Cuboid
+// - Circular membrane and cylinder
 //
 // -----------------------------------------------------------------------------------------------------------------------------
 // This file is part of the Überton project. Copyright (C) 2021 Überton
@@ -18,9 +20,16 @@
 #pragma once
 
 #include "vstmath.h"
+#include "simd.h"
 #include <vector>
+#include <cassert>
+#include <cstdint>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
 
 namespace Uberton {
 namespace Math {
@@ -63,6 +72,44 @@ namespace Math {
 // with spatial eigenfunctions φ(x) and corresponding eigenvalues k².
 //
 
+// Detects shapes that evaluate all eigenfunctions at once (see ResonatorBase::evaluateEigenFunctions())
+template<class Parent, class = void>
+struct hasEigenFunctionsKernel : std::false_type
+{};
+
+template<class Parent>
+struct hasEigenFunctionsKernel<Parent, std::void_t<decltype(std::declval<const Parent&>().eigenFunctions(
+										   std::declval<const typename Parent::SpaceVec&>(), std::declval<typename Parent::scalar*>(), 0))>> : std::true_type
+{};
+
+template<class Parent, class = void>
+struct hasRotatedEigenFunctions : std::false_type
+{};
+
+template<class Parent>
+struct hasRotatedEigenFunctions<Parent, std::void_t<decltype(std::declval<const Parent&>().eigenFunctionsRotated(
+											std::declval<const typename Parent::SpaceVec&>(), std::declval<typename Parent::scalar*>(), 0))>> : std::true_type
+{};
+
+// Detects shapes with a variable dimension (getDim())
+template<class Parent, class = void>
+struct hasVariableDimension : std::false_type
+{};
+
+template<class Parent>
+struct hasVariableDimension<Parent, std::void_t<decltype(std::declval<const Parent&>().getDim())>> : std::true_type
+{};
+
+// Detects shapes whose eigenfunctions depend on a configuration besides the type and the dimension
+// (shapeId(), e.g. aspect ratios or a loaded mode table)
+template<class Parent, class = void>
+struct hasShapeId : std::false_type
+{};
+
+template<class Parent>
+struct hasShapeId<Parent, std::void_t<decltype(std::declval<const Parent&>().shapeId())>> : std::true_type
+{};
+
 template<class Parent, class T, int d, int N, int channels>
 class ResonatorBase : public Parent
 {
@@ -78,6 +125,10 @@ public:
 	template<class TT, int n>
 	using array = std::array<TT, n>;
 
+	// sparse excitation (see excitationRuns())
+	static constexpr int maxExcitationRuns = 32;
+	static constexpr int minExcitationGap = 16;
+
 	/// Initialize resonator with sample rate in Hz (i.e. 44100)
 	void setSampleRate(T sampleRate) {
 		this->deltaT = T{ 1. } / sampleRate;
@@ -88,48 +139,335 @@ public:
 	/// can be set lower than N (the max order)
 	void setOrder(int order) {
 		this->nOrder = std::max(1, std::min(N, order));
+		fadeSteps = 0;
+	}
+
+	/// Like setOrder() but without clicks: the modes above a lower order are faded out over the
+	/// next numSteps samples before they stop being computed (order() stays at the old value
+	/// until then), modes added by a higher order start silent.
+	///
+	/// A new order during a running fade retargets it: modes below the new order stop fading and
+	/// ring on from their current (attenuated) amplitude, modes that were fading already keep
+	/// their remaining fade when the new order is higher than the old target and continue from
+	/// their attenuated amplitude at the new rate when it is lower.
+	void fadeToOrder(int order, int numSteps) {
+		order = std::max(1, std::min(N, order));
+		if (order >= nOrder || numSteps <= 1) {
+			for (int i = std::min(order, nOrder); i < std::max(order, nOrder); i++) {
+				amplitudes[i] = 0;
+				resyncAnchors[i] = 0;
+			}
+			nOrder = order;
+			fadeSteps = 0;
+			return;
+		}
+		if (fadeSteps > 0 && order >= fadeOrder) {
+			fadeOrder = order; // the modes in between are restored, the others fade on
+			return;
+		}
+		fadeOrder = order;
+		fadeSteps = numSteps;
+		fadeFactor = static_cast<real>(std::pow(1e-4, 1. / numSteps)); // -80 dB at the end
+	}
+
+	/// Resynchronize the amplitudes every numSamples samples (0 disables it). The recursion
+	/// amplitude *= timeFunction accumulates the rounding errors of the time functions and of
+	/// the amplitudes themselves, in float this makes undamped modes grow or decay by many dB
+	/// within hours. At each resync the amplitudes of modes that received no input during the
+	/// interval are recomputed in double from their value at the previous resync and exp(iωΔt)ⁿ.
+	/// Otherwise they are multiplied by exp(iωΔt)ⁿ / timeFunctionⁿ which at least removes the
+	/// error of the time functions. Disabled by default because it changes the output slightly, a
+	/// few thousand samples (e.g. 4096) suit float instances that run freely for a long time.
+	void setResyncInterval(int numSamples) {
+		resyncInterval = std::max(0, numSamples);
+		computeResyncFactors(glideSteps > 0 ? glideTargets : timeFunctions);
+		startResyncInterval();
 	}
 
 
 	/// Excite the system at current input positions with a peak of given amounts
 	void delta(const array<real, channels>& amount) {
 		for (int ch = 0; ch < channels; ++ch) {
-			for (int i = 0; i < nOrder; ++i) {
-				amplitudes[i] += amount[ch] * inputPosEF[ch][i];
-			}
+			if (amount[ch] == 0) continue; // sparse input (gated or percussive) is mostly zero
+			excitedSinceResync = true;
+			Simd::kernels<real>().accumulate(amplitudes.data(), inputPosEF[ch].data(), amount[ch], nOrder);
 		}
 	}
 
+	/// Excite all input positions with the same amount, equivalent to delta() with amount on every
+	/// channel but with the precomputed sum of the input eigenfunctions (half the cost for stereo)
+	void deltaMono(real amount) {
+		if (amount == 0) return;
+		excitedSinceResync = true;
+		Simd::kernels<real>().accumulate(amplitudes.data(), monoInputPosEF.data(), amount, nOrder);
+	}
+
+	/// Excitation of a strike at x for strike(), stateSize() values. Computing it once (e.g. per
+	/// note) saves the eigenfunction evaluation at each note-on.
+	void strikeVector(const SpaceVec& x, scalar* vector) const {
+		evaluateEigenFunctions(x, vector, N);
+	}
+
+	/// Excite the system with an impulse of the given amount at the position of a strike vector
+	/// (see strikeVector()), an event instead of an input signal that is mostly zero
+	void strike(const scalar* vector, real amount) {
+		if (amount == 0) return;
+		excitedSinceResync = true;
+		Simd::kernels<real>().accumulate(amplitudes.data(), vector, amount, nOrder);
+	}
+
 	/// Compute next time step and get the evaluations at the output positions
 	array<real, channels> next() {
 		evolve();
 		array<real, channels> results{ 0 };
 		for (int ch = 0; ch < channels; ++ch) {
-			for (int i = 0; i < nOrder; ++i) {
-				results[ch] += (amplitudes[i] * outputPosEF[ch][i]).real();
-			}
+			results[ch] = Simd::kernels<real>().projectReal(amplitudes.data(), outputPosEF[ch].data(), nOrder);
 		}
 		return results;
 	}
 
+	/// Excite with the given amounts and compute the next time step, the same as delta() followed
+	/// by next() but in a single pass over the modes for up to two channels (see ResonatorNetwork).
+	/// Glides, fades and resyncs take the separate passes.
+	array<real, channels> next(const array<real, channels>& amount) {
+		if constexpr (channels > 2) {
+			delta(amount);
+			return next();
+		}
+		else {
+			if (glideSteps > 0 || fadeSteps > 0 || (resyncInterval > 0 && resyncCounter + 1 == resyncInterval)) {
+				delta(amount);
+				return next();
+			}
+			const scalar* inputs[2];
+			const scalar* outputs[2];
+			real amounts[2];
+			int numInputs = 0;
+			for (int ch = 0; ch < channels; ++ch) {
+				outputs[ch] = outputPosEF[ch].data();
+				if (amount[ch] == 0) continue;
+				inputs[numInputs] = inputPosEF[ch].data();
+				amounts[numInputs++] = amount[ch];
+			}
+			if (numInputs > 0) excitedSinceResync = true;
+			absoluteTime += deltaT;
+			if (resyncInterval > 0) ++resyncCounter;
+			array<real, channels> results{ 0 };
+			Simd::kernels<real>().step(amplitudes.data(), timeFunctions.data(), inputs, amounts, numInputs, outputs, results.data(), channels, nOrder);
+			return results;
+		}
+	}
+
+	/// Compute the next time step without evaluating the outputs (see ResonatorPickups)
+	void step() {
+		evolve();
+	}
+
+	/// Block processing of the modes [begin, end): the same as calling delta() and next() for each
+	/// sample but mode by mode. The outputs of these modes are added to out. Disjoint mode ranges
+	/// can be processed concurrently (see ParallelResonatorBank). When all modes have been processed,
+	/// finishModes(in, numSamples) needs to be called once. The excitation is only computed for
+	/// the runs of samples with input (see excitationRuns()). Blocks without glide, fade and resync
+	/// take a vectorized pass over the range for each sample instead (see Simd::Kernels::step).
+	void processModes(const real* const* in, real* const* out, int numSamples, int begin, int end) {
+		if constexpr (channels <= 2) {
+			if (glideSteps == 0 && fadeSteps == 0 && nextResync(numSamples) >= numSamples) {
+				stepModes(in, out, numSamples, begin, end);
+				return;
+			}
+		}
+		const int glide = std::min(glideSteps, numSamples);
+		const int firstResync = nextResync(numSamples);
+		std::array<std::pair<int, int>, maxExcitationRuns> runs;
+		const int numRuns = excitationRuns(in, numSamples, runs);
+		const int firstInput = numRuns > 0 ? runs[0].first : numSamples;
+		const int lastInput = numRuns > 0 ? runs[numRuns - 1].second - 1 : -1;
+		// alternating stretches without (even) and with input (odd), stretch s ends at bounds[s]
+		std::array<int, 2 * maxExcitationRuns + 1> bounds;
+		for (int r = 0; r < numRuns; ++r) {
+			bounds[2 * r] = runs[r].first;
+			bounds[2 * r + 1] = runs[r].second;
+		}
+		bounds[2 * numRuns] = numSamples;
+		const int numStretches = 2 * numRuns + 1;
+		for (int i = begin; i < end; ++i) {
+			int resync = firstResync;
+			int intervalStart = glideSteps > 0 ? glideSteps - 1 : -1; // -1: started in a previous block
+			real aRe = amplitudes[i].real(), aIm = amplitudes[i].imag();
+			real tRe = timeFunctions[i].real(), tIm = timeFunctions[i].imag();
+			const real rRe = glideRatios[i].real(), rIm = glideRatios[i].imag();
+			const bool fading = fadeSteps > 0 && i >= fadeOrder;
+			for (int s = 0, n = 0; s < numStretches; ++s) {
+				const bool excite = s & 1;
+				for (; n < bounds[s]; ++n) {
+					if (excite) {
+						for (int ch = 0; ch < channels; ++ch) {
+							aRe += in[ch][n] * inputPosEF[ch][i].real();
+							aIm += in[ch][n] * inputPosEF[ch][i].imag();
+						}
+					}
+					if (n + 1 == glideSteps) {
+						tRe = glideTargets[i].real(), tIm = glideTargets[i].imag();
+						resyncAnchors[i] = std::complex<double>(aRe, aIm);
+					}
+					else if (n < glide) {
+						const real t = tRe * rRe - tIm * rIm;
+						tIm = tRe * rIm + tIm * rRe;
+						tRe = t;
+					}
+					const real re = aRe * tRe - aIm * tIm;
+					aIm = aRe * tIm + aIm * tRe;
+					aRe = re;
+					if (fading) {
+						if (n + 1 >= fadeSteps) {
+							aRe = 0, aIm = 0;
+						}
+						else {
+							aRe *= fadeFactor, aIm *= fadeFactor;
+						}
+					}
+					if (n == resync) {
+						// conservative: input anywhere between the first and last excitation counts
+						const bool silent = (intervalStart >= 0 || !excitedSinceResync) && (n < firstInput || intervalStart >= lastInput);
+						const scalar a = resyncMode(i, scalar(aRe, aIm), silent);
+						aRe = a.real(), aIm = a.imag();
+						intervalStart = n;
+						resync += resyncInterval;
+					}
+					for (int ch = 0; ch < channels; ++ch) {
+						out[ch][n] += aRe * outputPosEF[ch][i].real() - aIm * outputPosEF[ch][i].imag();
+					}
+				}
+			}
+			amplitudes[i] = scalar(aRe, aIm);
+			timeFunctions[i] = scalar(tRe, tIm);
+		}
+	}
+
+	// processModes() for blocks without glide, fade and resync
+	void stepModes(const real* const* in, real* const* out, int numSamples, int begin, int end) {
+		const scalar* inputs[2];
+		const scalar* outputs[2];
+		real amounts[2];
+		real results[2];
+		for (int ch = 0; ch < channels; ++ch) {
+			outputs[ch] = outputPosEF[ch].data() + begin;
+		}
+		for (int n = 0; n < numSamples; ++n) {
+			int numInputs = 0;
+			for (int ch = 0; ch < channels; ++ch) {
+				if (in[ch][n] == 0) continue;
+				inputs[numInputs] = inputPosEF[ch].data() + begin;
+				amounts[numInputs++] = in[ch][n];
+			}
+			Simd::kernels<real>().step(amplitudes.data() + begin, timeFunctions.data() + begin, inputs, amounts, numInputs, outputs, results, channels, end - begin);
+			for (int ch = 0; ch < channels; ++ch) {
+				out[ch][n] += results[ch];
+			}
+		}
+	}
+
+	/// Advance the glide, fade and resync state after processModes() (with the same input)
+	void finishModes(const real* const* in, int numSamples) {
+		if (glideSteps > 0 && glideSteps <= numSamples) {
+			// like evolve(), modes that are not computed get the glide targets too
+			for (int i = nOrder; i < N; i++) {
+				timeFunctions[i] = glideTargets[i];
+			}
+		}
+		if (fadeSteps > numSamples) {
+			fadeSteps -= numSamples;
+		}
+		else if (fadeSteps > 0) {
+			nOrder = fadeOrder;
+			fadeSteps = 0;
+		}
+		if (glideSteps > numSamples) {
+			glideSteps -= numSamples;
+			if (excitationRange(in, numSamples).second >= 0) excitedSinceResync = true;
+			return;
+		}
+		if (resyncInterval > 0) {
+			const int counter = glideSteps > 0 ? 0 : resyncCounter;
+			const int counted = glideSteps > 0 ? numSamples - glideSteps + 1 : numSamples;
+			int intervalStart = glideSteps > 0 ? glideSteps - 1 : -1;
+			resyncCounter = (counter + counted) % resyncInterval;
+			if (counter + counted >= resyncInterval) {
+				intervalStart = numSamples - 1 - resyncCounter; // last resync
+			}
+			if (intervalStart >= 0) excitedSinceResync = false;
+			if (excitationRange(in, numSamples).second > intervalStart) excitedSinceResync = true;
+		}
+		glideSteps = 0;
+	}
+
 	/// Set the "listening" positions (normalized to [0,1])
 	void setOutputPositions(const array<SpaceVec, channels>& outPositions) {
 		for (int ch = 0; ch < channels; ++ch) {
-			for (int i = 0; i < N; ++i) {
-				outputPosEF[ch][i] = this->eigenFunction(i, outPositions[ch]);
-			}
+			evaluateEigenFunctions(outPositions[ch], outputPosEF[ch].data(), N);
 		}
 	}
 
 	/// Set the "playing" or exciting position (normalized to [0,1])
 	void setInputPositions(const array<SpaceVec, channels>& inPositions) {
 		for (int ch = 0; ch < channels; ++ch) {
-			for (int i = 0; i < N; ++i) {
-				inputPosEF[ch][i] = this->eigenFunction(i, inPositions[ch]);
+			evaluateEigenFunctions(inPositions[ch], inputPosEF[ch].data(), N);
+		}
+		for (int i = 0; i < N; ++i) {
+			monoInputPosEF[i] = 0;
+			for (int ch = 0; ch < channels; ++ch) {
+				monoInputPosEF[i] += inputPosEF[ch][i];
+			}
+		}
+	}
+
+	/// Like setOutputPositions() but the eigenfunctions are taken from the cache (see
+	/// EigenFunctionCache) if they have been evaluated at the same position before, by any
+	/// resonator of this shape and dimension, and are added to it otherwise. Only worth it for
+	/// positions that are likely to come again (presets, ramp targets). blocking = false is for
+	/// the audio thread, a busy cache counts as a miss then. A miss is not free there: the
+	/// eigenfunctions are evaluated on the calling thread (like setOutputPositions() without
+	/// the cache) plus a scan of the cache to store them, so the cache only lowers the average
+	/// cost and not the worst case. Fill it beforehand with blocking = true off the audio thread.
+	template<class Cache>
+	void setOutputPositions(const array<SpaceVec, channels>& outPositions, Cache& cache, bool blocking = false) {
+		for (int ch = 0; ch < channels; ++ch) {
+			lookUpEigenFunctions(outPositions[ch], outputPosEF[ch].data(), cache, blocking);
+		}
+	}
+
+	/// Like setInputPositions() but with the cache, see setOutputPositions()
+	template<class Cache>
+	void setInputPositions(const array<SpaceVec, channels>& inPositions, Cache& cache, bool blocking = false) {
+		for (int ch = 0; ch < channels; ++ch) {
+			lookUpEigenFunctions(inPositions[ch], inputPosEF[ch].data(), cache, blocking);
+		}
+		for (int i = 0; i < N; ++i) {
+			monoInputPosEF[i] = 0;
+			for (int ch = 0; ch < channels; ++ch) {
+				monoInputPosEF[i] += inputPosEF[ch][i];
 			}
 		}
 	}
 
+	/// Evaluate the eigenfunctions of all modes at x through the cache, fills it on a miss
+	template<class Cache>
+	void lookUpEigenFunctions(const SpaceVec& x, scalar* out, Cache& cache, bool blocking = false) const {
+		std::size_t shape = typeid(Parent).hash_code();
+		if constexpr (hasShapeId<Parent>::value) shape ^= this->shapeId() * 0x9e3779b97f4a7c15ull;
+		const auto key = cache.makeKey(shape, dimension(), x);
+		if (blocking ? cache.find(key, out) : cache.tryFind(key, out)) return;
+		evaluateEigenFunctions(cache.position(key), out, N);
+		if (blocking) cache.insert(key, out);
+		else cache.tryInsert(key, out);
+	}
+
+	/// Number of used coordinates
+	int dimension() const {
+		if constexpr (hasVariableDimension<Parent>::value) return this->getDim();
+		else return d;
+	}
+
 	/// Set the base frequency (redirect to adjust i.e. the system size), dampening coefficient
 	/// and (sonic) velocity
 	void setFreqDampeningAndVelocity(real freq, real dampening, real velocity) {
@@ -139,15 +477,160 @@ public:
 		update();
 	}
 
+	/// Like setFreqDampeningAndVelocity() but the mode frequencies and decay rates glide
+	/// exponentially to the new values over the next numSteps samples (i.e. calls to next()).
+	/// Instead of recomputing the time functions each sample they are multiplied by a constant
+	/// per-mode ratio. At the end of the glide they are set to the exact target values so that
+	/// rounding errors do not accumulate over successive glides.
+	void glideFreqDampeningAndVelocity(real freq, real dampening, real velocity, int numSteps) {
+		if (numSteps <= 1) {
+			setFreqDampeningAndVelocity(freq, dampening, velocity);
+			return;
+		}
+		this->b = dampening;
+		this->c = velocity;
+		this->setDesiredBaseFrequency(freq, dampening, velocity);
+
+		// exp(iω₁Δt) = exp(iω₀Δt)·exp(i(ω₁-ω₀)Δt/n)ⁿ
+		constexpr scalar imagUnit = scalar(0, 1);
+		const T stepDeltaT = deltaT / numSteps;
+		for (int i = 0; i < N; i++) {
+			const scalar frequency = this->frequency(i);
+			glideRatios[i] = std::exp(imagUnit * (frequency - frequencies[i]) * stepDeltaT);
+			glideTargets[i] = std::exp(imagUnit * frequency * deltaT);
+			frequencies[i] = frequency;
+		}
+		glideSteps = numSteps;
+		computeResyncFactors(glideTargets);
+	}
+
 	/// Clear the system, setting all amplitudes to zero
 	void clear() {
 		for (int i = 0; i < N; ++i) {
 			amplitudes[i] = 0;
+			resyncAnchors[i] = 0;
+		}
+	}
+
+	/// Let the system run freely (without input or output) for numSamples samples at the cost of
+	/// a single sample: the amplitudes are multiplied by exp(iωΔt)ⁿ, computed in double from the
+	/// frequencies. A running glide or order fade is stepped through sample by sample first.
+	void advance(std::int64_t numSamples) {
+		while ((glideSteps > 0 || fadeSteps > 0) && numSamples > 0) {
+			evolve();
+			--numSamples;
+		}
+		if (numSamples <= 0) return;
+		using complex = std::complex<double>;
+		const double duration = double(deltaT) * double(numSamples);
+		for (int i = 0; i < nOrder; i++) {
+			amplitudes[i] = scalar(complex(amplitudes[i]) * std::exp(complex(0, 1) * complex(frequencies[i]) * duration));
+		}
+		absoluteTime += real(duration);
+		startResyncInterval(); // the amplitudes are exact now
+	}
+
+	/// Number of values written by snapshot() and read by restore()
+	static constexpr int stateSize() { return N; }
+
+	/// Copy the amplitudes of all modes (the state of the system) to buffer (stateSize() values)
+	void snapshot(scalar* buffer) const {
+		std::copy(amplitudes.begin(), amplitudes.end(), buffer);
+	}
+
+	/// Set the amplitudes of all modes from buffer (stateSize() values, see snapshot())
+	void restore(const scalar* buffer) {
+		std::copy(buffer, buffer + N, amplitudes.begin());
+		startResyncInterval();
+	}
+
+	/// Set modes that have decayed below threshold to zero. Otherwise their amplitudes eventually
+	/// become subnormal numbers which are very slow to compute with (unless flushed to zero by
+	/// the CPU, see ProcessorUtilities::DenormalScope).
+	void flushDecayedModes(real threshold) {
+		const real thresholdSq = threshold * threshold;
+		for (int i = 0; i < nOrder; ++i) {
+			if (std::norm(amplitudes[i]) < thresholdSq) {
+				amplitudes[i] = 0;
+			}
+		}
+	}
+
+	/// Evaluate the eigenfunctions of the first n modes at x. Uses the dimension specialized
+	/// eigenFunctions() of the shape if it has one, otherwise eigenFunction() for each mode.
+	void evaluateEigenFunctions(const SpaceVec& x, scalar* out, int n) const {
+		if constexpr (hasEigenFunctionsKernel<Parent>::value) {
+			this->eigenFunctions(x, out, n);
+		}
+		else {
+			for (int i = 0; i < n; ++i) {
+				out[i] = this->eigenFunction(i, x);
+			}
+		}
+	}
+
+	/// Input positions that change every sample (audio rate modulation): like setInputPositions()
+	/// but uses the faster, slightly less accurate eigenFunctionsRotated() of the shape if it has one
+	void moveInputPositions(const array<SpaceVec, channels>& inPositions) {
+		for (int ch = 0; ch < channels; ++ch) {
+			evaluateEigenFunctionsRotated(inPositions[ch], inputPosEF[ch].data(), N);
+		}
+		for (int i = 0; i < N; ++i) {
+			monoInputPosEF[i] = 0;
+			for (int ch = 0; ch < channels; ++ch) {
+				monoInputPosEF[i] += inputPosEF[ch][i];
+			}
 		}
 	}
 
+	/// Output positions that change every sample, see moveInputPositions()
+	void moveOutputPositions(const array<SpaceVec, channels>& outPositions) {
+		for (int ch = 0; ch < channels; ++ch) {
+			evaluateEigenFunctionsRotated(outPositions[ch], outputPosEF[ch].data(), N);
+		}
+	}
+
+	/// Whether moveInputPositions()/moveOutputPositions() are cheap enough to be called every sample
+	static constexpr bool hasFastPositionUpdates() { return hasRotatedEigenFunctions<Parent>::value; }
+
+	/// Like evaluateEigenFunctions() but with the shape's eigenFunctionsRotated() if it has one
+	void evaluateEigenFunctionsRotated(const SpaceVec& x, scalar* out, int n) const {
+		if constexpr (hasRotatedEigenFunctions<Parent>::value) {
+			this->eigenFunctionsRotated(x, out, n);
+		}
+		else {
+			evaluateEigenFunctions(x, out, n);
+		}
+	}
+
+	/// Properties of a mode as it is currently run
+	struct ModeInfo
+	{
+		real k;								 // square root of the eigenvalue
+		real frequency;						 // in Hz
+		real decayTime;						 // T60 in seconds
+		bool aboveNyquist;					 // such a mode aliases to a lower frequency
+		array<real, channels> inputCoupling;  // |eigenfunction| at the input positions
+		array<real, channels> outputCoupling; // |eigenfunction| at the output positions
+	};
+
+	/// Get frequency, decay time and position coupling of mode i < N (for analysis, see the
+	/// mode_table tool). Only the first order() modes are run.
+	ModeInfo modeInfo(int i) const {
+		ModeInfo info;
+		info.k = std::real(this->eigenValueSqrt(i));
+		info.frequency = frequencies[i].real() / (2 * pi<real>());
+		info.decayTime = frequencies[i].imag() > 0 ? std::log(real(1000)) / frequencies[i].imag() : std::numeric_limits<real>::infinity();
+		info.aboveNyquist = info.frequency * deltaT > real(.5);
+		for (int ch = 0; ch < channels; ++ch) {
+			info.inputCoupling[ch] = std::abs(inputPosEF[ch][i]);
+			info.outputCoupling[ch] = std::abs(outputPosEF[ch][i]);
+		}
+		return info;
+	}
+
 	T time() const { return time; }
-	int order() { return nOrder; }
+	int order() const { return nOrder; }
 	static constexpr int maxDimension() { return d; }
 	static constexpr int maxOrder() { return N; }
 	static constexpr int numChannels() { return channels; }
@@ -156,14 +639,142 @@ protected:
 	void update() {
 		constexpr scalar imagUnit = scalar(0, 1);
 		for (int i = 0; i < N; i++) {
-			timeFunctions[i] = std::exp(imagUnit * this->frequency(i) * deltaT);
+			frequencies[i] = this->frequency(i);
+			timeFunctions[i] = std::exp(imagUnit * frequencies[i] * deltaT);
+		}
+		glideSteps = 0;
+		computeResyncFactors(timeFunctions);
+		startResyncInterval();
+	}
+
+	// exp(iωΔt)ⁿ and exp(iωΔt)ⁿ / timeFunctionⁿ for n = resyncInterval, timeFunctions are the
+	// ones used after a possibly running glide
+	void computeResyncFactors(const array<scalar, N>& timeFunctions) {
+		if (resyncInterval == 0) return;
+		using complex = std::complex<double>;
+		const complex imagUnit(0, 1);
+		const double intervalDeltaT = double(deltaT) * resyncInterval;
+		for (int i = 0; i < N; i++) {
+			resyncRotations[i] = std::exp(imagUnit * complex(frequencies[i]) * intervalDeltaT);
+			const complex rounded = std::exp(std::log(complex(timeFunctions[i])) * double(resyncInterval));
+			resyncCorrections[i] = resyncRotations[i] / rounded;
+		}
+	}
+
+	void startResyncInterval() {
+		resyncCounter = 0;
+		excitedSinceResync = false;
+		for (int i = 0; i < N; i++) {
+			resyncAnchors[i] = amplitudes[i];
+		}
+	}
+
+	// New amplitude of mode i at the end of a resync interval
+	scalar resyncMode(int i, scalar amplitude, bool silent) {
+		using complex = std::complex<double>;
+		const complex a(amplitude);
+		complex result = a * resyncCorrections[i];
+		if (silent) {
+			const complex exact = resyncAnchors[i] * resyncRotations[i];
+			// the amplitudes may have been changed from outside
+			if (std::norm(exact - result) <= resyncTolerance * std::norm(result)) result = exact;
+		}
+		resyncAnchors[i] = result;
+		return scalar(result);
+	}
+
+	// Runs [first, last + 1) of samples with non-zero input on any channel. Gaps shorter than
+	// minExcitationGap samples are not worth switching for and belong to the run, after
+	// maxExcitationRuns - 1 runs the rest of the block is one run. Returns the number of runs.
+	static int excitationRuns(const real* const* in, int numSamples, std::array<std::pair<int, int>, maxExcitationRuns>& runs) {
+		auto excited = [&](int n) {
+			for (int ch = 0; ch < channels; ++ch) {
+				if (in[ch][n] != 0) return true;
+			}
+			return false;
+		};
+		int numRuns = 0;
+		int n = 0;
+		while (n < numSamples) {
+			while (n < numSamples && !excited(n)) ++n;
+			if (n == numSamples) break;
+			if (numRuns == maxExcitationRuns - 1) {
+				int last = numSamples - 1;
+				while (!excited(last)) --last;
+				runs[numRuns++] = { n, last + 1 };
+				break;
+			}
+			const int first = n;
+			int gap = 0;
+			for (; n < numSamples && gap < minExcitationGap; ++n) {
+				gap = excited(n) ? 0 : gap + 1;
+			}
+			runs[numRuns++] = { first, n - gap };
+		}
+		return numRuns;
+	}
+
+	// Indices of the first and last sample with any non-zero input (numSamples, -1 if silent)
+	static std::pair<int, int> excitationRange(const real* const* in, int numSamples) {
+		int first = numSamples, last = -1;
+		for (int ch = 0; ch < channels; ++ch) {
+			for (int n = 0; n < first; ++n) {
+				if (in[ch][n] != 0) {
+					first = n;
+					break;
+				}
+			}
+			for (int n = numSamples - 1; n > last; --n) {
+				if (in[ch][n] != 0) {
+					last = n;
+					break;
+				}
+			}
 		}
+		return { first, last };
+	}
+
+	// Index of the first sample in a block of numSamples after which processModes() resyncs
+	// (numSamples if none). The sample that ends a glide is the first one of a new interval.
+	int nextResync(int numSamples) const {
+		if (resyncInterval == 0 || glideSteps > numSamples) return numSamples;
+		if (glideSteps > 0) return glideSteps - 1 + resyncInterval - 1;
+		return resyncInterval - resyncCounter - 1;
 	}
 
 	void evolve() {
 		absoluteTime += deltaT;
-		for (int i = 0; i < nOrder; i++) {
-			amplitudes[i] *= timeFunctions[i]; // precomputing these is up to 20 times faster
+		if (glideSteps > 0) {
+			if (--glideSteps == 0) {
+				timeFunctions = glideTargets;
+				startResyncInterval();
+			}
+			else {
+				Simd::kernels<real>().rotate(timeFunctions.data(), glideRatios.data(), nOrder);
+			}
+		}
+		// precomputing the time functions is up to 20 times faster, the rotation uses the widest
+		// vectors of the CPU (see simd.h)
+		Simd::kernels<real>().rotate(amplitudes.data(), timeFunctions.data(), nOrder);
+		if (fadeSteps > 0) {
+			if (--fadeSteps == 0) {
+				for (int i = fadeOrder; i < nOrder; i++) {
+					amplitudes[i] = 0;
+				}
+				nOrder = fadeOrder;
+			}
+			else {
+				for (int i = fadeOrder; i < nOrder; i++) {
+					amplitudes[i] *= fadeFactor;
+				}
+			}
+		}
+		if (resyncInterval > 0 && glideSteps == 0 && ++resyncCounter == resyncInterval) {
+			for (int i = 0; i < nOrder; i++) {
+				amplitudes[i] = resyncMode(i, amplitudes[i], !excitedSinceResync);
+			}
+			resyncCounter = 0;
+			excitedSinceResync = false;
 		}
 	}
 
@@ -181,12 +792,33 @@ public:
 	real b{ .1f };					  // dampening factor
 	array<scalar, N> amplitudes{};	  // current weights for frequency component
 	array<scalar, N> timeFunctions{}; // precomputed exponential time functions
+	array<scalar, N> frequencies{};	  // ω for each mode, timeFunctions = exp(iωΔt)
+
+	// running glide (see glideFreqDampeningAndVelocity())
+	array<scalar, N> glideRatios{};
+	array<scalar, N> glideTargets{};
+	int glideSteps{ 0 };
+
+	// periodic resynchronization (see setResyncInterval())
+	static constexpr double resyncTolerance = 1e-8; // squared relative deviation
+	array<std::complex<double>, N> resyncRotations{};
+	array<std::complex<double>, N> resyncCorrections{};
+	array<std::complex<double>, N> resyncAnchors{}; // amplitudes at the last resync
+	int resyncInterval{ 0 };
+	int resyncCounter{ 0 };
+	bool excitedSinceResync{ false };
 
 	// eigenfunction evaluations at input/output positions
 	array<array<scalar, N>, channels> outputPosEF{};
 	array<array<scalar, N>, channels> inputPosEF{};
+	array<scalar, N> monoInputPosEF{}; // sum over all input positions (see deltaMono())
 
 	int nOrder{ N };
+
+	// running order fade (see fadeToOrder())
+	int fadeOrder{ N };
+	int fadeSteps{ 0 };
+	real fadeFactor{ 1 };
 };
 
 
@@ -242,7 +874,7 @@ public:
 	CubeEigenValues() {
 		computeFirstEigenvalues();
 		for (auto& a : ksAndEV) {
-			for (int i = 0; i < a.size(); i++) {
+			for (size_t i = 0; i < a.size(); i++) {
 				//FDebugPrint("%f, ", a[i]);
 			}
 			//FDebugPrint("\n");
@@ -331,7 +963,6 @@ std::vector<std::vector<T>> computeFirstEigenvalues(int dim, int numEigenvalues)
 	// V_sphere = N·2ᵈ
 	//std::cout << dim << "\n";
 	using real = T;
-	using scalar = std::complex<real>;
 	using KVec = std::vector<real>;
 
 	auto radiusOfNSphere = [&](real volume) {
@@ -497,6 +1128,7 @@ public:
 			assert(storage.matrices[0].data.size() >= N);
 		}
 		initialized = true;
+		updateKernel();
 	}
 
 	void setDim(int newDim) {
@@ -506,6 +1138,7 @@ public:
 			dim = maxDim;
 		else
 			dim = newDim;
+		updateKernel();
 	}
 
 	int getDim() const { return dim; }
@@ -526,6 +1159,21 @@ public:
 		return result;
 	}
 
+	/// Evaluate the first n eigenfunctions at x, same results as eigenFunction() but with a
+	/// kernel for the current dimension that is selected in setDim()
+	void eigenFunctions(const SpaceVec& x, scalar* out, int n) const {
+		assert(initialized);
+		(this->*kernel)(x, out, n);
+	}
+
+	/// Like eigenFunctions() but sin(k·π·x) is computed by complex rotation from sin(π·x) instead
+	/// of with std::sin, which costs about as much as the products themselves. Errors grow with
+	/// k to about k·ε. Meant for positions that change every sample.
+	void eigenFunctionsRotated(const SpaceVec& x, scalar* out, int n) const {
+		assert(initialized);
+		(this->*rotatedKernel)(x, out, n);
+	}
+
 	void setDesiredBaseFrequency(real f, real b, real c) {
 		constexpr real pi = Uberton::Math::pi<real>();
 		const real w = 2 * pi * f;
@@ -533,10 +1181,75 @@ public:
 	}
 
 private:
+	using CoeffType = typename CubeEWPCalculator<T>::CoeffType;
+	using Kernel = void (PreComputedCubeEigenValues::*)(const SpaceVec&, scalar*, int) const;
+
+	template<bool rotate, size_t... d>
+	static constexpr std::array<Kernel, maxDim> makeKernels(std::index_sequence<d...>) {
+		return { &PreComputedCubeEigenValues::eigenFunctionsKernel<d + 1, rotate>... };
+	}
+
+	// Copies the coefficients of the current dimension to a flat [mode][j] array
+	void updateKernel() {
+		if (!initialized) return;
+		const auto& data = storage.matrices[dim - 1].data;
+		int maxCoeff = 0;
+		for (int i = 0; i < N; i++) {
+			for (int j = 0; j < dim; j++) {
+				coeffs[i * dim + j] = data[i].coeffs[j];
+				maxCoeff = std::max(maxCoeff, static_cast<int>(data[i].coeffs[j]));
+			}
+		}
+		assert(maxCoeff <= N); // mode (k, 1, ..., 1) comes after all (k', 1, ..., 1) with k' < k
+		numSines = maxCoeff + 1;
+		kernel = makeKernels<false>(std::make_index_sequence<maxDim>())[dim - 1];
+		rotatedKernel = makeKernels<true>(std::make_index_sequence<maxDim>())[dim - 1];
+	}
+
+	// The sines only depend on the coefficient and the coordinate, so they are computed once
+	// for each coefficient that occurs instead of once per mode. They are kept on the stack one
+	// coordinate at a time (no allocation, and evaluations on several threads do not interfere).
+	template<int d, bool rotate>
+	void eigenFunctionsKernel(const SpaceVec& x, scalar* out, int n) const {
+		constexpr real pi = Uberton::Math::pi<real>();
+		std::array<real, N + 1> sines; // sin(k·π·x[j])
+		for (int j = 0; j < d; ++j) {
+			if constexpr (rotate) {
+				const scalar rotation = std::polar(real(1), pi * x[j]);
+				scalar z = 1; // exp(i·k·π·x)
+				for (int k = 0; k < numSines; ++k) {
+					sines[k] = z.imag();
+					z *= rotation;
+				}
+			}
+			else {
+				for (int k = 0; k < numSines; ++k) {
+					sines[k] = std::sin(static_cast<real>(k) * pi * x[j]);
+				}
+			}
+			const CoeffType* c = coeffs.data() + j;
+			if (j == 0) {
+				for (int i = 0; i < n; ++i, c += d) {
+					out[i] = sines[*c];
+				}
+			}
+			else {
+				for (int i = 0; i < n; ++i, c += d) {
+					out[i] = out[i].real() * sines[*c];
+				}
+			}
+		}
+	}
+
 	CubeEWPStorage<T, maxDim> storage;
 	real length{ 1 };
 	int dim{ maxDim };
 	bool initialized{ false };
+
+	std::array<CoeffType, N * maxDim> coeffs{}; // of the current dimension, [mode][j]
+	int numSines{ 0 };							 // largest coefficient + 1
+	Kernel kernel{ nullptr };
+	Kernel rotatedKernel{ nullptr };
 };
 
 template<class T, int maxDim, int N, int channels>
@@ -546,6 +1259,260 @@ class PreComputedCubeResonator : public ResonatorBase<PreComputedCubeEigenValues
 
 
 
+// ----        ----------------------------------------------------
+// ---- Cuboid ----------------------------------------------------
+// ----        ----------------------------------------------------
+
+// Box with side lengths L_j = length·a_j (aspect ratios a_j), the eigenvalues are
+// k² = π²·Σ n_j²/L_j² for n_j ≥ 1 and the eigenfunctions Π sin(n_j π x_j) like for the cube.
+//
+// The lowest N modes are selected from a pool of candidate k-vectors (about poolFactor·N lattice
+// points in an ellipsoid around the aspect ratios the pool was built for). Changing the aspect
+// ratios only recomputes the norms of the pool and partially sorts it, the pool is rebuilt only
+// when the new selection could miss a lattice point outside of it. Since a point outside has
+// Σ(n_j/a0_j)² > R0², it is not among the lowest N if the N-th lowest norm is at most
+// min_j(a0_j/a_j)²·R0².
+template<class T, int maxDim, int N>
+class CuboidEigenValues
+{
+public:
+	using real = T;
+	using scalar = std::complex<real>;
+	using SpaceVec = Uberton::Math::Vector<real, maxDim>;
+	using Aspects = std::array<real, maxDim>;
+	using KVec = std::array<short, maxDim>;
+
+	static constexpr int poolFactor = 4;
+
+	CuboidEigenValues() {
+		aspects.fill(1);
+		rebuildPool();
+		selectModes();
+	}
+
+	scalar eigenValueSqrt(int i) const {
+		return std::sqrt(norms[modes[i]]) * pi / length;
+	}
+
+	scalar eigenFunction(int i, const SpaceVec& x) const {
+		const KVec& k = pool[modes[i]];
+		real result{ 1 };
+		for (int j = 0; j < dim; ++j) {
+			result *= std::sin(k[j] * pi * x[j]); // no division by the side length as x is normalized
+		}
+		return result;
+	}
+
+	void setDesiredBaseFrequency(real f, real b, real c) {
+		baseFrequency = f;
+		const real w = 2 * pi * f;
+		// the lowest mode has n = (1, ..., 1)
+		real lowest = 0;
+		for (int j = 0; j < dim; j++) lowest += 1 / (aspects[j] * aspects[j]);
+		length = pi * c * std::sqrt(lowest / (w * w + b * b));
+	}
+
+	/// Changes the dimension and rebuilds the pool. The mode state of the resonator needs to be
+	/// reset as with the cube (positions, frequencies).
+	void setDim(int newDim) {
+		dim = std::max(1, std::min(maxDim, newDim));
+		rebuildPool();
+		selectModes();
+	}
+
+	int getDim() const { return dim; }
+
+	const Aspects& getAspectRatios() const { return aspects; }
+
+	/// k-vector of mode i
+	const KVec& kVector(int i) const { return pool[modes[i]]; }
+
+	int poolSize() const { return static_cast<int>(pool.size()); }
+	int numPoolRebuilds() const { return poolRebuilds; }
+
+	/// Distinguishes the mode orders of different aspect ratios in an EigenFunctionCache
+	std::size_t shapeId() const {
+		std::size_t hash = 0;
+		for (int j = 0; j < dim; j++) hash = hash * 31 + std::hash<real>()(aspects[j]);
+		return hash;
+	}
+
+protected:
+	/// Select the lowest N modes for the aspect ratios (only the first dim are used, values
+	/// ≤ 0 count as 1). previous[i] is the former index of the new mode i or -1 if it was not
+	/// selected before. Does not allocate unless the pool has to be rebuilt.
+	void reselect(const Aspects& newAspects, std::array<int, N>& previous) {
+		for (int j = 0; j < maxDim; j++) {
+			aspects[j] = newAspects[j] > 0 ? newAspects[j] : real(1);
+		}
+		const std::array<int, N> oldModes = modes;
+		for (int i = 0; i < N; i++) poolSlots[oldModes[i]] = i;
+		if (selectModes()) {
+			for (int i = 0; i < N; i++) previous[i] = poolSlots[modes[i]];
+			for (int i = 0; i < N; i++) poolSlots[oldModes[i]] = -1;
+			return;
+		}
+
+		// the pool is replaced, match the modes by their k-vectors
+		std::array<KVec, N> oldKVectors;
+		for (int i = 0; i < N; i++) oldKVectors[i] = pool[oldModes[i]];
+		rebuildPool();
+		selectModes();
+		for (int i = 0; i < N; i++) {
+			previous[i] = -1;
+			for (int o = 0; o < N; o++) {
+				if (oldKVectors[o] == pool[modes[i]]) {
+					previous[i] = o;
+					break;
+				}
+			}
+		}
+	}
+
+	real getBaseFrequency() const { return baseFrequency; }
+
+private:
+	real weightedNorm(const KVec& k) const {
+		real sum = 0;
+		for (int j = 0; j < dim; j++) {
+			const real q = k[j] / aspects[j];
+			sum += q * q;
+		}
+		return sum;
+	}
+
+	// Fills modes with the lowest N pool entries for the current aspect ratios, returns false if
+	// the pool is not guaranteed to contain them
+	bool selectModes() {
+		for (std::size_t p = 0; p < pool.size(); p++) {
+			norms[p] = weightedNorm(pool[p]);
+			order[p] = static_cast<int>(p);
+		}
+		auto less = [&](int a, int b) { return norms[a] < norms[b] || (norms[a] == norms[b] && a < b); };
+		std::nth_element(order.begin(), order.begin() + (N - 1), order.end(), less);
+		std::sort(order.begin(), order.begin() + N, less);
+		std::copy(order.begin(), order.begin() + N, modes.begin());
+
+		real shrink = std::numeric_limits<real>::max();
+		for (int j = 0; j < dim; j++) {
+			const real ratio = poolAspects[j] / aspects[j];
+			shrink = std::min(shrink, ratio * ratio);
+		}
+		return norms[modes[N - 1]] <= shrink * poolRadiusSq;
+	}
+
+	// Enumerates the lattice points with Σ(n_j/a_j)² ≤ R² for the current aspect ratios, R is
+	// grown until there are at least poolFactor·N of them
+	void rebuildPool() {
+		// positive orthant of the ellipsoid: V_d(R)·Πa_j / 2ᵈ ≈ number of points
+		double product = 1;
+		for (int j = 0; j < dim; j++) product *= aspects[j];
+		const double unitBall = std::pow(pi, dim / 2.0) / std::tgamma(dim / 2.0 + 1);
+		double radius = std::pow(poolFactor * N * std::pow(2.0, dim) / (unitBall * product), 1.0 / dim);
+		while (enumerate(real(radius * radius), nullptr) < poolFactor * N) {
+			radius *= 1.1;
+		}
+		poolRadiusSq = real(radius * radius);
+		pool.clear();
+		enumerate(poolRadiusSq, &pool);
+		norms.resize(pool.size());
+		order.resize(pool.size());
+		poolSlots.assign(pool.size(), -1);
+		poolAspects = aspects;
+		++poolRebuilds;
+	}
+
+	// Counts (and stores if points is not null) the lattice points within radiusSq
+	int enumerate(real radiusSq, std::vector<KVec>* points) const {
+		real minRest[maxDim + 1]{}; // smallest contribution of the coordinates j...dim-1 (all n = 1)
+		for (int j = dim - 1; j >= 0; j--) {
+			minRest[j] = minRest[j + 1] + 1 / (aspects[j] * aspects[j]);
+		}
+		KVec k{};
+		int count = 0;
+		auto recurse = [&](auto& self, int j, real sum) -> void {
+			if (j == dim) {
+				++count;
+				if (points) points->push_back(k);
+				return;
+			}
+			for (short n = 1;; n++) {
+				const real q = n / aspects[j];
+				if (sum + q * q + minRest[j + 1] > radiusSq) break;
+				k[j] = n;
+				self(self, j + 1, sum + q * q);
+			}
+			k[j] = 0;
+		};
+		recurse(recurse, 0, 0);
+		return count;
+	}
+
+	std::vector<KVec> pool;	 // candidate k-vectors
+	std::vector<real> norms; // Σ(n_j/a_j)² per pool entry
+	std::vector<int> order;	 // scratch for the selection
+	std::vector<int> poolSlots; // scratch for reselect(), mode index per pool entry or -1
+	std::array<int, N> modes{}; // pool indices of the selected modes, ascending eigenvalues
+	Aspects aspects{};
+	Aspects poolAspects{};
+	real poolRadiusSq{ 0 };
+	int poolRebuilds{ 0 };
+	real length{ 1 };
+	real baseFrequency{ 1 };
+	int dim{ maxDim };
+	static constexpr real pi = Uberton::Math::pi<real>();
+};
+
+
+template<class T, int maxDim, int N, int channels>
+class CuboidResonator : public ResonatorBase<CuboidEigenValues<T, maxDim, N>, T, maxDim, N, channels>
+{
+public:
+	using real = T;
+	using Aspects = typename CuboidEigenValues<T, maxDim, N>::Aspects;
+
+	/// Change the aspect ratios (relative side lengths) keeping the base frequency, dampening and
+	/// velocity. The frequencies glide over numSteps samples like with glideFreqDampeningAndVelocity()
+	/// (jump for numSteps ≤ 1).
+	/// Modes that stay among the lowest N keep their amplitude and eigenfunction evaluations,
+	/// modes that enter start silent and are only heard at the input and output positions after
+	/// setInputPositions()/setOutputPositions().
+	void setAspectRatios(const Aspects& aspects, int numSteps = 1) {
+		std::array<int, N> previous;
+		this->reselect(aspects, previous);
+		permute(this->amplitudes, previous, {});
+		permute(this->frequencies, previous, {});
+		permute(this->timeFunctions, previous, {});
+		permute(this->monoInputPosEF, previous, {});
+		for (int ch = 0; ch < channels; ch++) {
+			permute(this->inputPosEF[ch], previous, {});
+			permute(this->outputPosEF[ch], previous, {});
+		}
+		this->glideFreqDampeningAndVelocity(this->getBaseFrequency(), this->b, this->c, numSteps);
+		if (this->glideSteps > 0) {
+			// entering modes have no previous frequency to glide from
+			for (int i = 0; i < N; i++) {
+				if (previous[i] >= 0) continue;
+				this->glideRatios[i] = 1;
+				this->timeFunctions[i] = this->glideTargets[i];
+			}
+		}
+		this->startResyncInterval();
+	}
+
+private:
+	// values[i] = old values[previous[i]], entering modes get fill
+	template<class V>
+	static void permute(std::array<V, N>& values, const std::array<int, N>& previous, const V& fill) {
+		const std::array<V, N> old = values;
+		for (int i = 0; i < N; i++) {
+			values[i] = previous[i] >= 0 ? old[previous[i]] : fill;
+		}
+	}
+};
+
+
+
 // ----        ----------------------------------------------------
 // ---- Sphere ----------------------------------------------------
 // ----        ----------------------------------------------------
@@ -676,7 +1643,7 @@ public:
 			const real jj = (j - real(2)) * real(0.5);						  // j / 2 - 1
 			const int jj_i = static_cast<int>(std::floor(j * real(0.5))) - 1; // j / 2 - 1 integer version;
 
-			scalar p1 = static_cast<real>(sqrt(((real(2) * L + j - real(1)) * lookupFactorial(L + l + j - 2)) / (real(2) * lookupFactorial(L - l)))); // normalizer
+			scalar p1 = normalizers[i + 1][j - 2];
 			scalar p2 = j == 2 ? 1 : pow(sin(theta_j), -jj);
 			scalar p3;
 
@@ -711,6 +1678,12 @@ public:
 		return (std::pow(r, ln) * r_twopi_sqrt * phase_factor * product).real();
 	}
 
+	/// Evaluate the first n eigenfunctions at x, same results as eigenFunction() but with a
+	/// kernel for the current dimension that is selected in setDim()
+	void eigenFunctions(const SpaceVec& x, scalar* out, int n) const {
+		(this->*kernel)(x, out, n);
+	}
+
 	void setDesiredBaseFrequency(real f, real b, real c) {
 		const real w = 2 * pi * f;
 		// λ = −l(l + d − 2)/r²
@@ -754,6 +1727,59 @@ public:
 			}
 		}
 		//printCombinations();
+
+		// normalizers of the ϑ terms, they do not depend on the position
+		for (int c = 0; c < N + 1; c++) {
+			for (int j = 2; j <= dim - 1; j++) {
+				const int L = combinations[c].coeffs[j - 1];
+				const int l = combinations[c].coeffs[j - 2];
+				normalizers[c][j - 2] = static_cast<real>(std::sqrt(((real(2) * L + j - real(1)) * lookupFactorial(L + l + j - 2)) / (real(2) * lookupFactorial(L - l))));
+			}
+		}
+		kernel = makeKernels(std::make_index_sequence<maxDim - 1>())[dim - 2];
+	}
+
+	using Kernel = void (NSphereEigenValues::*)(const SpaceVec&, scalar*, int) const;
+
+	template<size_t... d>
+	static constexpr std::array<Kernel, maxDim - 1> makeKernels(std::index_sequence<d...>) {
+		return { &NSphereEigenValues::eigenFunctionsKernel<d + 2>... };
+	}
+
+	// eigenFunction() for dimension d with the terms that only depend on the position computed
+	// once instead of once per mode
+	template<int d>
+	void eigenFunctionsKernel(const SpaceVec& x, scalar* out, int n) const {
+		using namespace std;
+		const real r = x[0];
+		std::array<scalar, maxDim> p2;
+		std::array<real, maxDim> cosTheta;
+		for (int j = 2; j <= d - 1; j++) {
+			const real jj = (j - real(2)) * real(0.5);
+			p2[j] = j == 2 ? 1 : pow(sin(x[j]), -jj);
+			cosTheta[j] = cos(x[j]);
+		}
+		for (int i = 0; i < n; i++) {
+			const auto& combination = combinations[i + 1];
+			const real phase = combination.coeffs[0] * x[1];
+			const scalar phase_factor = cos(phase) + scalar(0, 1) * sin(phase);
+			scalar product{ 1 };
+			for (int j = 2; j <= d - 1; j++) {
+				const int L = combination.coeffs[j - 1];
+				const int l = combination.coeffs[j - 2];
+				const int jj_i = static_cast<int>(std::floor(j * real(0.5))) - 1;
+				const scalar p1 = normalizers[i + 1][j - 2];
+				scalar p3;
+				if (j & 1) {
+					p3 = Uberton::Math::generalized_assoc_legendre_plus_onehalf<real>(L + jj_i, -(l + jj_i + 1), cosTheta[j] * T(.99));
+				} else {
+					p3 = Uberton::Math::assoc_legendre<real>(L + jj_i, -(l + jj_i), cosTheta[j]);
+				}
+				product *= p1 * p2[j] * p3;
+			}
+			const real ln = static_cast<real>(combination.coeffs[d - 2]);
+			out[i] = (std::pow(r, ln) * r_twopi_sqrt * phase_factor * product).real();
+		}
 	}
 	void printCombinations() const {
 		for (const auto& combination : combinations) {
@@ -775,6 +1801,8 @@ public:
 	};
 
 	std::array<Combination, N + 1> combinations;
+	std::array<std::array<real, numQuantumNumbers>, N + 1> normalizers{}; // [combination][j - 2]
+	Kernel kernel{ nullptr };
 
 	real radius_inv{ 1 };
 };
@@ -787,6 +1815,430 @@ class NSphereResonator : public ResonatorBase<NSphereEigenValues<T, maxDim, N>,
 
 
 
+// ----                       ----------------------------------------------------
+// ---- Membrane and Cylinder ----------------------------------------------------
+// ----                       ----------------------------------------------------
+//
+// Circular membrane (d = 2, a drum head) and cylindrical cavity (d = 3) with radius R and height
+// H clamped at the boundary. The eigenvalues are
+//     k² = j_mn²/R²                  (membrane)
+//     k² = j_mn²/R² + (pπ/H)²        (cylinder, p ≥ 1)
+// with the zeros j_mn of the Bessel functions J_m (from the table besselZeros) and the
+// eigenfunctions J_m(j_mn·r)·cos(mφ) and J_m(j_mn·r)·sin(mφ) (only m > 0), times sin(pπz) for
+// the cylinder. They are normalized to a mean square of 2⁻ᵈ over the volume like the cube modes.
+//
+// Input/output coordinates: x[0] = r ∈ [0,1] (relative to R), x[1] = φ ∈ [0,2π] and for the
+// cylinder x[2] = z ∈ [0,1] (relative to H).
+//
+// Modes with the same j_mn share the radial factor, so eigenFunctions() runs the Bessel
+// recurrence once per (m, n), for a vector of them at once (see Simd::Kernels::besselJ), and
+// gets cos(mφ), sin(mφ) and sin(pπz) from angle addition recurrences instead of evaluating each
+// mode on its own.
+template<class T, int d, int N>
+class CircularEigenValues
+{
+public:
+	static_assert(d == 2 || d == 3, "template parameter d needs to be 2 (membrane) or 3 (cylinder)");
+
+	using real = T;
+	using scalar = std::complex<real>;
+	using SpaceVec = Uberton::Math::Vector<real, d>;
+
+	// number of membrane modes with a zero below besselZerosBound, the lowest N cylinder modes
+	// only use the radial factors of the lowest N membrane modes
+	static constexpr int maxModes = 668;
+	static_assert(N <= maxModes, "template parameter N exceeds the tabulated Bessel zeros");
+
+	CircularEigenValues() {
+		computeModes();
+	}
+
+	scalar eigenValueSqrt(int i) const {
+		return modes[i].k / radius;
+	}
+
+	scalar eigenFunction(int i, const SpaceVec& x) const {
+		const Mode& mode = modes[i];
+		const Radial& radial = radials[mode.radial];
+		real result = static_cast<real>(radial.normalizer * besselJ(radial.m, radial.zero * x[0]));
+		result *= mode.sine ? std::sin(radial.m * x[1]) : std::cos(radial.m * x[1]);
+		if constexpr (d == 3) result *= std::sin(mode.p * pi * x[2]);
+		return result;
+	}
+
+	/// Evaluate the first n eigenfunctions at x, same results as eigenFunction() up to rounding
+	void eigenFunctions(const SpaceVec& x, scalar* out, int n) const {
+		std::array<double, N> orders{};
+		std::array<double, N> arguments{};
+		std::array<double, N> radialValues;
+		const int numRadials = n > 0 ? modes[n - 1].maxRadial + 1 : 0;
+		for (int r = 0; r < numRadials; r++) { // sorted by j_mn
+			orders[r] = radials[r].m;
+			arguments[r] = radials[r].zero * x[0];
+		}
+		Simd::kernels<double>().besselJ(orders.data(), arguments.data(), radialValues.data(), numRadials);
+		for (int r = 0; r < numRadials; r++) {
+			radialValues[r] *= radials[r].normalizer;
+		}
+		// e^(imφ) and sin(pπz) for all used m and p
+		std::array<std::complex<double>, besselZerosOrders> angular;
+		const std::complex<double> rotation = std::polar(1.0, double(x[1]));
+		angular[0] = 1;
+		for (int m = 1; m <= maxM; m++) angular[m] = angular[m - 1] * rotation;
+		std::array<double, N + 1> axial;
+		if constexpr (d == 3) {
+			const double theta = pi * double(x[2]), twoCos = 2 * std::cos(theta);
+			axial[0] = 0;
+			axial[1] = std::sin(theta);
+			for (int p = 2; p <= maxP; p++) axial[p] = twoCos * axial[p - 1] - axial[p - 2];
+		}
+		for (int i = 0; i < n; i++) {
+			const Mode& mode = modes[i];
+			const std::complex<double>& phase = angular[radials[mode.radial].m];
+			double value = radialValues[mode.radial] * (mode.sine ? phase.imag() : phase.real());
+			if constexpr (d == 3) value *= axial[mode.p];
+			out[i] = static_cast<real>(value);
+		}
+	}
+
+	void setDesiredBaseFrequency(real f, real b, real c) {
+		const real w = 2 * pi * f;
+		// k₀ = (lowest eigenvalue sqrt for R = 1)/R = √(ω² + b²)/c
+		radius = c * modes[0].k / std::sqrt(w * w + b * b);
+	}
+
+	/// Height H relative to the radius R (only for the cylinder). The order of the modes changes,
+	/// so like after setDim() with other shapes the frequencies and positions need to be set again.
+	/// Allocates.
+	void setHeightRatio(real ratio) {
+		heightRatio = std::max(ratio, real(1e-3));
+		computeModes();
+	}
+
+	real getHeightRatio() const { return heightRatio; }
+
+	/// Distinguishes the mode orders of different height ratios in an EigenFunctionCache
+	std::size_t shapeId() const { return d == 3 ? std::hash<real>()(heightRatio) : 0; }
+
+	T getRadius() const { return radius; }
+
+private:
+	struct Radial
+	{
+		int m{ 0 };
+		double zero{ 0 };		// j_mn
+		double normalizer{ 0 }; // mean square 1/4 of radial and angular factor over the disk
+	};
+
+	struct Mode
+	{
+		int radial{ 0 };	 // index in radials
+		bool sine{ false };	 // sin(mφ) instead of cos(mφ)
+		int p{ 1 };			 // axial number (cylinder)
+		real k{ 0 };		 // eigenvalue sqrt for R = 1
+		int maxRadial{ 0 };	 // largest radial index of the modes 0...i
+	};
+
+	void computeModes() {
+		// the lowest N membrane modes, ordered by j_mn (and by m for equal zeros)
+		std::vector<std::pair<double, int>> zeros; // (j_mn, m)
+		for (int m = 0; m < besselZerosOrders; m++) {
+			for (int n = 0; n < besselZerosPerOrder; n++) {
+				if (besselZeros[m][n] < besselZerosBound) zeros.push_back({ besselZeros[m][n], m });
+			}
+		}
+		std::sort(zeros.begin(), zeros.end());
+		struct Candidate
+		{
+			int radial;
+			bool sine;
+		};
+		std::vector<Candidate> membrane;
+		int numRadials = 0;
+		for (std::size_t z = 0; z < zeros.size() && static_cast<int>(membrane.size()) < N; z++) {
+			const int m = zeros[z].second;
+			Radial& radial = radials[numRadials];
+			radial.m = m;
+			radial.zero = zeros[z].first;
+			// ∫₀¹ J_m(j·r)² r dr = J_m+1(j)²/2, the mean of cos² is 1/2 for m > 0
+			radial.normalizer = (m == 0 ? .5 : std::sqrt(.5)) / std::abs(besselJ(m + 1, radial.zero));
+			membrane.push_back({ numRadials, false });
+			if (m > 0 && static_cast<int>(membrane.size()) < N) membrane.push_back({ numRadials, true });
+			numRadials++;
+		}
+
+		if constexpr (d == 2) {
+			for (int i = 0; i < N; i++) {
+				modes[i] = { membrane[i].radial, membrane[i].sine, 1, static_cast<real>(radials[membrane[i].radial].zero) };
+			}
+		} else {
+			// merge the axial series p = 1, 2, ... of all membrane modes
+			const double axialStep = pi / heightRatio;
+			auto k2 = [&](int c, int p) { const double j = radials[membrane[c].radial].zero, a = p * axialStep; return j * j + a * a; };
+			using Entry = std::pair<double, std::pair<int, int>>; // (k², (candidate, p))
+			std::vector<Entry> heap;
+			for (int c = 0; c < N; c++) heap.push_back({ k2(c, 1), { c, 1 } });
+			std::make_heap(heap.begin(), heap.end(), std::greater<>());
+			for (int i = 0; i < N; i++) {
+				std::pop_heap(heap.begin(), heap.end(), std::greater<>());
+				const auto [value, index] = heap.back();
+				const auto [c, p] = index;
+				modes[i] = { membrane[c].radial, membrane[c].sine, p, static_cast<real>(std::sqrt(value)) };
+				heap.back() = { k2(c, p + 1), { c, p + 1 } };
+				std::push_heap(heap.begin(), heap.end(), std::greater<>());
+			}
+		}
+
+		maxM = maxP = 0;
+		for (int i = 0; i < N; i++) {
+			modes[i].maxRadial = std::max(modes[i].radial, i > 0 ? modes[i - 1].maxRadial : 0);
+			maxM = std::max(maxM, radials[modes[i].radial].m);
+			maxP = std::max(maxP, modes[i].p);
+		}
+	}
+
+	std::array<Radial, N> radials;
+	std::array<Mode, N> modes;
+	int maxM{ 0 };
+	int maxP{ 0 };
+	real heightRatio{ 1 };
+	real radius{ 1 };
+	static constexpr real pi = Uberton::Math::pi<real>();
+};
+
+
+template<class T, int N, int channels>
+class MembraneResonator : public ResonatorBase<CircularEigenValues<T, 2, N>, T, 2, N, channels>
+{
+};
+
+
+template<class T, int N, int channels>
+class CylinderResonator : public ResonatorBase<CircularEigenValues<T, 3, N>, T, 3, N, channels>
+{
+};
+
+
+
+// ----            ----------------------------------------------------
+// ---- Voice Bank ----------------------------------------------------
+// ----            ----------------------------------------------------
+// Polyphonic variant of ResonatorBase that runs several voices of the same shape in
+// parallel. Low orders have too few modes to fill a vector register, so the amplitudes
+// and time functions are stored lane-wise: for each mode index i there is one contiguous
+// row of [voices] real and imaginary parts. One pass of evolve() then advances the same
+// mode of all voices with plain vector arithmetic.
+//
+// All voices share the input/output positions (and thus the eigenfunction evaluations)
+// but each voice has its own base frequency, dampening and velocity. This relies on
+// eigenFunction() not depending on the system size (see ResonatorBase).
+//
+// Template Parameters:
+//   Parent, T, d, N, channels:  see ResonatorBase
+//   voices:  number of voices/lanes, preferably 4, 8 or 16
+//
+template<class Parent, class T, int d, int N, int channels, int voices>
+class ResonatorVoiceBank : public Parent
+{
+	static_assert(d > 0, "template parameter d needs to be greater than 0");
+	static_assert(N > 0, "template parameter N needs to be greater than 0");
+	static_assert(channels > 0, "template parameter channels needs to be greater than 0");
+	static_assert(voices > 0, "template parameter voices needs to be greater than 0");
+
+public:
+	using real = T;
+	using scalar = std::complex<real>;
+	using SpaceVec = Uberton::Math::Vector<T, d>;
+
+	template<class TT, int n>
+	using array = std::array<TT, n>;
+	using VoiceSamples = array<real, voices>; // one value per voice (lane)
+
+	ResonatorVoiceBank() {
+		freqs.fill(100);
+		c.fill(10);
+		b.fill(real(.1));
+	}
+
+	/// Initialize resonator with sample rate in Hz (i.e. 44100)
+	void setSampleRate(T sampleRate) {
+		deltaT = T{ 1. } / sampleRate;
+		for (int v = 0; v < voices; ++v) {
+			updateVoice(v);
+		}
+	}
+
+	/// The actual order (shared by all voices), can be set lower than N (the max order)
+	void setOrder(int order) {
+		nOrder = std::max(1, std::min(N, order));
+	}
+
+	/// Excite a single voice at the current input positions
+	void delta(int voice, const array<real, channels>& amount) {
+		for (int ch = 0; ch < channels; ++ch) {
+			for (int i = 0; i < nOrder; ++i) {
+				const scalar a = amount[ch] * inputPosEF[ch][i];
+				amplitudesRe[i][voice] += a.real();
+				amplitudesIm[i][voice] += a.imag();
+			}
+		}
+	}
+
+	/// Excite all voices at once with one amount per channel and voice
+	void delta(const array<VoiceSamples, channels>& amount) {
+		for (int ch = 0; ch < channels; ++ch) {
+			for (int i = 0; i < nOrder; ++i) {
+				const real efRe = inputPosEF[ch][i].real();
+				const real efIm = inputPosEF[ch][i].imag();
+				for (int v = 0; v < voices; ++v) {
+					amplitudesRe[i][v] += amount[ch][v] * efRe;
+					amplitudesIm[i][v] += amount[ch][v] * efIm;
+				}
+			}
+		}
+	}
+
+	/// Excitation of a strike at x for strike(), N values (see ResonatorBase::strikeVector())
+	void strikeVector(const SpaceVec& x, scalar* vector) const {
+		for (int i = 0; i < N; ++i) {
+			vector[i] = this->eigenFunction(i, x);
+		}
+	}
+
+	/// Excite a single voice with an impulse of the given amount at the position of a strike
+	/// vector, i.e. on note-on
+	void strike(int voice, const scalar* vector, real amount) {
+		if (amount == 0) return;
+		for (int i = 0; i < nOrder; ++i) {
+			amplitudesRe[i][voice] += amount * vector[i].real();
+			amplitudesIm[i][voice] += amount * vector[i].imag();
+		}
+	}
+
+	/// Compute next time step of all voices and get the evaluations at the output positions
+	array<VoiceSamples, channels> next() {
+		evolve();
+		array<VoiceSamples, channels> results{};
+		for (int ch = 0; ch < channels; ++ch) {
+			for (int i = 0; i < nOrder; ++i) {
+				const real efRe = outputPosEF[ch][i].real();
+				const real efIm = outputPosEF[ch][i].imag();
+				for (int v = 0; v < voices; ++v) { // Re(a·ef)
+					results[ch][v] += amplitudesRe[i][v] * efRe - amplitudesIm[i][v] * efIm;
+				}
+			}
+		}
+		return results;
+	}
+
+	/// Set the "listening" positions (normalized to [0,1]), shared by all voices
+	void setOutputPositions(const array<SpaceVec, channels>& outPositions) {
+		for (int ch = 0; ch < channels; ++ch) {
+			for (int i = 0; i < N; ++i) {
+				outputPosEF[ch][i] = this->eigenFunction(i, outPositions[ch]);
+			}
+		}
+	}
+
+	/// Set the "playing" or exciting position (normalized to [0,1]), shared by all voices
+	void setInputPositions(const array<SpaceVec, channels>& inPositions) {
+		for (int ch = 0; ch < channels; ++ch) {
+			for (int i = 0; i < N; ++i) {
+				inputPosEF[ch][i] = this->eigenFunction(i, inPositions[ch]);
+			}
+		}
+	}
+
+	/// Set the base frequency, dampening coefficient and (sonic) velocity of one voice
+	void setVoiceFreqDampeningAndVelocity(int voice, real freq, real dampening, real velocity) {
+		freqs[voice] = freq;
+		b[voice] = dampening;
+		c[voice] = velocity;
+		updateVoice(voice);
+	}
+
+	/// Silence a single voice, i.e. before retriggering it
+	void clearVoice(int voice) {
+		for (int i = 0; i < N; ++i) {
+			amplitudesRe[i][voice] = 0;
+			amplitudesIm[i][voice] = 0;
+		}
+	}
+
+	/// Clear the system, setting all amplitudes of all voices to zero
+	void clear() {
+		for (int i = 0; i < N; ++i) {
+			amplitudesRe[i].fill(0);
+			amplitudesIm[i].fill(0);
+		}
+	}
+
+	int order() const { return nOrder; }
+	static constexpr int maxDimension() { return d; }
+	static constexpr int maxOrder() { return N; }
+	static constexpr int numChannels() { return channels; }
+	static constexpr int numVoices() { return voices; }
+
+protected:
+	// Recompute the time functions of one voice. The parent's base frequency setting is
+	// only used temporarily as it is shared by all voices.
+	void updateVoice(int voice) {
+		constexpr scalar imagUnit = scalar(0, 1);
+		this->setDesiredBaseFrequency(freqs[voice], b[voice], c[voice]);
+		for (int i = 0; i < N; i++) {
+			const scalar k = this->eigenValueSqrt(i);
+			const scalar w = imagUnit * b[voice] + std::sqrt(k * k * c[voice] * c[voice] - b[voice] * b[voice]); // ib + √(k²c²-b²)
+			const scalar tf = std::exp(imagUnit * w * deltaT);
+			timeFunctionsRe[i][voice] = tf.real();
+			timeFunctionsIm[i][voice] = tf.imag();
+		}
+	}
+
+	void evolve() {
+		for (int i = 0; i < nOrder; i++) {
+			auto& aRe = amplitudesRe[i];
+			auto& aIm = amplitudesIm[i];
+			const auto& tRe = timeFunctionsRe[i];
+			const auto& tIm = timeFunctionsIm[i];
+			for (int v = 0; v < voices; ++v) { // complex multiplication, one lane per voice
+				const real re = aRe[v] * tRe[v] - aIm[v] * tIm[v];
+				const real im = aRe[v] * tIm[v] + aIm[v] * tRe[v];
+				aRe[v] = re;
+				aIm[v] = im;
+			}
+		}
+	}
+
+public:
+	T deltaT{ 0 };							  // 1 / sample rate
+	VoiceSamples freqs{};					  // base frequency per voice
+	VoiceSamples c{};						  // (sonic) velocity per voice
+	VoiceSamples b{};						  // dampening factor per voice
+	array<VoiceSamples, N> amplitudesRe{};	  // current weights for frequency component (lane-wise)
+	array<VoiceSamples, N> amplitudesIm{};	  //
+	array<VoiceSamples, N> timeFunctionsRe{}; // precomputed exponential time functions (lane-wise)
+	array<VoiceSamples, N> timeFunctionsIm{};
+
+	// eigenfunction evaluations at input/output positions (shared by all voices)
+	array<array<scalar, N>, channels> outputPosEF{};
+	array<array<scalar, N>, channels> inputPosEF{};
+
+	int nOrder{ N };
+};
+
+
+template<class T, int d, int N, int channels, int voices>
+class CubeResonatorVoiceBank : public ResonatorVoiceBank<CubeEigenValues<T, d, N>, T, d, N, channels, voices>
+{
+};
+
+template<class T, int N, int channels, int voices>
+class StringResonatorVoiceBank : public ResonatorVoiceBank<StringEigenValues<T>, T, 1, N, channels, voices>
+{
+};
+
+
+
 
 
 
@@ -0,0 +1,156 @@
+
+// Network of resonators of different shapes coupled through their inputs and outputs
+//
+// -----------------------------------------------------------------------------------------------------------------------------
+// This file is part of the Überton project. Copyright (C) 2021 Überton
+//
+// Überton is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+// Überton is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details. You should
+// have received a copy of the GNU General Public License along with Überton. If not, see http://www.gnu.org/licenses/.
+// -----------------------------------------------------------------------------------------------------------------------------
+
+
+#pragma once
+
+#include "resonator.h"
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace Uberton {
+namespace Math {
+
+// Hosts several resonators (any ResonatorBase, e.g. a string, a cube and an n-sphere) and couples
+// them with a sparse matrix: the output of a resonator's pickup (output channel) excites another
+// resonator (or the same one) at one of its input positions with a given gain.
+//
+// The channels of all resonators are numbered consecutively, i.e. the channels of the second
+// resonator follow those of the first and so on. The external input and the output of process()
+// have numChannels() channels in this order.
+//
+// All resonators are advanced sample by sample, each in a single pass over its modes that adds
+// the excitation, rotates and evaluates the pickups (see ResonatorBase::next(amount)). The coupled
+// signal arrives with a delay of one sample (the output at sample n excites at sample n + 1) instead of a block like
+// when chaining plugin instances. The coupling adds energy to the receiving modes, with feedback
+// loops the network is only stable if the loop gain stays below the damping of the modes.
+//
+// The resonators live on the heap and are configured as usual through resonator<k>().
+//
+// Usage example:
+//
+//   ResonatorNetwork<StringResonator<float, 100, 1>, CubeResonator<float, 3, 200, 2>> network;
+//   network.resonator<0>().setSampleRate(44100);
+//   ...
+//   network.connect(0, 1, .01f); // string pickup -> first input position of the cube
+//   network.connect(2, 0, .01f); // second cube pickup -> string
+//   network.process(in, out, numSamples);
+//
+template<class... Resonators>
+class ResonatorNetwork
+{
+	static_assert(sizeof...(Resonators) > 0, "ResonatorNetwork needs at least one resonator");
+
+public:
+	using real = typename std::tuple_element_t<0, std::tuple<Resonators...>>::real;
+	static constexpr int numResonators = sizeof...(Resonators);
+	static constexpr int channels = (Resonators::numChannels() + ...);
+	using Frame = std::array<real, channels>;
+
+	struct Connection
+	{
+		int from; // output channel (network numbering)
+		int to;	  // input channel (network numbering)
+		real gain;
+	};
+
+	ResonatorNetwork() : resonators(std::make_unique<Resonators>()...) {}
+
+	template<int k>
+	auto& resonator() { return *std::get<k>(resonators); }
+	template<int k>
+	const auto& resonator() const { return *std::get<k>(resonators); }
+
+	/// Total number of channels of all resonators
+	static constexpr int numChannels() { return channels; }
+
+	/// First channel of the k-th resonator in the network numbering
+	static constexpr int channelOffset(int k) {
+		constexpr int resonatorChannels[] = { Resonators::numChannels()... };
+		int offset = 0;
+		for (int i = 0; i < k; i++) offset += resonatorChannels[i];
+		return offset;
+	}
+
+	/// Feed output channel from into input channel to with the given gain. Connecting the same
+	/// channels again replaces the gain, a gain of 0 removes the connection.
+	void connect(int from, int to, real gain) {
+		if (from < 0 || from >= numChannels() || to < 0 || to >= numChannels()) return;
+		auto it = std::find_if(connections.begin(), connections.end(), [&](const Connection& c) { return c.from == from && c.to == to; });
+		if (it != connections.end()) {
+			if (gain == 0) connections.erase(it);
+			else it->gain = gain;
+		}
+		else if (gain != 0) {
+			connections.push_back({ from, to, gain });
+		}
+	}
+
+	void disconnectAll() { connections.clear(); }
+
+	const std::vector<Connection>& getConnections() const { return connections; }
+
+	/// Clear all resonators and the coupled signal
+	void clear() {
+		std::apply([](auto&... r) { (r->clear(), ...); }, resonators);
+		lastOutput.fill(0);
+	}
+
+	/// Excite with the given input and compute the next output of all channels
+	Frame next(const Frame& input) {
+		Frame excitation = input;
+		for (const auto& c : connections) {
+			excitation[c.to] += c.gain * lastOutput[c.from];
+		}
+		nextAll(excitation, std::index_sequence_for<Resonators...>{});
+		return lastOutput;
+	}
+
+	/// Process a block, in and out have numChannels() channels, out is overwritten
+	void process(const real* const* in, real* const* out, int numSamples) {
+		Frame input;
+		for (int n = 0; n < numSamples; n++) {
+			for (int ch = 0; ch < numChannels(); ch++) input[ch] = in[ch][n];
+			const Frame output = next(input);
+			for (int ch = 0; ch < numChannels(); ch++) out[ch][n] = output[ch];
+		}
+	}
+
+private:
+	template<size_t... k>
+	void nextAll(const Frame& excitation, std::index_sequence<k...>) {
+		(nextResonator<k>(excitation), ...);
+	}
+
+	template<size_t k>
+	void nextResonator(const Frame& excitation) {
+		auto& r = *std::get<k>(resonators);
+		constexpr int n = std::decay_t<decltype(r)>::numChannels();
+		constexpr int offset = channelOffset(k);
+		std::array<real, n> amount;
+		std::copy(excitation.begin() + offset, excitation.begin() + offset + n, amount.begin());
+		const auto output = r.next(amount);
+		std::copy(output.begin(), output.end(), lastOutput.begin() + offset);
+	}
+
+	std::tuple<std::unique_ptr<Resonators>...> resonators;
+	std::vector<Connection> connections; // sparse coupling matrix
+	Frame lastOutput{};
+};
+
+}
+}
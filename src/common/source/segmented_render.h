@@ -0,0 +1,162 @@
+
+// Offline rendering of a resonator on all cores by splitting the signal into time segments
+//
+// -----------------------------------------------------------------------------------------------------------------------------
+// This file is part of the Überton project. Copyright (C) 2021 Überton
+//
+// Überton is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+// Überton is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details. You should
+// have received a copy of the GNU General Public License along with Überton. If not, see http://www.gnu.org/licenses/.
+// -----------------------------------------------------------------------------------------------------------------------------
+
+
+#pragma once
+
+#include "resonator.h"
+#include <algorithm>
+#include <array>
+#include <complex>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace Uberton {
+namespace Math {
+
+struct SegmentedRenderStats
+{
+	int segments{ 0 };
+	std::int64_t tailSamples{ 0 }; // samples computed for the carried over state (second pass)
+};
+
+// Renders numSamples samples of the resonator (any ResonatorBase) with the input in, like
+// processModes()/finishModes() over the whole signal but spread over numThreads threads. The
+// resonator is only read: its configuration and current amplitudes are the starting point.
+//
+// With static parameters the resonator is linear and time invariant, so the signal is split into
+// one segment per thread and
+//  1. each segment is rendered from silence in parallel, giving its output and final mode state,
+//  2. the state at the start of each segment is accumulated serially in closed form,
+//         S[k+1] = S[k]·exp(iωΔt·length[k]) + final[k],
+//  3. the free decay of S[k] is added to segment k in parallel. It stops once all amplitudes
+//     are below tailThreshold (checked every 4096 samples), so for damped modes this costs a
+//     fraction of the first pass.
+//
+// The result equals the serial rendering up to rounding (the closed form power and the float
+// resynchronization differ in the last bits). A running glide or order fade is not static, the
+// signal is rendered serially then.
+//
+// Usage example:
+//
+//   const auto stats = renderSegmented(resonator, in, out, numSamples, std::thread::hardware_concurrency());
+//
+template<class Resonator>
+SegmentedRenderStats renderSegmented(const Resonator& resonator, const typename Resonator::real* const* in,
+									 typename Resonator::real* const* out, std::int64_t numSamples, int numThreads,
+									 typename Resonator::real tailThreshold = typename Resonator::real(1e-9)) {
+	using real = typename Resonator::real;
+	using scalar = typename Resonator::scalar;
+	using Complex = std::complex<double>;
+	constexpr int channels = Resonator::numChannels();
+	constexpr int N = Resonator::maxOrder();
+	constexpr int blockSize = 4096;
+
+	for (int ch = 0; ch < channels; ch++) {
+		std::fill(out[ch], out[ch] + numSamples, real{ 0 });
+	}
+
+	// Processes [begin, end) with the worker resonator r and the input (or silence), returns the
+	// number of samples processed. Without input it stops when all amplitudes are below threshold.
+	const std::vector<real> zeros(blockSize);
+	auto process = [&](Resonator& r, bool silent, std::int64_t begin, std::int64_t end, real threshold) {
+		std::array<const real*, channels> blockIn;
+		std::array<real*, channels> blockOut;
+		std::int64_t n = begin;
+		while (n < end) {
+			if (silent) {
+				real energy = 0;
+				for (int i = 0; i < r.order(); i++) energy += std::norm(r.amplitudes[i]);
+				if (energy < threshold * threshold) break;
+			}
+			const int length = static_cast<int>(std::min<std::int64_t>(blockSize, end - n));
+			for (int ch = 0; ch < channels; ch++) {
+				blockIn[ch] = silent ? zeros.data() : in[ch] + n;
+				blockOut[ch] = out[ch] + n;
+			}
+			r.processModes(blockIn.data(), blockOut.data(), length, 0, r.order());
+			r.finishModes(blockIn.data(), length);
+			n += length;
+		}
+		return n - begin;
+	};
+
+	const bool isStatic = resonator.glideSteps == 0 && resonator.fadeSteps == 0;
+	const int numSegments = isStatic ? static_cast<int>(std::clamp<std::int64_t>(numThreads, 1, std::max<std::int64_t>(1, numSamples / blockSize))) : 1;
+	if (numSegments == 1) {
+		auto r = std::make_unique<Resonator>(resonator);
+		process(*r, false, 0, numSamples, 0);
+		return { 1, 0 };
+	}
+
+	std::vector<std::int64_t> bounds(numSegments + 1);
+	for (int k = 0; k <= numSegments; k++) {
+		bounds[k] = numSamples * k / numSegments;
+	}
+	std::vector<std::unique_ptr<Resonator>> workers(numSegments);
+	for (auto& r : workers) {
+		r = std::make_unique<Resonator>(resonator);
+	}
+
+	auto runParallel = [&](auto&& job) {
+		std::vector<std::thread> threads;
+		for (int k = 1; k < numSegments; k++) {
+			threads.emplace_back(job, k);
+		}
+		job(0);
+		for (auto& thread : threads) thread.join();
+	};
+
+	// 1. segments from silence
+	runParallel([&](int k) {
+		workers[k]->clear();
+		process(*workers[k], false, bounds[k], bounds[k + 1], 0);
+	});
+
+	// 2. states at the segment starts, exp(iωΔt·length) in double precision
+	const int order = resonator.order();
+	std::vector<std::array<Complex, N>> starts(numSegments);
+	for (int i = 0; i < order; i++) {
+		starts[0][i] = Complex(resonator.amplitudes[i]);
+	}
+	for (int k = 0; k + 1 < numSegments; k++) {
+		const double length = static_cast<double>(bounds[k + 1] - bounds[k]);
+		for (int i = 0; i < order; i++) {
+			const Complex power = std::exp(Complex(0, 1) * Complex(resonator.frequencies[i]) * double(resonator.deltaT) * length);
+			starts[k + 1][i] = starts[k][i] * power + Complex(workers[k]->amplitudes[i]);
+		}
+	}
+
+	// 3. free decay of the carried over states
+	std::vector<std::int64_t> tails(numSegments);
+	runParallel([&](int k) {
+		workers[k] = std::make_unique<Resonator>(resonator); // not every shape is assignable
+		auto& r = *workers[k];
+		std::array<scalar, N> state{};
+		for (int i = 0; i < order; i++) {
+			state[i] = scalar(starts[k][i]);
+		}
+		r.restore(state.data());
+		tails[k] = process(r, true, bounds[k], bounds[k + 1], tailThreshold);
+	});
+
+	SegmentedRenderStats stats;
+	stats.segments = numSegments;
+	for (auto t : tails) stats.tailSamples += t;
+	return stats;
+}
+
+}
+}
@@ -0,0 +1,520 @@
+﻿// -----------------------------------------------------------------------------------------------------------------------------
+// This file is part of the Überton project. Copyright (C) 2021 Überton
+//
+// Überton is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+// Überton is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details. You should
+// have received a copy of the GNU General Public License along with Überton. If not, see http://www.gnu.org/licenses/.
+// -----------------------------------------------------------------------------------------------------------------------------
+
+#include "simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+
+#if defined(UBERTON_SIMD_X86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// The vector kernels below are inlined into functions with the target attribute of their
+// instruction set, the ABI warning about vector values in the (never emitted) generic ones
+// does not apply.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+namespace Uberton {
+namespace Simd {
+
+namespace {
+
+// Miller's backward recurrence J_k-1(x) = 2k/x·J_k(x) − J_k+1(x) for besselJ() as in
+// Math::besselJ() (vstmath.h): where it starts above max(m, x) and when it is rescaled. The
+// values grow by at most 2k/x < 1e15 per step for x ≥ minArgument, so for double the threshold
+// only needs to be checked every 8 steps.
+template<class T>
+struct BesselRecurrence
+{
+	static constexpr T minArgument = T(1e-12);
+	static constexpr T initial = T(1e-30);
+	static constexpr T threshold = std::is_same_v<T, double> ? T(1e100) : T(1e15);
+	static constexpr T rescale = 1 / threshold;
+	static constexpr int checkInterval = std::is_same_v<T, double> ? 8 : 1;
+
+	static int start(T m, T x) {
+		const double top = std::max(double(m), double(x));
+		return 2 * ((static_cast<int>(top + std::sqrt(40 * top)) + 16) / 2);
+	}
+};
+
+template<class T>
+struct ScalarKernels
+{
+	using Complex = std::complex<T>;
+
+	static void rotate(Complex* a, const Complex* t, int n) {
+		for (int i = 0; i < n; i++) {
+			const T re = a[i].real() * t[i].real() - a[i].imag() * t[i].imag();
+			a[i] = Complex(re, a[i].real() * t[i].imag() + a[i].imag() * t[i].real());
+		}
+	}
+
+	static T projectReal(const Complex* a, const Complex* e, int n) {
+		T sum = 0;
+		for (int i = 0; i < n; i++) {
+			sum += a[i].real() * e[i].real() - a[i].imag() * e[i].imag();
+		}
+		return sum;
+	}
+
+	static void accumulate(Complex* a, const Complex* e, T amount, int n) {
+		for (int i = 0; i < n; i++) {
+			a[i] += amount * e[i];
+		}
+	}
+
+	static T peak(const T* x, int n) {
+		T result = 0;
+		for (int i = 0; i < n; i++) {
+			result = std::max(result, std::abs(x[i]));
+		}
+		return result;
+	}
+
+	static bool exceeds(const T* x, int n, T threshold) {
+		for (int i = 0; i < n; i++) {
+			if (std::abs(x[i]) > threshold) return true;
+		}
+		return false;
+	}
+
+	static void step(Complex* a, const Complex* t, const Complex* const* e, const T* x, int numInputs, const Complex* const* o, T* y, int numOutputs, int n) {
+		T sum[2] = { 0, 0 };
+		for (int i = 0; i < n; i++) {
+			T re = a[i].real(), im = a[i].imag();
+			for (int c = 0; c < numInputs; c++) {
+				re += x[c] * e[c][i].real();
+				im += x[c] * e[c][i].imag();
+			}
+			const T r = re * t[i].real() - im * t[i].imag();
+			im = re * t[i].imag() + im * t[i].real();
+			re = r;
+			a[i] = Complex(re, im);
+			for (int c = 0; c < numOutputs; c++) {
+				sum[c] += re * o[c][i].real() - im * o[c][i].imag();
+			}
+		}
+		for (int c = 0; c < numOutputs; c++) {
+			y[c] = sum[c];
+		}
+	}
+
+	static void besselJ(const T* m, const T* x, T* out, int n) {
+		using R = BesselRecurrence<T>;
+		for (int i = 0; i < n; i++) {
+			if (x[i] < R::minArgument) {
+				out[i] = m[i] == 0 ? T(1) : T(0);
+				continue;
+			}
+			const T twoOverX = 2 / x[i];
+			T next = 0, current = R::initial, result = 0, sum = 0;
+			for (int k = R::start(m[i], x[i]); k > 0; k--) {
+				const T previous = k * twoOverX * current - next;
+				next = current;
+				current = previous;
+				if (std::abs(current) > R::threshold) {
+					current *= R::rescale;
+					next *= R::rescale;
+					result *= R::rescale;
+					sum *= R::rescale;
+				}
+				if (k - 1 == m[i]) result = current;
+				if (k > 1 && (k & 1)) sum += 2 * current; // J_k-1 with even k - 1 > 0
+			}
+			out[i] = result / (sum + current);
+		}
+	}
+};
+
+// The kernels for any Lanes type, complex arrays are processed as arrays of 2n reals. The rest
+// that doesn't fill a vector is left to the scalar kernels.
+template<class T, InstructionSet set>
+struct VectorKernels
+{
+	using L = Lanes<T, set>;
+	using Vec = typename L::Vec;
+	using Complex = std::complex<T>;
+	using Scalar = ScalarKernels<T>;
+
+	static UBERTON_SIMD_INLINE void rotate(Complex* a, const Complex* t, int n) {
+		T* x = reinterpret_cast<T*>(a);
+		const T* y = reinterpret_cast<const T*>(t);
+		int j = 0;
+		for (; j + L::size <= 2 * n; j += L::size) {
+			const Vec z = L::load(x + j);
+			const Vec w = L::load(y + j);
+			L::store(x + j, L::fmaddsub(z, L::real(w), L::mul(L::swap(z), L::imag(w))));
+		}
+		Scalar::rotate(a + j / 2, t + j / 2, n - j / 2);
+	}
+
+	static UBERTON_SIMD_INLINE T projectReal(const Complex* a, const Complex* e, int n) {
+		const T* x = reinterpret_cast<const T*>(a);
+		const T* y = reinterpret_cast<const T*>(e);
+		// real parts of the products in the even, imaginary parts in the odd lanes
+		Vec sum0 = L::broadcast(0), sum1 = L::broadcast(0);
+		int j = 0;
+		for (; j + 2 * L::size <= 2 * n; j += 2 * L::size) {
+			sum0 = L::fma(L::load(x + j), L::load(y + j), sum0);
+			sum1 = L::fma(L::load(x + j + L::size), L::load(y + j + L::size), sum1);
+		}
+		for (; j + L::size <= 2 * n; j += L::size) {
+			sum0 = L::fma(L::load(x + j), L::load(y + j), sum0);
+		}
+		alignas(64) T lanes[L::size];
+		L::store(lanes, L::add(sum0, sum1));
+		T sum = 0;
+		for (int l = 0; l < L::size; l += 2) {
+			sum += lanes[l] - lanes[l + 1];
+		}
+		return sum + Scalar::projectReal(a + j / 2, e + j / 2, n - j / 2);
+	}
+
+	static UBERTON_SIMD_INLINE void accumulate(Complex* a, const Complex* e, T amount, int n) {
+		T* x = reinterpret_cast<T*>(a);
+		const T* y = reinterpret_cast<const T*>(e);
+		const Vec factor = L::broadcast(amount);
+		int j = 0;
+		for (; j + L::size <= 2 * n; j += L::size) {
+			L::store(x + j, L::fma(factor, L::load(y + j), L::load(x + j)));
+		}
+		Scalar::accumulate(a + j / 2, e + j / 2, amount, n - j / 2);
+	}
+
+	static UBERTON_SIMD_INLINE T peak(const T* x, int n) {
+		Vec max0 = L::broadcast(0), max1 = L::broadcast(0);
+		int j = 0;
+		for (; j + 2 * L::size <= n; j += 2 * L::size) {
+			max0 = L::max(max0, L::abs(L::load(x + j)));
+			max1 = L::max(max1, L::abs(L::load(x + j + L::size)));
+		}
+		alignas(64) T lanes[L::size];
+		L::store(lanes, L::max(max0, max1));
+		return std::max(Scalar::peak(lanes, L::size), Scalar::peak(x + j, n - j));
+	}
+
+	static UBERTON_SIMD_INLINE bool exceeds(const T* x, int n, T threshold) {
+		constexpr int block = 4 * L::size; // checked at once
+		int j = 0;
+		for (; j + block <= n; j += block) {
+			Vec max = L::abs(L::load(x + j));
+			for (int k = L::size; k < block; k += L::size) {
+				max = L::max(max, L::abs(L::load(x + j + k)));
+			}
+			alignas(64) T lanes[L::size];
+			L::store(lanes, max);
+			if (Scalar::exceeds(lanes, L::size, threshold)) return true;
+		}
+		return Scalar::exceeds(x + j, n - j, threshold);
+	}
+
+	static UBERTON_SIMD_INLINE void step(Complex* a, const Complex* t, const Complex* const* e, const T* x, int numInputs, const Complex* const* o, T* y, int numOutputs, int n) {
+		T* z = reinterpret_cast<T*>(a);
+		const T* w = reinterpret_cast<const T*>(t);
+		const T* e0 = reinterpret_cast<const T*>(e[0]);
+		const T* e1 = reinterpret_cast<const T*>(numInputs > 1 ? e[1] : e[0]);
+		const T* o0 = reinterpret_cast<const T*>(o[0]);
+		const T* o1 = reinterpret_cast<const T*>(numOutputs > 1 ? o[1] : o[0]);
+		const Vec x0 = L::broadcast(numInputs > 0 ? x[0] : T(0));
+		const Vec x1 = L::broadcast(numInputs > 1 ? x[1] : T(0));
+		// as in projectReal(), real parts of the products in the even, imaginary parts in the odd lanes
+		Vec sum0 = L::broadcast(0), sum1 = L::broadcast(0);
+		int j = 0;
+		for (; j + L::size <= 2 * n; j += L::size) {
+			Vec v = L::load(z + j);
+			if (numInputs > 0) v = L::fma(x0, L::load(e0 + j), v);
+			if (numInputs > 1) v = L::fma(x1, L::load(e1 + j), v);
+			const Vec u = L::load(w + j);
+			v = L::fmaddsub(v, L::real(u), L::mul(L::swap(v), L::imag(u)));
+			L::store(z + j, v);
+			sum0 = L::fma(v, L::load(o0 + j), sum0);
+			if (numOutputs > 1) sum1 = L::fma(v, L::load(o1 + j), sum1);
+		}
+		alignas(64) T lanes0[L::size];
+		alignas(64) T lanes1[L::size];
+		L::store(lanes0, sum0);
+		L::store(lanes1, sum1);
+		const Complex* rest[2] = { e[0] + j / 2, numInputs > 1 ? e[1] + j / 2 : nullptr };
+		const Complex* restOut[2] = { o[0] + j / 2, numOutputs > 1 ? o[1] + j / 2 : nullptr };
+		Scalar::step(a + j / 2, t + j / 2, rest, x, numInputs, restOut, y, numOutputs, n - j / 2);
+		for (int l = 0; l < L::size; l += 2) {
+			y[0] += lanes0[l] - lanes0[l + 1];
+			if (numOutputs > 1) y[1] += lanes1[l] - lanes1[l + 1];
+		}
+	}
+
+	// Groups of two vectors of pairs run their recurrences in lockstep from the highest start of
+	// the group. J_m is picked at k − 1 = m without a compare with the weight max(0, 1 − (k − 1 − m)²)
+	// (1 there, ≤ 0 for all other integers) and only rescaled where it exceeds the threshold.
+	static UBERTON_SIMD_INLINE void besselJ(const T* m, const T* x, T* out, int n) {
+		using R = BesselRecurrence<T>;
+		constexpr int group = 2 * L::size;
+		const Vec zero = L::broadcast(0), one = L::broadcast(1), minusOne = L::broadcast(-1);
+		for (int first = 0; first < n; first += group) {
+			const int count = std::min(group, n - first);
+			alignas(64) T negOrders[group];
+			alignas(64) T factors[group];
+			int start = 0;
+			T maxOrder = 0;
+			for (int l = 0; l < group; l++) {
+				const int i = first + std::min(l, count - 1); // unused lanes repeat the last pair
+				const T arg = std::max(x[i], R::minArgument);
+				negOrders[l] = -m[i];
+				factors[l] = 2 / arg;
+				start = std::max(start, R::start(m[i], arg));
+				maxOrder = std::max(maxOrder, m[i]);
+			}
+			Vec negOrder[2], twoOverX[2], current[2], negNext[2], result[2], sum[2];
+			for (int v = 0; v < 2; v++) {
+				negOrder[v] = L::load(negOrders + v * L::size);
+				twoOverX[v] = L::load(factors + v * L::size);
+				current[v] = L::broadcast(R::initial);
+				negNext[v] = zero;
+				result[v] = zero;
+				sum[v] = zero;
+			}
+			for (int k = start; k > 0; k--) {
+				const Vec kk = L::broadcast(T(k));
+				const Vec k1 = L::broadcast(T(k - 1));
+				const bool pick = k - 1 <= maxOrder;
+				const bool even = k > 1 && (k & 1); // J_k-1 with even k - 1 > 0
+				for (int v = 0; v < 2; v++) {
+					const Vec previous = L::fma(L::mul(kk, twoOverX[v]), current[v], negNext[v]);
+					negNext[v] = L::mul(current[v], minusOne);
+					current[v] = previous;
+					if (pick) {
+						const Vec d = L::add(k1, negOrder[v]);
+						result[v] = L::fma(L::max(zero, L::fma(L::mul(d, minusOne), d, one)), previous, result[v]);
+					}
+					if (even) sum[v] = L::add(sum[v], L::add(previous, previous));
+				}
+				if (k % R::checkInterval == 0) {
+					alignas(64) T values[group];
+					L::store(values, current[0]);
+					L::store(values + L::size, current[1]);
+					if (Scalar::exceeds(values, group, R::threshold)) {
+						for (int l = 0; l < group; l++) {
+							values[l] = std::abs(values[l]) > R::threshold ? R::rescale : T(1);
+						}
+						for (int v = 0; v < 2; v++) {
+							const Vec scale = L::load(values + v * L::size);
+							current[v] = L::mul(current[v], scale);
+							negNext[v] = L::mul(negNext[v], scale);
+							result[v] = L::mul(result[v], scale);
+							sum[v] = L::mul(sum[v], scale);
+						}
+					}
+				}
+			}
+			alignas(64) T results[group];
+			alignas(64) T norms[group];
+			for (int v = 0; v < 2; v++) {
+				L::store(results + v * L::size, result[v]);
+				L::store(norms + v * L::size, L::add(sum[v], current[v])); // J_0 + 2·Σ J_2k
+			}
+			for (int l = 0; l < count; l++) {
+				const int i = first + l;
+				out[i] = x[i] < R::minArgument ? (m[i] == 0 ? T(1) : T(0)) : results[l] / norms[l];
+			}
+		}
+	}
+};
+
+#if defined(UBERTON_SIMD_X86)
+
+template<class T>
+struct Sse2Kernels
+{
+	using Vector = VectorKernels<T, InstructionSet::SSE2>;
+	using Complex = std::complex<T>;
+
+	UBERTON_SIMD_TARGET_SSE2 static void rotate(Complex* a, const Complex* t, int n) { Vector::rotate(a, t, n); }
+	UBERTON_SIMD_TARGET_SSE2 static T projectReal(const Complex* a, const Complex* e, int n) { return Vector::projectReal(a, e, n); }
+	UBERTON_SIMD_TARGET_SSE2 static void accumulate(Complex* a, const Complex* e, T amount, int n) { Vector::accumulate(a, e, amount, n); }
+	UBERTON_SIMD_TARGET_SSE2 static T peak(const T* x, int n) { return Vector::peak(x, n); }
+	UBERTON_SIMD_TARGET_SSE2 static bool exceeds(const T* x, int n, T threshold) { return Vector::exceeds(x, n, threshold); }
+	UBERTON_SIMD_TARGET_SSE2 static void step(Complex* a, const Complex* t, const Complex* const* e, const T* x, int numInputs, const Complex* const* o, T* y, int numOutputs, int n) {
+		Vector::step(a, t, e, x, numInputs, o, y, numOutputs, n);
+	}
+	UBERTON_SIMD_TARGET_SSE2 static void besselJ(const T* m, const T* x, T* out, int n) { Vector::besselJ(m, x, out, n); }
+};
+
+template<class T>
+struct Avx2Kernels
+{
+	using Vector = VectorKernels<T, InstructionSet::AVX2>;
+	using Complex = std::complex<T>;
+
+	UBERTON_SIMD_TARGET_AVX2 static void rotate(Complex* a, const Complex* t, int n) { Vector::rotate(a, t, n); }
+	UBERTON_SIMD_TARGET_AVX2 static T projectReal(const Complex* a, const Complex* e, int n) { return Vector::projectReal(a, e, n); }
+	UBERTON_SIMD_TARGET_AVX2 static void accumulate(Complex* a, const Complex* e, T amount, int n) { Vector::accumulate(a, e, amount, n); }
+	UBERTON_SIMD_TARGET_AVX2 static T peak(const T* x, int n) { return Vector::peak(x, n); }
+	UBERTON_SIMD_TARGET_AVX2 static bool exceeds(const T* x, int n, T threshold) { return Vector::exceeds(x, n, threshold); }
+	UBERTON_SIMD_TARGET_AVX2 static void step(Complex* a, const Complex* t, const Complex* const* e, const T* x, int numInputs, const Complex* const* o, T* y, int numOutputs, int n) {
+		Vector::step(a, t, e, x, numInputs, o, y, numOutputs, n);
+	}
+	UBERTON_SIMD_TARGET_AVX2 static void besselJ(const T* m, const T* x, T* out, int n) { Vector::besselJ(m, x, out, n); }
+};
+
+template<class T>
+struct Avx512Kernels
+{
+	using Vector = VectorKernels<T, InstructionSet::AVX512>;
+	using Complex = std::complex<T>;
+
+	UBERTON_SIMD_TARGET_AVX512 static void rotate(Complex* a, const Complex* t, int n) { Vector::rotate(a, t, n); }
+	UBERTON_SIMD_TARGET_AVX512 static T projectReal(const Complex* a, const Complex* e, int n) { return Vector::projectReal(a, e, n); }
+	UBERTON_SIMD_TARGET_AVX512 static void accumulate(Complex* a, const Complex* e, T amount, int n) { Vector::accumulate(a, e, amount, n); }
+	UBERTON_SIMD_TARGET_AVX512 static T peak(const T* x, int n) { return Vector::peak(x, n); }
+	UBERTON_SIMD_TARGET_AVX512 static bool exceeds(const T* x, int n, T threshold) { return Vector::exceeds(x, n, threshold); }
+	UBERTON_SIMD_TARGET_AVX512 static void step(Complex* a, const Complex* t, const Complex* const* e, const T* x, int numInputs, const Complex* const* o, T* y, int numOutputs, int n) {
+		Vector::step(a, t, e, x, numInputs, o, y, numOutputs, n);
+	}
+	UBERTON_SIMD_TARGET_AVX512 static void besselJ(const T* m, const T* x, T* out, int n) { Vector::besselJ(m, x, out, n); }
+};
+
+struct CpuFeatures
+{
+	bool sse2{ false };
+	bool avx2{ false }; // with FMA
+	bool avx512{ false };
+};
+
+void cpuid(int leaf, int subleaf, unsigned int regs[4]) {
+#if defined(_MSC_VER)
+	int r[4];
+	__cpuidex(r, leaf, subleaf);
+	for (int i = 0; i < 4; i++) regs[i] = static_cast<unsigned int>(r[i]);
+#else
+	__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// The register state the operating system saves on context switches (XCR0)
+unsigned long long enabledStateComponents() {
+#if defined(_MSC_VER)
+	return _xgetbv(0);
+#else
+	unsigned int lo, hi;
+	__asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+	return (static_cast<unsigned long long>(hi) << 32) | lo;
+#endif
+}
+
+CpuFeatures queryCpuFeatures() {
+	CpuFeatures features;
+	unsigned int regs[4];
+	cpuid(0, 0, regs);
+	const unsigned int maxLeaf = regs[0];
+	if (maxLeaf < 1) return features;
+	cpuid(1, 0, regs);
+	features.sse2 = regs[3] & (1u << 26);
+	const bool fma = regs[2] & (1u << 12);
+	const bool osxsave = regs[2] & (1u << 27);
+	const bool avx = regs[2] & (1u << 28);
+	if (maxLeaf < 7 || !osxsave || !avx) return features;
+	const unsigned long long xcr0 = enabledStateComponents();
+	cpuid(7, 0, regs);
+	features.avx2 = fma && (regs[1] & (1u << 5)) && (xcr0 & 0x6) == 0x6;			 // SSE and AVX state
+	features.avx512 = features.avx2 && (regs[1] & (1u << 16)) && (xcr0 & 0xe6) == 0xe6; // and opmask, ZMM state
+	return features;
+}
+
+const CpuFeatures& cpuFeatures() {
+	static const CpuFeatures features = queryCpuFeatures();
+	return features;
+}
+
+#endif
+
+template<class T, template<class> class Backend>
+constexpr Kernels<T> makeKernels() {
+	return { &Backend<T>::rotate, &Backend<T>::projectReal, &Backend<T>::accumulate, &Backend<T>::peak, &Backend<T>::exceeds, &Backend<T>::step, &Backend<T>::besselJ };
+}
+
+template<template<class> class Backend>
+constexpr KernelTable makeTable(InstructionSet set) {
+	return { set, makeKernels<float, Backend>(), makeKernels<double, Backend>() };
+}
+
+constexpr KernelTable scalarTable = makeTable<ScalarKernels>(InstructionSet::Scalar);
+#if defined(UBERTON_SIMD_X86)
+constexpr KernelTable sse2Table = makeTable<Sse2Kernels>(InstructionSet::SSE2);
+constexpr KernelTable avx2Table = makeTable<Avx2Kernels>(InstructionSet::AVX2);
+constexpr KernelTable avx512Table = makeTable<Avx512Kernels>(InstructionSet::AVX512);
+#endif
+
+}
+
+std::atomic<const KernelTable*> activeKernels{ &scalarTable };
+
+const char* name(InstructionSet set) {
+	switch (set) {
+	case InstructionSet::Scalar: return "Scalar";
+	case InstructionSet::SSE2: return "SSE2";
+	case InstructionSet::AVX2: return "AVX2";
+	case InstructionSet::AVX512: return "AVX-512";
+	}
+	return "";
+}
+
+bool isSupported(InstructionSet set) {
+	switch (set) {
+	case InstructionSet::Scalar: return true;
+#if defined(UBERTON_SIMD_X86)
+	case InstructionSet::SSE2: return cpuFeatures().sse2;
+	case InstructionSet::AVX2: return cpuFeatures().avx2;
+	case InstructionSet::AVX512: return cpuFeatures().avx512;
+#endif
+	default: return false;
+	}
+}
+
+InstructionSet detectInstructionSet() {
+	for (auto set : { InstructionSet::AVX512, InstructionSet::AVX2, InstructionSet::SSE2 }) {
+		if (isSupported(set)) return set;
+	}
+	return InstructionSet::Scalar;
+}
+
+bool selectKernels(InstructionSet set) {
+	if (!isSupported(set)) return false;
+	const KernelTable* table = &scalarTable;
+	switch (set) {
+#if defined(UBERTON_SIMD_X86)
+	case InstructionSet::SSE2: table = &sse2Table; break;
+	case InstructionSet::AVX2: table = &avx2Table; break;
+	case InstructionSet::AVX512: table = &avx512Table; break;
+#endif
+	default: break;
+	}
+	activeKernels.store(table, std::memory_order_release);
+	return true;
+}
+
+namespace {
+// once when the library (i.e. the plugin) is loaded, before anything is processed
+struct SelectOnLoad
+{
+	SelectOnLoad() { selectKernels(detectInstructionSet()); }
+} selectOnLoad;
+}
+
+}
+}
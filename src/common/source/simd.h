@@ -0,0 +1,278 @@
+
+// Portable SIMD lane types and DSP kernels that are selected for the CPU when the plugin is loaded
+//
+// -----------------------------------------------------------------------------------------------------------------------------
+// This file is part of the Überton project. Copyright (C) 2021 Überton
+//
+// Überton is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+// Überton is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details. You should
+// have received a copy of the GNU General Public License along with Überton. If not, see http://www.gnu.org/licenses/.
+// -----------------------------------------------------------------------------------------------------------------------------
+
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <complex>
+#include <type_traits>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define UBERTON_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+// GCC and Clang compile code for an instruction set above the baseline of the binary only in
+// functions with a target attribute, MSVC accepts all intrinsics everywhere.
+#if defined(_MSC_VER) && !defined(__clang__)
+#define UBERTON_SIMD_TARGET(isa)
+#define UBERTON_SIMD_INLINE __forceinline
+#else
+#define UBERTON_SIMD_TARGET(isa) __attribute__((target(isa)))
+#define UBERTON_SIMD_INLINE inline __attribute__((always_inline))
+#endif
+#define UBERTON_SIMD_TARGET_SSE2 UBERTON_SIMD_TARGET("sse2")
+#define UBERTON_SIMD_TARGET_AVX2 UBERTON_SIMD_TARGET("avx2,fma")
+#define UBERTON_SIMD_TARGET_AVX512 UBERTON_SIMD_TARGET("avx512f")
+
+namespace Uberton {
+namespace Simd {
+
+enum class InstructionSet
+{
+	Scalar,
+	SSE2,
+	AVX2, // with FMA
+	AVX512
+};
+
+const char* name(InstructionSet set);
+
+/// Whether the CPU and the operating system support set and this build has kernels for it
+bool isSupported(InstructionSet set);
+
+/// The best supported instruction set
+InstructionSet detectInstructionSet();
+
+// Lanes<T, set> wraps the vector type of an instruction set for T = float or double with static
+// functions for the few operations the kernels need. They carry the target attribute of their
+// instruction set and can only be used (and inlined) in functions with the same attribute, see
+// simd.cpp. Loads and stores are unaligned. Complex numbers are interleaved (re, im, re, im, ...),
+// the layout of std::complex<T> arrays.
+//
+//   fma(a, b, c)      = a·b + c (fused if the instruction set has it)
+//   real(z), imag(z)  = (re, re, ...), (im, im, ...)
+//   swap(z)           = (im, re, ...)
+//   fmaddsub(a, b, c) = a·b − c in the real and a·b + c in the imaginary lanes
+//
+// so that the complex product of z and w is fmaddsub(z, real(w), mul(swap(z), imag(w))).
+template<class T, InstructionSet set>
+struct Lanes;
+
+#if defined(UBERTON_SIMD_X86)
+
+template<>
+struct Lanes<float, InstructionSet::SSE2>
+{
+	using Vec = __m128;
+	static constexpr int size = 4;
+	UBERTON_SIMD_TARGET_SSE2 static Vec load(const float* p) { return _mm_loadu_ps(p); }
+	UBERTON_SIMD_TARGET_SSE2 static void store(float* p, Vec x) { _mm_storeu_ps(p, x); }
+	UBERTON_SIMD_TARGET_SSE2 static Vec broadcast(float x) { return _mm_set1_ps(x); }
+	UBERTON_SIMD_TARGET_SSE2 static Vec add(Vec a, Vec b) { return _mm_add_ps(a, b); }
+	UBERTON_SIMD_TARGET_SSE2 static Vec mul(Vec a, Vec b) { return _mm_mul_ps(a, b); }
+	UBERTON_SIMD_TARGET_SSE2 static Vec fma(Vec a, Vec b, Vec c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+	UBERTON_SIMD_TARGET_SSE2 static Vec abs(Vec x) { return _mm_andnot_ps(_mm_set1_ps(-0.f), x); }
+	UBERTON_SIMD_TARGET_SSE2 static Vec max(Vec a, Vec b) { return _mm_max_ps(a, b); }
+	UBERTON_SIMD_TARGET_SSE2 static Vec real(Vec z) { return _mm_shuffle_ps(z, z, _MM_SHUFFLE(2, 2, 0, 0)); }
+	UBERTON_SIMD_TARGET_SSE2 static Vec imag(Vec z) { return _mm_shuffle_ps(z, z, _MM_SHUFFLE(3, 3, 1, 1)); }
+	UBERTON_SIMD_TARGET_SSE2 static Vec swap(Vec z) { return _mm_shuffle_ps(z, z, _MM_SHUFFLE(2, 3, 0, 1)); }
+	UBERTON_SIMD_TARGET_SSE2 static Vec fmaddsub(Vec a, Vec b, Vec c) {
+		return _mm_add_ps(_mm_mul_ps(a, b), _mm_xor_ps(c, _mm_set_ps(0.f, -0.f, 0.f, -0.f)));
+	}
+};
+
+template<>
+struct Lanes<double, InstructionSet::SSE2>
+{
+	using Vec = __m128d;
+	static constexpr int size = 2;
+	UBERTON_SIMD_TARGET_SSE2 static Vec load(const double* p) { return _mm_loadu_pd(p); }
+	UBERTON_SIMD_TARGET_SSE2 static void store(double* p, Vec x) { _mm_storeu_pd(p, x); }
+	UBERTON_SIMD_TARGET_SSE2 static Vec broadcast(double x) { return _mm_set1_pd(x); }
+	UBERTON_SIMD_TARGET_SSE2 static Vec add(Vec a, Vec b) { return _mm_add_pd(a, b); }
+	UBERTON_SIMD_TARGET_SSE2 static Vec mul(Vec a, Vec b) { return _mm_mul_pd(a, b); }
+	UBERTON_SIMD_TARGET_SSE2 static Vec fma(Vec a, Vec b, Vec c) { return _mm_add_pd(_mm_mul_pd(a, b), c); }
+	UBERTON_SIMD_TARGET_SSE2 static Vec abs(Vec x) { return _mm_andnot_pd(_mm_set1_pd(-0.0), x); }
+	UBERTON_SIMD_TARGET_SSE2 static Vec max(Vec a, Vec b) { return _mm_max_pd(a, b); }
+	UBERTON_SIMD_TARGET_SSE2 static Vec real(Vec z) { return _mm_unpacklo_pd(z, z); }
+	UBERTON_SIMD_TARGET_SSE2 static Vec imag(Vec z) { return _mm_unpackhi_pd(z, z); }
+	UBERTON_SIMD_TARGET_SSE2 static Vec swap(Vec z) { return _mm_shuffle_pd(z, z, 1); }
+	UBERTON_SIMD_TARGET_SSE2 static Vec fmaddsub(Vec a, Vec b, Vec c) {
+		return _mm_add_pd(_mm_mul_pd(a, b), _mm_xor_pd(c, _mm_set_pd(0.0, -0.0)));
+	}
+};
+
+template<>
+struct Lanes<float, InstructionSet::AVX2>
+{
+	using Vec = __m256;
+	static constexpr int size = 8;
+	UBERTON_SIMD_TARGET_AVX2 static Vec load(const float* p) { return _mm256_loadu_ps(p); }
+	UBERTON_SIMD_TARGET_AVX2 static void store(float* p, Vec x) { _mm256_storeu_ps(p, x); }
+	UBERTON_SIMD_TARGET_AVX2 static Vec broadcast(float x) { return _mm256_set1_ps(x); }
+	UBERTON_SIMD_TARGET_AVX2 static Vec add(Vec a, Vec b) { return _mm256_add_ps(a, b); }
+	UBERTON_SIMD_TARGET_AVX2 static Vec mul(Vec a, Vec b) { return _mm256_mul_ps(a, b); }
+	UBERTON_SIMD_TARGET_AVX2 static Vec fma(Vec a, Vec b, Vec c) { return _mm256_fmadd_ps(a, b, c); }
+	UBERTON_SIMD_TARGET_AVX2 static Vec abs(Vec x) { return _mm256_andnot_ps(_mm256_set1_ps(-0.f), x); }
+	UBERTON_SIMD_TARGET_AVX2 static Vec max(Vec a, Vec b) { return _mm256_max_ps(a, b); }
+	UBERTON_SIMD_TARGET_AVX2 static Vec real(Vec z) { return _mm256_moveldup_ps(z); }
+	UBERTON_SIMD_TARGET_AVX2 static Vec imag(Vec z) { return _mm256_movehdup_ps(z); }
+	UBERTON_SIMD_TARGET_AVX2 static Vec swap(Vec z) { return _mm256_permute_ps(z, _MM_SHUFFLE(2, 3, 0, 1)); }
+	UBERTON_SIMD_TARGET_AVX2 static Vec fmaddsub(Vec a, Vec b, Vec c) { return _mm256_fmaddsub_ps(a, b, c); }
+};
+
+template<>
+struct Lanes<double, InstructionSet::AVX2>
+{
+	using Vec = __m256d;
+	static constexpr int size = 4;
+	UBERTON_SIMD_TARGET_AVX2 static Vec load(const double* p) { return _mm256_loadu_pd(p); }
+	UBERTON_SIMD_TARGET_AVX2 static void store(double* p, Vec x) { _mm256_storeu_pd(p, x); }
+	UBERTON_SIMD_TARGET_AVX2 static Vec broadcast(double x) { return _mm256_set1_pd(x); }
+	UBERTON_SIMD_TARGET_AVX2 static Vec add(Vec a, Vec b) { return _mm256_add_pd(a, b); }
+	UBERTON_SIMD_TARGET_AVX2 static Vec mul(Vec a, Vec b) { return _mm256_mul_pd(a, b); }
+	UBERTON_SIMD_TARGET_AVX2 static Vec fma(Vec a, Vec b, Vec c) { return _mm256_fmadd_pd(a, b, c); }
+	UBERTON_SIMD_TARGET_AVX2 static Vec abs(Vec x) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), x); }
+	UBERTON_SIMD_TARGET_AVX2 static Vec max(Vec a, Vec b) { return _mm256_max_pd(a, b); }
+	UBERTON_SIMD_TARGET_AVX2 static Vec real(Vec z) { return _mm256_movedup_pd(z); }
+	UBERTON_SIMD_TARGET_AVX2 static Vec imag(Vec z) { return _mm256_permute_pd(z, 0xF); }
+	UBERTON_SIMD_TARGET_AVX2 static Vec swap(Vec z) { return _mm256_permute_pd(z, 0x5); }
+	UBERTON_SIMD_TARGET_AVX2 static Vec fmaddsub(Vec a, Vec b, Vec c) { return _mm256_fmaddsub_pd(a, b, c); }
+};
+
+// GCC 12 warns about the deliberately undefined pass-through operand (_mm512_undefined_pd()) of
+// the unmasked AVX-512 intrinsics (max, permute, ...) wherever they are inlined
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+template<>
+struct Lanes<float, InstructionSet::AVX512>
+{
+	using Vec = __m512;
+	static constexpr int size = 16;
+	UBERTON_SIMD_TARGET_AVX512 static Vec load(const float* p) { return _mm512_loadu_ps(p); }
+	UBERTON_SIMD_TARGET_AVX512 static void store(float* p, Vec x) { _mm512_storeu_ps(p, x); }
+	UBERTON_SIMD_TARGET_AVX512 static Vec broadcast(float x) { return _mm512_set1_ps(x); }
+	UBERTON_SIMD_TARGET_AVX512 static Vec add(Vec a, Vec b) { return _mm512_add_ps(a, b); }
+	UBERTON_SIMD_TARGET_AVX512 static Vec mul(Vec a, Vec b) { return _mm512_mul_ps(a, b); }
+	UBERTON_SIMD_TARGET_AVX512 static Vec fma(Vec a, Vec b, Vec c) { return _mm512_fmadd_ps(a, b, c); }
+	UBERTON_SIMD_TARGET_AVX512 static Vec abs(Vec x) { return _mm512_abs_ps(x); }
+	UBERTON_SIMD_TARGET_AVX512 static Vec max(Vec a, Vec b) { return _mm512_max_ps(a, b); }
+	UBERTON_SIMD_TARGET_AVX512 static Vec real(Vec z) { return _mm512_moveldup_ps(z); }
+	UBERTON_SIMD_TARGET_AVX512 static Vec imag(Vec z) { return _mm512_movehdup_ps(z); }
+	UBERTON_SIMD_TARGET_AVX512 static Vec swap(Vec z) { return _mm512_permute_ps(z, _MM_SHUFFLE(2, 3, 0, 1)); }
+	UBERTON_SIMD_TARGET_AVX512 static Vec fmaddsub(Vec a, Vec b, Vec c) { return _mm512_fmaddsub_ps(a, b, c); }
+};
+
+template<>
+struct Lanes<double, InstructionSet::AVX512>
+{
+	using Vec = __m512d;
+	static constexpr int size = 8;
+	UBERTON_SIMD_TARGET_AVX512 static Vec load(const double* p) { return _mm512_loadu_pd(p); }
+	UBERTON_SIMD_TARGET_AVX512 static void store(double* p, Vec x) { _mm512_storeu_pd(p, x); }
+	UBERTON_SIMD_TARGET_AVX512 static Vec broadcast(double x) { return _mm512_set1_pd(x); }
+	UBERTON_SIMD_TARGET_AVX512 static Vec add(Vec a, Vec b) { return _mm512_add_pd(a, b); }
+	UBERTON_SIMD_TARGET_AVX512 static Vec mul(Vec a, Vec b) { return _mm512_mul_pd(a, b); }
+	UBERTON_SIMD_TARGET_AVX512 static Vec fma(Vec a, Vec b, Vec c) { return _mm512_fmadd_pd(a, b, c); }
+	UBERTON_SIMD_TARGET_AVX512 static Vec abs(Vec x) { return _mm512_abs_pd(x); }
+	UBERTON_SIMD_TARGET_AVX512 static Vec max(Vec a, Vec b) { return _mm512_max_pd(a, b); }
+	UBERTON_SIMD_TARGET_AVX512 static Vec real(Vec z) { return _mm512_movedup_pd(z); }
+	UBERTON_SIMD_TARGET_AVX512 static Vec imag(Vec z) { return _mm512_permute_pd(z, 0xFF); }
+	UBERTON_SIMD_TARGET_AVX512 static Vec swap(Vec z) { return _mm512_permute_pd(z, 0x55); }
+	UBERTON_SIMD_TARGET_AVX512 static Vec fmaddsub(Vec a, Vec b, Vec c) { return _mm512_fmaddsub_pd(a, b, c); }
+};
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif
+
+// The dispatched kernels for T = float or double. All pointers may be unaligned, n is the number
+// of elements (complex numbers for the complex arrays).
+template<class T>
+struct Kernels
+{
+	using Complex = std::complex<T>;
+
+	void (*rotate)(Complex* a, const Complex* t, int n);				// a[i] *= t[i]
+	T (*projectReal)(const Complex* a, const Complex* e, int n);		// Σ Re(a[i]·e[i])
+	void (*accumulate)(Complex* a, const Complex* e, T amount, int n); // a[i] += amount·e[i]
+	T (*peak)(const T* x, int n);										// max |x[i]|, 0 for n = 0
+	bool (*exceeds)(const T* x, int n, T threshold);					// any |x[i]| > threshold, stops at the first
+
+	// One time step of a modal bank in a single pass: a[i] = (a[i] + Σ_c x[c]·e[c][i])·t[i] and
+	// y[c] = Σ_i Re(a[i]·o[c][i]) with up to two inputs e and outputs o
+	void (*step)(Complex* a, const Complex* t, const Complex* const* e, const T* x, int numInputs, const Complex* const* o, T* y, int numOutputs, int n);
+
+	// Bessel functions of the first kind J_m[i](x[i]) for integer orders m[i] ≥ 0 and x[i] ≥ 0,
+	// like Math::besselJ() but several recurrences at once. Pairs with similar start (max(m, x))
+	// next to each other save steps.
+	void (*besselJ)(const T* m, const T* x, T* out, int n);
+};
+
+struct KernelTable
+{
+	InstructionSet instructionSet;
+	Kernels<float> f32;
+	Kernels<double> f64;
+};
+
+// Starts out with the scalar kernels and is switched to the best supported instruction set while
+// the library is loaded (before any plugin instance is created). The tables are constant and
+// switching only swaps the pointer, so reading it is free of locks and never sees a mix of two sets.
+extern std::atomic<const KernelTable*> activeKernels;
+
+template<class T>
+const Kernels<T>& kernels() {
+	static_assert(std::is_same_v<T, float> || std::is_same_v<T, double>, "SIMD kernels are only available for float and double");
+	const KernelTable& table = *activeKernels.load(std::memory_order_acquire);
+	if constexpr (std::is_same_v<T, float>) {
+		return table.f32;
+	}
+	else {
+		return table.f64;
+	}
+}
+
+inline InstructionSet activeInstructionSet() { return activeKernels.load(std::memory_order_acquire)->instructionSet; }
+
+// Register width of set in bytes (1 for the scalar kernels)
+constexpr int vectorBytes(InstructionSet set) {
+	switch (set) {
+	case InstructionSet::SSE2: return 16;
+	case InstructionSet::AVX2: return 32;
+	case InstructionSet::AVX512: return 64;
+	default: return 1;
+	}
+}
+
+/// Number of T processed at once by the active kernels, e.g. to weigh the cost of the modal
+/// bank against other algorithms
+template<class T>
+int vectorWidth() { return std::max(1, vectorBytes(activeInstructionSet()) / static_cast<int>(sizeof(T))); }
+
+/// Use the kernels of set instead of the detected ones (e.g. to compare them in a benchmark),
+/// returns false and keeps the current ones if set is not supported. Calls made while audio
+/// is processed take effect from the next kernels() call on.
+bool selectKernels(InstructionSet set);
+
+}
+}
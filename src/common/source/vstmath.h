@@ -3,6 +3,7 @@
 //  - Vector class
 //  - Factorial
 //  - Legendre polynomials (and associated legendre)
+//  - Bessel functions of the first kind and their zeros
 //  - Sine/cosine lookup and approximations
 //  - Midi note to frequency mapping
 //
@@ -444,7 +445,7 @@ inline double lookupPlusOneHalfGamma(int n) {
 
 
 template<class T>
-inline T legendre_p0(const T& x) {
+inline T legendre_p0(const T& /*x*/) {
 	return static_cast<T>(1);
 }
 
@@ -563,6 +564,101 @@ inline T generalized_assoc_legendre_plus_onehalf(int l, int m, T x) {
 //
 
 
+
+// ----------------------------------------------------------------
+// ----------------------------------------------------------------
+// --------------------------- Bessel -----------------------------
+// ----------------------------------------------------------------
+
+
+constexpr int besselZerosOrders = 48;	// tabulated orders m = 0, ..., 47
+constexpr int besselZerosPerOrder = 16; // tabulated zeros n = 1, ..., 16 per order
+constexpr double besselZerosBound = 52.6240518411150; // j_0,17, all zeros below are in the table
+
+//
+// Positive zeros j_m,n of the Bessel functions of the first kind, besselZeros[m][n - 1]
+// (computed by bisection with std::cyl_bessel_j in long double)
+//
+constexpr double besselZeros[besselZerosOrders][besselZerosPerOrder] = {
+	{ 2.40482555769577, 5.52007811028631, 8.65372791291101, 11.7915344390143, 14.9309177084878, 18.0710639679109, 21.2116366298793, 24.3524715307493, 27.4934791320403, 30.634606468432, 33.7758202135736, 36.917098353664, 40.0584257646282, 43.1997917131767, 46.3411883716618, 49.4826098973978 },
+	{ 3.83170597020751, 7.01558666981562, 10.1734681350627, 13.3236919363142, 16.4706300508776, 19.6158585104682, 22.7600843805928, 25.9036720876184, 29.0468285349169, 32.1896799109744, 35.3323075500839, 38.4747662347716, 41.6170942128145, 44.7593189976528, 47.9014608871855, 51.0435351835715 },
+	{ 5.13562230184068, 8.41724414039986, 11.6198411721491, 14.7959517823513, 17.9598194949878, 21.1169970530218, 24.2701123135731, 27.4205735499846, 30.5692044955164, 33.7165195092227, 36.8628565112838, 40.0084467334782, 43.1534537783715, 46.2979966772369, 49.4421641104169, 52.586023506816 },
+	{ 6.38016189592398, 9.76102312998167, 13.0152007216984, 16.2234661603188, 19.409415226435, 22.5827295931044, 25.748166699295, 28.9083507809218, 32.0648524070977, 35.2186707386101, 38.3704724347569, 41.5207196704068, 44.6697431166173, 47.8177856915333, 50.9650299062052, 54.1116155698219 },
+	{ 7.5883424345038, 11.0647094885012, 14.3725366716176, 17.6159660498048, 20.8269329569624, 24.0190195247711, 27.1990877659813, 30.3710076671172, 33.5371377118192, 36.6990011287446, 39.8576273021809, 43.0137377233544, 46.1678535129244, 49.3203606863903, 52.471551398458, 55.621650909768 },
+	{ 8.77148381595995, 12.3386041974669, 15.7001740797117, 18.9801338751799, 22.2177998965613, 25.4303411542227, 28.6266183072911, 31.8117167240478, 34.9887812945593, 38.1598685619671, 41.3263832540474, 44.4893191232197, 47.6493998066971, 50.8071652030063, 53.9630265583781, 57.1173027815043 },
+	{ 9.93610952421768, 13.5892901705412, 17.003819667816, 20.3207892135665, 23.5860844355814, 26.8201519834114, 30.0337223865705, 33.2330417628471, 36.4220196682585, 39.6032394160754, 42.7784816131995, 45.9490159980426, 49.1157737247643, 52.2794539036011, 55.4405920688531, 58.5996056312377 },
+	{ 11.0863700192451, 14.8212687270132, 18.2875828324817, 21.6415410198484, 24.934927887673, 28.1911884594832, 31.4227941922656, 34.6370893520693, 37.8387173828536, 41.0307736915855, 44.2154085052613, 47.3941657555705, 50.5681846797956, 53.7383253719633, 56.9052499919788, 60.069476998277 },
+	{ 12.2250922640047, 16.0377741908877, 19.5545364309971, 22.9451731318746, 26.2668146411766, 29.5456596709985, 32.7958000373415, 36.0256150638696, 39.2404479951781, 42.4438877432736, 45.6384441821991, 48.8259303815539, 52.0076914566869, 55.184747939289, 58.3578890252697, 61.527735166816 },
+	{ 13.3543004774353, 17.2412203824891, 20.8070477892641, 24.2338852577506, 27.583748963573, 30.8853789676967, 34.1543779238551, 37.4000999771566, 40.6285537189645, 43.8438014203373, 47.048700737654, 50.2453269553054, 53.4352271570421, 56.6195802665084, 59.7993016309602, 62.9751135342416 },
+	{ 14.4755006865545, 18.4334636669666, 22.0469853646978, 25.5094505541828, 28.8873750635305, 32.2118561997127, 35.4999092053739, 38.7618070178817, 42.0041902366718, 45.231574103535, 48.4471513872694, 51.6532516681659, 54.8516190759633, 58.0435879282325, 61.2301979772927, 64.4122724129244 },
+	{ 15.5898478844555, 19.6159669039669, 23.2758537262634, 26.7733225455095, 30.1790611787849, 33.5263640755886, 36.8335713418949, 40.1118232709542, 43.3683609475217, 46.6081326762749, 49.8346535103967, 53.0504989591351, 56.2576047151145, 59.457456908388, 62.6512173882029, 65.8398088044451 },
+	{ 16.6982499338482, 20.7899063600784, 24.4948850438814, 28.0267099499731, 31.459960035318, 34.8299869902902, 38.1563775046814, 41.4510923079397, 44.7219435431911, 47.974293531269, 51.2119670041011, 54.4377769283251, 57.6538448119069, 60.8618046824805, 64.0629378248501, 67.2582645563412 },
+	{ 17.8014351532824, 21.9562440678363, 25.7051030539247, 29.2706304418748, 32.7310533109784, 36.1236576664488, 39.4692068252439, 42.7804392654472, 46.0657109115756, 49.3307800964435, 52.5797690643834, 55.8157198763058, 59.0409340372493, 62.2571893937317, 65.4658837972321, 68.6681332168911 },
+	{ 18.899997953174, 23.1157783472528, 26.9073689761821, 30.505950163896, 33.9931849847815, 37.4081851286397, 40.7728278535019, 44.1005905657983, 47.4003477805432, 50.6782369464799, 53.9386662091269, 57.1848985981193, 60.4194098521303, 63.6441175089623, 66.8605330122601, 70.0698658331965 },
+	{ 19.9944306298164, 24.2691800262089, 28.1024152316678, 31.7334133443745, 35.2470867857933, 38.6842763892896, 42.0679169986568, 45.4121896147331, 48.7264641162407, 52.0172412788816, 55.28920414656, 58.5458289043851, 61.789759895945, 65.0230502510422, 68.2473219964208, 71.4638758850227 },
+	{ 21.0851461130647, 25.4170190063428, 29.2908706963134, 32.9536648850688, 36.4933979124465, 39.9525534902212, 43.3550732038518, 46.7158094350258, 50.0446060168425, 53.3483123318529, 56.631875942813, 59.8989787287768, 63.1524281933803, 66.3944090385883, 69.6266508798697, 72.8505435067542 },
+	{ 22.1724946188263, 26.5597841380254, 30.4732799463335, 34.1672678538405, 37.732680522054, 41.213567059135, 44.6348297531127, 48.0119629360655, 51.3552646507517, 54.6719191775795, 57.9671288334661, 61.2447740981704, 64.5078204027352, 67.7585801138869, 70.9988874898542, 74.2302191190655 },
+	{ 23.25677608511, 27.6978983508553, 31.650118151857, 35.3747172179548, 38.965432047654, 42.4678072133308, 45.907663866365, 49.3011113380306, 52.6588836515202, 55.9884872205543, 59.2953699442866, 62.5836041801356, 65.8563082805149, 69.115918502286, 72.3643708714945, 75.6032265680973 },
+	{ 24.3382496234072, 28.8317303513009, 32.8218027618736, 36.5764507589996, 40.1920951008371, 43.7157124179554, 47.1740045682365, 50.583671140024, 53.9558652828627, 57.2984036543732, 60.6169711271735, 63.9158255761563, 67.1982335006616, 70.466751417355, 73.7234143308358, 76.9698658513459 },
+	{ 25.4171408140725, 29.9616037916252, 33.9887027852352, 37.7728578443991, 41.4130655138926, 44.9576767484217, 48.4342391952057, 51.8600199280746, 55.2465756146393, 58.6020220738467, 61.9322730728826, 65.2417659938166, 68.533910938821, 71.8113812037196, 75.0763080770358, 78.3304154948432 },
+	{ 26.493647416019, 31.0878045460303, 35.1511462445783, 38.9642865475951, 42.6286989308185, 46.194055894389, 49.6887188180811, 53.1305012504038, 56.5313488968685, 59.8996663967787, 63.2415888283659, 66.5617274042516, 69.8636315104012, 73.1500878919949, 76.4233215263568, 79.6851346346132 },
+	{ 27.5679438912622, 32.2105865494821, 36.3094262234586, 40.1510494809325, 43.8393162543919, 47.4251721615751, 50.937762792622, 54.3954287365206, 57.8104912784283, 61.1916342175167, 64.5452068206938, 67.875988770312, 71.187664634292, 74.4831314264882, 77.7647053193715, 81.0342648461328 },
+	{ 28.640185030764, 33.3301765307659, 37.4638058174514, 41.3334286141939, 45.0452081825569, 48.6513186682398, 52.1816626034961, 55.6550895985435, 59.0842839864422, 62.4781996896588, 65.8433934695246, 69.1848084146234, 72.5062603808247, 75.810753615439, 79.10069309381, 82.3780317580824 },
+	{ 29.7105088898112, 34.4467778847176, 38.6145222220815, 42.5116792859419, 46.2466390132317, 49.8727628890996, 53.4206851310378, 56.9097476241952, 60.352986058851, 63.7596160161843, 67.1363954544691, 70.4884260839277, 73.8196513520235, 77.1331798448655, 80.43150304825, 83.7166464806594 },
+	{ 30.7790391865673, 35.5605738670345, 39.761790134224, 43.6860335666763, 47.4438498564916, 51.08974966636, 54.6550754431627, 58.1596457487303, 61.616836704499, 65.0361176103562, 68.4244416914216, 71.7870647559507, 75.1280543337913, 78.4506205900872, 81.7573393260169, 85.050306873829 },
+	{ 31.8458872786873, 36.6717302506885, 40.9058046024923, 44.856703097116, 48.6370613629595, 52.3025037824672, 55.8850591940292, 59.4050082759006, 62.8760573508886, 66.3079219790168, 69.7077450622004, 73.0809322269462, 76.4316717529225, 79.763272753348, 83.0783932439071, 86.3791986768872 },
+	{ 32.9111538049842, 37.7803975505171, 42.0467434316519, 46.0238814981534, 49.8264760544082, 53.5112321699736, 57.110844694987, 60.6460428046863, 64.1308534286104, 67.5752313706, 70.9865039340716, 74.3702225115652, 77.7306929663708, 81.0713208513562, 84.3948443864676, 87.703496517416 },
+	{ 33.9749300587487, 38.8867128985445, 43.1847692232648, 47.1877464287473, 51.0122803250912, 54.7161258190625, 58.3326247108322, 61.8829419079998, 65.3814159326284, 68.83823422277, 72.2609034994972, 75.6551170814429, 79.0252954057647, 82.3749380728051, 85.7068615833657, 89.0233648149927 },
+	{ 35.0372991442602, 39.9908016345971, 44.320031117468, 48.3484613524947, 52.1946461688142, 55.9173614317029, 59.5505780245508, 63.1158846012405, 66.6279227935537, 70.0971064386397, 73.5311169614047, 76.9357859646205, 80.3156455965276, 83.6742872228401, 87.0146037847473, 90.3389585927545 },
+	{ 36.0983369567477, 41.0927786631534, 45.4526662875566, 49.5061770616309, 53.3737326762289, 57.1151028623105, 60.7648708059412, 64.3450376319312, 67.8705400863841, 71.3520125157075, 74.7973065851754, 78.2123887244238, 81.6019000679753, 84.969521568886, 88.3182208472888, 91.6504242080365 },
+	{ 37.1581130175366, 42.1927496169611, 46.5828012288235, 50.6610329978652, 54.5496873385589, 58.3095023775856, 61.9756578132906, 65.5705566163324, 69.1094230996142, 72.6031065477362, 76.0596246351991, 79.4850753335484, 82.8842061682993, 86.2607856001256, 89.6178542418197, 92.9579000117221 },
+	{ 38.2166911896038, 43.2908118599156, 47.710552875148, 51.81315840212, 55.722647187422, 59.5007017624602, 63.1830834522919, 66.7925870446168, 70.3447172839058, 73.8505331166005, 77.3182142110849, 80.753986956725, 84.1627027962932, 87.5482157111525, 90.9136376918617, 94.2615169446183 },
+	{ 39.2741302937459, 44.387055355443, 48.8360295705794, 52.9626733194371, 56.8927397951915, 60.6888332944737, 64.3872827123574, 68.0112651726849, 71.5765590964684, 75.0944280884972, 78.5732099963446, 82.0192566533726, 85.437521059974, 88.8319408188385, 92.2056977511453, 95.5613990780458 },
+	{ 40.3304846416591, 45.4815634217207, 49.9593319182211, 54.1096894806843, 58.060084156151, 61.8740206051761, 65.5883819972094, 69.2267188158353, 72.805076754806, 76.3349193267416, 79.8247389304755, 83.2810100099973, 86.7087848708197, 90.1120829202113, 93.4941543270717, 96.8576641048859 },
+	{ 41.3858044991724, 46.5744133911931, 51.0805535247791, 55.2543110789866, 59.2247914653171, 63.0563794441286, 66.7864998639521, 70.4390680571508, 74.0303909114214, 77.5721273315703, 81.0729208137925, 84.5393657107271, 87.9766114811413, 91.388757598083, 94.7791211561736, 98.1504237865148 },
+	{ 42.4401364904578, 47.665677188749, 52.1997816559875, 56.3966354558056, 60.3869658090522, 64.2360183586064, 67.9817476826298, 71.6484258815206, 75.252615259361, 78.8061658158682, 82.3178688530439, 85.7944360532073, 89.2411119710934, 92.6620744802826, 96.0607062368376, 99.4397843603702 },
+	{ 43.4935239521172, 48.7554218404518, 53.3170978155714, 57.5367537091599, 61.5467047793507, 65.413039300071, 69.1742302264613, 72.8548987446007, 76.4718570770558, 80.0371422244786, 83.559690154734, 87.0463274161124, 90.5023916909645, 93.9321376575831, 97.3390122238883, 100.7258469123 },
+	{ 44.5460072445089, 49.8437099227168, 54.4325782583403, 58.6747512344893, 62.7041000218344, 66.5875381668093, 70.3640462014326, 74.0585870846777, 77.6882177197199, 81.2651582036969, 84.7984861721401, 88.2951406836958, 91.76055066366, 95.1990460647699, 98.6141367890553, 102.00870771734 },
+	{ 45.5976240264321, 50.9305999602115, 55.5462944463186, 59.8107082070369, 63.8592377259735, 67.7596052907427, 71.5512887226778, 75.2595857842693, 78.9017930635651, 82.4903100266578, 86.0343531112191, 89.540971632101, 93.0156839516634, 96.462893828741, 99.8861729508581, 103.288458552123 },
+	{ 46.6484094982857, 52.0161467794285, 56.6583134554301, 60.9447000132724, 65.012199064789, 68.9293258752548, 72.7360457440247, 76.4579845873545, 80.1126739082418, 83.7126889795659, 87.2673822999247, 90.7839112815525, 94.2678819922274, 97.7237705870537, 101.155209377016, 104.565186981759 },
+	{ 47.698396617993, 53.1004018238015, 57.7686983391136, 62.0767976377671, 66.1630605902391, 70.0967803899131, 73.9184004462, 77.6538684773256, 81.3209463422014, 84.9323817130794, 88.4976605248783, 92.0240462180335, 95.5172309040897, 98.9817617799245, 102.421330662124, 105.838976623672 },
+	{ 48.7476162933145, 54.1834134353344, 58.8775084542987, 63.2070680110015, 67.3118945896159, 71.2620449271493, 75.0984315884447, 78.847318020079, 82.5266920750607, 86.1494705626073, 89.7252703388491, 93.2614588876147, 96.7638127686083, 100.236948918331, 103.684617583021, 107.109907390634 },
+	{ 49.7960975536168, 55.2652271069799, 59.9847997543795, 64.3355743228046, 68.4587694075357, 72.4251915252729, 76.2762138276572, 80.0384096760875, 83.729988740535, 87.3640338408084, 90.9502903420702, 94.4962278662186, 98.0077058878738, 101.489409830563, 104.945147334001, 108.378055714935 },
+	{ 50.8438677037046, 56.3458857093798, 61.0906250531681, 65.4623763054765, 69.6037497374894, 73.5862884616134, 77.4518180086479, 81.2272160848063, 84.9309101730537, 88.5761461051812, 92.1727954400578, 95.7284281072749, 99.2489850220572, 102.739218889293, 106.202993743765, 109.64349475548 },
+	{ 51.8909524619441, 57.4254296950703, 62.195034263253, 66.5875304900902, 70.7468968863844, 74.7454005190895, 78.625311428631, 82.4138063243465, 86.1295266607969, 89.7858784032821, 93.392857080283, 96.9581311694384, 100.487721607996, 103.986447221023, 107.458227475834, 110.906294589342 },
+	{ 52.9373760845859, 58.5038972828193, 63.2980746117214, 67.7110904390055, 71.8882690150693, 75.9025892290844, 79.7967580786858, 83.5982461489877, 87.3259051775564, 90.9932984978135, 94.6105434697755, 98.185405426292, 101.723983960796, 105.231162899534, 108.710916213911, 112.166522389191 },
+	{ 53.9831614779283, 59.5813246243988, 64.3997908358104, 68.8331069572297, 73.0279213574424, 77.0579130931446, 80.9662188645879, 84.7805982067941, 88.5201095955443, 92.1984710735596, 95.8259197754982, 99.4103162597449, 102.957837460034, 106.473431124819, 109.961124833574, 113.424242587842 },
+};
+
+//
+// Bessel function of the first kind J_m(x) for m ≥ 0 and x ≥ 0 with Miller's backward recurrence
+// J_k-1(x) = 2k/x·J_k(x) − J_k+1(x) from far above max(m, x), normalized with the identity
+// J_0(x) + 2·Σ J_2k(x) = 1. Relative error about 1e-13 for m, x < 60.
+//
+inline double besselJ(int m, double x) {
+	if (x < 1e-12) return m == 0 ? 1 : 0;
+	const double top = std::max(double(m), x);
+	const int start = 2 * ((static_cast<int>(top + std::sqrt(40 * top)) + 16) / 2);
+	const double twoOverX = 2 / x;
+	double next = 0, current = 1e-30; // J_k+1, J_k up to a common factor
+	double result = 0, sum = 0;
+	for (int k = start; k > 0; k--) {
+		const double previous = k * twoOverX * current - next;
+		next = current;
+		current = previous;
+		if (std::abs(current) > 1e100) { // rescale to avoid overflow for small x
+			current *= 1e-100;
+			next *= 1e-100;
+			result *= 1e-100;
+			sum *= 1e-100;
+		}
+		if (k - 1 == m) result = current;
+		if (k > 1 && (k & 1)) sum += 2 * current; // J_k-1 with even k - 1 > 0
+	}
+	return result / (sum + current);
+}
+
+
 //template<typename T, int size>
 //struct CosTable {
 //	T values[size];
@@ -0,0 +1,186 @@
+﻿// -----------------------------------------------------------------------------------------------------------------------------
+// This file is part of the Überton project. Copyright (C) 2021 Überton
+//
+// Überton is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+// Überton is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details. You should
+// have received a copy of the GNU General Public License along with Überton. If not, see http://www.gnu.org/licenses/.
+// -----------------------------------------------------------------------------------------------------------------------------
+
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <chrono>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define UBERTON_SPIN_PAUSE() _mm_pause()
+#else
+#define UBERTON_SPIN_PAUSE() std::this_thread::yield()
+#endif
+
+namespace Uberton {
+
+namespace {
+
+// Best effort, pinning is not available on all platforms (i.e. macOS)
+void pinThread(std::thread& thread, int core) {
+#if defined(_WIN32)
+	SetThreadAffinityMask(thread.native_handle(), DWORD_PTR(1) << (core % (8 * sizeof(DWORD_PTR))));
+#elif defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(core % CPU_SETSIZE, &set);
+	pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#else
+	(void)thread;
+	(void)core;
+#endif
+}
+
+// Wait with progressive backoff until condition() is true, gives up (returns false) after
+// napping for about napTime so that the caller can block instead
+template<class Condition>
+bool waitUntil(Condition condition) {
+	constexpr int spinCount = 1 << 12;
+	constexpr int yieldCount = 1 << 10;
+	constexpr auto napTime = std::chrono::milliseconds(50); // longer than the period of an audio block
+	for (int i = 0; i < spinCount; i++) {
+		if (condition()) return true;
+		UBERTON_SPIN_PAUSE();
+	}
+	for (int i = 0; i < yieldCount; i++) {
+		if (condition()) return true;
+		std::this_thread::yield();
+	}
+	const auto end = std::chrono::steady_clock::now() + napTime;
+	while (!condition()) {
+		if (std::chrono::steady_clock::now() > end) return false;
+		std::this_thread::sleep_for(std::chrono::microseconds(50));
+	}
+	return true;
+}
+
+// Pools pin their workers to consecutive cores starting where the previous pool stopped, so
+// that several instances spread over the machine instead of all sharing the same cores
+std::atomic<int> nextCore{ 0 };
+
+}
+
+WorkerPool::WorkerPool(int numWorkers, bool pinThreads) {
+	threads.reserve(numWorkers);
+	const int cores = hardwareConcurrency();
+	const int firstCore = pinThreads && cores > 1 ? nextCore.fetch_add(numWorkers, std::memory_order_relaxed) : 0;
+	for (int i = 0; i < numWorkers; i++) {
+		threads.emplace_back(&WorkerPool::workerLoop, this, i);
+		if (pinThreads && cores > 1) {
+			pinThread(threads.back(), 1 + (firstCore + i) % (cores - 1)); // leave the first core to the calling thread
+		}
+	}
+}
+
+WorkerPool::~WorkerPool() {
+	stop.store(true, std::memory_order_release);
+	generation.fetch_add(1);
+	wakeSleepers();
+	for (auto& thread : threads) {
+		thread.join();
+	}
+}
+
+void WorkerPool::run(Job job, void* context) {
+	this->job = job;
+	this->context = context;
+	pending.store(numWorkers(), std::memory_order_relaxed);
+	generation.fetch_add(1); // publishes job and context
+	wakeSleepers();
+
+	job(context, numWorkers());
+
+	while (pending.load(std::memory_order_acquire) != 0) {
+		UBERTON_SPIN_PAUSE();
+	}
+}
+
+void WorkerPool::wakeSleepers() {
+	// A worker increments sleepers before it checks generation for the last time under the lock,
+	// so either it sees the new generation or we see it sleeping (both sequentially consistent).
+	// The lock is held by the worker only until it waits.
+	if (sleepers.load() == 0) return;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+	}
+	wakeUp.notify_all();
+}
+
+int WorkerPool::hardwareConcurrency() {
+	return std::max(1u, std::thread::hardware_concurrency());
+}
+
+BackgroundWorker::BackgroundWorker() : thread(&BackgroundWorker::workerLoop, this) {}
+
+BackgroundWorker::~BackgroundWorker() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stop = true;
+	}
+	wakeUp.notify_one();
+	thread.join();
+}
+
+bool BackgroundWorker::post(Job job, void* context) {
+	if (running.load(std::memory_order_acquire)) return false;
+	if (!mutex.try_lock()) return false;
+	this->job = job;
+	this->context = context;
+	running.store(true, std::memory_order_relaxed);
+	mutex.unlock();
+	wakeUp.notify_one();
+	return true;
+}
+
+void BackgroundWorker::wait() {
+	std::unique_lock<std::mutex> lock(mutex);
+	finished.wait(lock, [&] { return !running.load(std::memory_order_relaxed); });
+}
+
+void BackgroundWorker::workerLoop() {
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		wakeUp.wait(lock, [&] { return stop || running.load(std::memory_order_relaxed); });
+		if (stop) return;
+		lock.unlock();
+		job(context);
+		lock.lock();
+		running.store(false, std::memory_order_release);
+		finished.notify_all();
+	}
+}
+
+void WorkerPool::workerLoop(int index) {
+	unsigned seen = 0;
+	while (true) {
+		if (!waitUntil([&] { return generation.load(std::memory_order_acquire) != seen; })) {
+			std::unique_lock<std::mutex> lock(mutex);
+			sleepers.fetch_add(1);
+			wakeUp.wait(lock, [&] { return generation.load() != seen; });
+			sleepers.fetch_sub(1);
+		}
+		seen = generation.load(std::memory_order_acquire);
+		if (stop.load(std::memory_order_acquire)) return;
+
+		job(context, index);
+		pending.fetch_sub(1, std::memory_order_release);
+	}
+}
+
+}
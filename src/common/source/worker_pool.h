@@ -0,0 +1,121 @@
+﻿
+// Small pool of (optionally pinned) worker threads that process the same job in parallel,
+// synchronized by a lock-free start/finish barrier, and a background worker for jobs that
+// take longer than an audio block.
+//
+// -----------------------------------------------------------------------------------------------------------------------------
+// This file is part of the Überton project. Copyright (C) 2021 Überton
+//
+// Überton is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+// Überton is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details. You should
+// have received a copy of the GNU General Public License along with Überton. If not, see http://www.gnu.org/licenses/.
+// -----------------------------------------------------------------------------------------------------------------------------
+
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Uberton {
+
+// Usage example:
+//
+//   WorkerPool pool(3); // 3 workers + the calling thread
+//   pool.run([](void* context, int index) { ... }, &data); // index in [0, 3], 3 is the calling thread
+//
+// Idle workers spin for a short while before they start yielding and napping, so that a job issued
+// once per audio block starts without the latency of waking up a sleeping thread. After 50 ms
+// without a job (e.g. when the host stops processing) they block and use no CPU.
+//
+// Pinned workers are placed on the cores after the first one, each pool continuing where the
+// previous one stopped.
+//
+// run() is real-time safe (no allocations). It only takes a lock to wake up blocked workers,
+// which hold it just for the moment it takes them to go to sleep.
+class WorkerPool
+{
+public:
+	using Job = void (*)(void* context, int index);
+
+	explicit WorkerPool(int numWorkers, bool pinThreads = true);
+	~WorkerPool();
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	/// Number of worker threads (not counting the calling thread)
+	int numWorkers() const { return static_cast<int>(threads.size()); }
+
+	/// Call job(context, index) for each worker index and for index = numWorkers() on the
+	/// calling thread. Returns when all of them have finished.
+	void run(Job job, void* context);
+
+	/// Number of hardware threads (at least 1)
+	static int hardwareConcurrency();
+
+private:
+	void workerLoop(int index);
+	void wakeSleepers();
+
+	std::vector<std::thread> threads;
+
+	Job job{ nullptr };
+	void* context{ nullptr };
+	std::atomic<unsigned> generation{ 0 }; // incremented to start a job
+	std::atomic<int> pending{ 0 };		   // number of workers still running the current job
+	std::atomic<bool> stop{ false };
+
+	std::mutex mutex; // for blocked workers
+	std::condition_variable wakeUp;
+	std::atomic<int> sleepers{ 0 };
+};
+
+// A thread that runs one job at a time in the background, posted from the audio thread. The
+// result is picked up later by polling busy(), e.g. once per block.
+//
+// post() and busy() are real-time safe: posting only tries to lock the mutex the thread waits
+// on (it is held only for a moment while the thread goes to sleep) and gives up otherwise, so
+// that the job is posted again in the next block. The idle thread blocks on a condition
+// variable and uses no CPU.
+class BackgroundWorker
+{
+public:
+	using Job = void (*)(void* context);
+
+	BackgroundWorker();
+	~BackgroundWorker();
+
+	BackgroundWorker(const BackgroundWorker&) = delete;
+	BackgroundWorker& operator=(const BackgroundWorker&) = delete;
+
+	/// Start job(context) on the worker thread, returns false if the previous job is still
+	/// running or the thread could not be woken up without blocking (try again later).
+	bool post(Job job, void* context);
+
+	/// Whether the last posted job has not finished yet. Once it returns false, everything the
+	/// job wrote is visible to the calling thread.
+	bool busy() const { return running.load(std::memory_order_acquire); }
+
+	/// Block until the last posted job has finished (not real-time safe)
+	void wait();
+
+private:
+	void workerLoop();
+
+	std::mutex mutex;
+	std::condition_variable wakeUp;
+	std::condition_variable finished;
+	Job job{ nullptr };
+	void* context{ nullptr };
+	std::atomic<bool> running{ false };
+	bool stop{ false };
+	std::thread thread; // last, started when everything else is initialized
+};
+
+}
@@ -52,8 +52,17 @@ tresult PLUGIN_API ResonatorController::initialize(FUnknown* context) {
 		parameters.addParameter(new GainParameter("Output Level L", ParamSpecs::vuPPML.id, "dB", 0, ParameterInfo::kIsReadOnly, rootUnitId, "Level", vuPPMOverheadDB));
 		parameters.addParameter(new GainParameter("Output Level R", ParamSpecs::vuPPMR.id, "dB", 0, ParameterInfo::kIsReadOnly, rootUnitId, "Level", vuPPMOverheadDB));
 		addParam<LinearParameter>(ParamSpecs::processTime, "Process Time", "T", "", Precision(6), ParameterInfo::kIsReadOnly);
+		addParam<LinearParameter>(ParamSpecs::positionUpdates, "Position Updates", "Pos Upd", "%", Precision(0), ParameterInfo::kIsReadOnly);
 
 		addStringListParam(ParamSpecs::limiterOn, "Output Limiter", "Out Lim", { "Off", "On" });
+		addStringListParam(ParamSpecs::monoExcitation, "Excitation", "Exc", { "Stereo", "Mono" });
+		addParam<LinearParameter>(ParamSpecs::cpuBudget, "CPU Budget", "CPU", "%", Precision(0));
+		addParam<LogParameter>(ParamSpecs::inModRate, "Input Pos Mod Rate", "InMod Rate", "Hz", Precision(2));
+		addParam<LinearParameter>(ParamSpecs::inModDepth, "Input Pos Mod Depth", "InMod Dpt", "", Precision(3));
+		addParam<LinearParameter>(ParamSpecs::inModEnv, "Input Pos Mod Envelope", "InMod Env", "", Precision(3));
+		addParam<LogParameter>(ParamSpecs::outModRate, "Output Pos Mod Rate", "OutMod Rate", "Hz", Precision(2));
+		addParam<LinearParameter>(ParamSpecs::outModDepth, "Output Pos Mod Depth", "OutMod Dpt", "", Precision(3));
+		addParam<LinearParameter>(ParamSpecs::outModEnv, "Output Pos Mod Envelope", "OutMod Env", "", Precision(3));
 		addParam<LinearParameter>(ParamSpecs::resonatorLength, "Resonator Length", "Res Len", "m", Precision(3), ParameterInfo::kIsReadOnly);
 	}
 
@@ -0,0 +1,431 @@
+// -----------------------------------------------------------------------------------------------------------------------------
+// This file is part of the berton project. Copyright (C) 2021 berton
+//
+// berton is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+// berton is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details. You should
+// have received a copy of the GNU General Public License along with berton. If not, see http://www.gnu.org/licenses/.
+// -----------------------------------------------------------------------------------------------------------------------------
+
+
+#pragma once
+
+#include <convolution.h>
+#include <simd.h>
+#include <worker_pool.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+
+namespace Uberton {
+namespace ResonatorPlugin {
+
+// Alternative engine for the modal resonator bank of ProcessorImpl.
+//
+// As long as positions, frequency, damping and velocity do not change, the resonator is a linear
+// time-invariant system. Its impulse response from input channel "in" to output channel "out" is
+//
+//     h[m] = Re( sum_i inputPosEF[in][i] * outputPosEF[out][i] * timeFunctions[i]^(m+1) ).
+//
+// When the parameters have been stable for a while, the impulse responses are rendered and loaded
+// into a partitioned convolver by a background thread, so the audio thread pays nothing for it.
+// Once complete, new input is only fed to the convolver while the modal bank keeps ringing out
+// what it already contains, so the switch is seamless. After that tail has decayed, the modal
+// bank is cleared and not computed anymore.
+//
+// When the parameters change again, the modal bank takes over the input and the convolver rings
+// out with zero input (hand back). Meanwhile the background thread computes the modal state the
+// input fed to the convolver has left behind, by running the modal bank of the rendered
+// parameters over the recorded input, and advances it to a time a little ahead of the audio
+// thread. At that sample the state is added to the modal bank and the convolver is stopped, so
+// the tail continues in the modal bank (and follows further parameter changes) without a
+// discontinuity. If the background thread is too late, the convolver just rings out completely.
+//
+// The convolver is only used if its worst-case cost per block is estimated to be lower than the
+// cost of the modal bank (high orders with moderate decay times) and the impulse response decays
+// by 80 dB within maxLength samples. Both costs are estimated in seconds from a calibration on the
+// first init(), since the modal bank runs on the SIMD kernels and the convolver is scalar code.
+template<class Resonator, typename SampleType, int numChannels>
+class ResonatorConvolutionEngine
+{
+public:
+	using Frame = std::array<SampleType, numChannels>;
+	using Convolver = Math::PartitionedConvolver<SampleType, numChannels>;
+	using complex = std::complex<double>;
+	using scalar = std::complex<SampleType>;
+
+	static constexpr int maxLength = 1 << 18;
+	static constexpr int numPaths = Convolver::numPaths;
+	static constexpr double stableTime = .5;		// in seconds, before the impulse response is rendered
+	static constexpr double handBackMargin = .05;	// in seconds, how far the hand back is scheduled ahead
+	static constexpr double truncationLevel = 1e-4; // -80 dB
+
+	enum class Mode {
+		Modal,
+		Rendering,
+		Convolving,
+		HandingBack
+	};
+
+	~ResonatorConvolutionEngine() {
+		if (worker) {
+			cancelled.store(true, std::memory_order_relaxed);
+			worker.reset(); // waits for the job
+		}
+	}
+
+	// Allocates and starts the background thread, call from setupProcessing()/setActive()
+	void init(float sampleRate) {
+		calibration(); // measured once, not on the audio thread
+		if (worker) {
+			cancelled.store(true, std::memory_order_relaxed);
+			worker->wait();
+		}
+		else {
+			worker = std::make_unique<BackgroundWorker>();
+		}
+		convolver.prepare(maxLength);
+		phasors.resize(Resonator::maxOrder());
+		timeFunctions.resize(Resonator::maxOrder());
+		for (auto& c : coefficients) {
+			c.resize(Resonator::maxOrder());
+		}
+		evolution.resize(Resonator::maxOrder());
+		handBackState.resize(Resonator::maxOrder());
+		for (int ch = 0; ch < numChannels; ch++) {
+			inputEF[ch].resize(Resonator::maxOrder());
+			inputHistory[ch].assign(maxLength, SampleType(0));
+		}
+		stableSamplesNeeded = static_cast<int>(stableTime * sampleRate);
+		handBackMarginSamples = static_cast<int>(handBackMargin * sampleRate);
+		mode = Mode::Modal;
+		stableSamples = 0;
+		attempted = false;
+	}
+
+	// Call whenever the resonator changes in a way that changes its impulse response
+	void invalidate() {
+		stableSamples = 0;
+		attempted = false;
+		if (mode == Mode::Rendering) {
+			cancelled.store(true, std::memory_order_relaxed);
+			mode = Mode::Modal;
+		}
+		else if (mode == Mode::Convolving) {
+			mode = Mode::HandingBack;
+			modalTail = false;
+			handBackSamples = 0;
+			handBackTarget = -1;
+			handBackPosted = false;
+			handBackInputs = std::min<int64_t>(historyCount, convolver.length());
+		}
+	}
+
+	// Call once per block before process(). The modal tail is cleared once its output is bound to be
+	// below tailThreshold.
+	void beginBlock(Resonator& resonator, int numSamples, SampleType tailThreshold) {
+		switch (mode) {
+		case Mode::Modal:
+			if (stableSamples < stableSamplesNeeded) {
+				stableSamples += numSamples;
+			}
+			else if (!attempted && !worker->busy()) {
+				startRendering(resonator, numSamples);
+			}
+			break;
+		case Mode::Rendering:
+			if (!worker->busy()) {
+				modalTail = true;
+				historyCount = 0;
+				mode = convolver.isComplete() ? Mode::Convolving : Mode::Modal;
+			}
+			break;
+		case Mode::Convolving:
+			if (modalTail && tailMagnitude(resonator) < tailThreshold) {
+				resonator.clear();
+				modalTail = false;
+			}
+			break;
+		case Mode::HandingBack:
+			// the background thread schedules the hand back after the end of the next block
+			handBackHorizon.store(handBackSamples + 2 * int64_t(numSamples), std::memory_order_relaxed);
+			if (!handBackPosted) {
+				cancelled.store(false, std::memory_order_relaxed);
+				handBackPosted = worker->post(&ResonatorConvolutionEngine::handBackJob, this);
+			}
+			else if (handBackTarget < 0 && !worker->busy()) {
+				// too late (or cancelled): the convolver rings out completely instead
+				handBackTarget = handBackAt >= handBackSamples ? handBackAt : std::numeric_limits<int64_t>::max();
+			}
+			break;
+		}
+	}
+
+	// Replaces resonator.delta(input) followed by resonator.next()
+	Frame process(Resonator& resonator, const Frame& input) {
+		return process(resonator, input, [&] { resonator.delta(input); });
+	}
+
+	// Replaces resonator.deltaMono(input) followed by resonator.next()
+	Frame processMono(Resonator& resonator, SampleType input) {
+		Frame frame;
+		frame.fill(input);
+		return process(resonator, frame, [&] { resonator.deltaMono(input); });
+	}
+
+	Mode getMode() const { return mode; }
+
+	// Measured processing times on this machine
+	struct Calibration
+	{
+		double secondsPerModeSample{ 0 };	 // modal bank, one mode for one sample
+		double secondsPerConvolverFlop{ 0 }; // convolver, per flop as estimated by PartitionedConvolver
+	};
+
+	// Measured on the first call (takes a few milliseconds)
+	static const Calibration& calibration() {
+		static const Calibration result = calibrate();
+		return result;
+	}
+
+private:
+	template<class Excite>
+	Frame process(Resonator& resonator, const Frame& input, Excite excite) {
+		switch (mode) {
+		case Mode::Convolving: {
+			const int pos = static_cast<int>(historyCount++ & (maxLength - 1));
+			for (int ch = 0; ch < numChannels; ch++) {
+				inputHistory[ch][pos] = input[ch];
+			}
+			Frame result = convolver.process(input);
+			if (modalTail) {
+				const auto tail = resonator.next();
+				for (int ch = 0; ch < numChannels; ch++) {
+					result[ch] += tail[ch];
+				}
+			}
+			return result;
+		}
+		case Mode::HandingBack: {
+			if (handBackSamples == handBackTarget) {
+				// the rest of the convolver output continues in the modal bank
+				resonator.strike(handBackState.data(), 1);
+				mode = Mode::Modal;
+				excite();
+				return resonator.next();
+			}
+			excite();
+			const auto modal = resonator.next();
+			const Frame convolved = convolver.process(Frame{});
+			Frame result;
+			for (int ch = 0; ch < numChannels; ch++) {
+				result[ch] = modal[ch] + convolved[ch];
+			}
+			// the convolver output is zero after the impulse response length
+			if (++handBackSamples >= convolver.length()) mode = Mode::Modal;
+			return result;
+		}
+		default:
+			excite();
+			return resonator.next();
+		}
+	}
+
+	void startRendering(Resonator& resonator, int blockSize) {
+		attempted = true;
+		const double decay = double(resonator.b) * double(resonator.deltaT); // per sample, same for all modes
+		if (!(decay > 0)) return;
+		const double length = std::ceil(-std::log(truncationLevel) / decay);
+		if (length > maxLength) return;
+		// the modal bank costs the same for every block, the convolver has to be cheaper in its worst block
+		const Calibration& cost = calibration();
+		const double modalTime = double(blockSize) * resonator.order() * cost.secondsPerModeSample;
+		const double convolverTime = Convolver::peakFlopsPerBlock(static_cast<int>(length), blockSize) * cost.secondsPerConvolverFlop;
+		if (convolverTime > .75 * modalTime) return;
+
+		order = resonator.order();
+		irLength = static_cast<int>(length);
+		for (int i = 0; i < order; i++) {
+			timeFunctions[i] = complex(resonator.timeFunctions[i]);
+			evolution[i] = resonator.timeFunctions[i];
+			for (int in = 0; in < numChannels; in++) {
+				inputEF[in][i] = resonator.inputPosEF[in][i];
+			}
+			for (int out = 0; out < numChannels; out++) {
+				for (int in = 0; in < numChannels; in++) {
+					coefficients[out * numChannels + in][i] = complex(resonator.inputPosEF[in][i]) * complex(resonator.outputPosEF[out][i]);
+				}
+			}
+		}
+		cancelled.store(false, std::memory_order_relaxed);
+		if (worker->post(&ResonatorConvolutionEngine::renderJob, this)) {
+			mode = Mode::Rendering;
+		}
+		else {
+			attempted = false; // try again in the next block
+		}
+	}
+
+	// Time the per sample step of a modal bank (all inputs and outputs) and the convolver with a
+	// typical impulse response, the fastest of a few runs counts
+	static Calibration calibrate() {
+		using Clock = std::chrono::steady_clock;
+		constexpr int runs = 3;
+		constexpr int modes = 1024, modalSamples = 1024;
+		constexpr int irLength = 1 << 14, convolverSamples = 1 << 13;
+		Calibration result{ std::numeric_limits<double>::max(), std::numeric_limits<double>::max() };
+
+		const auto& kernels = Simd::kernels<SampleType>();
+		std::vector<scalar> amplitudes(modes), evolution(modes, std::polar(SampleType(.9999), SampleType(.01)));
+		std::vector<scalar> eigenfunction(modes, scalar(.5, .25));
+		std::array<const scalar*, numChannels> e, o;
+		std::array<SampleType, numChannels> x, y;
+		e.fill(eigenfunction.data());
+		o.fill(eigenfunction.data());
+		x.fill(SampleType(1e-3));
+		for (int run = 0; run < runs; run++) {
+			const auto t0 = Clock::now();
+			for (int i = 0; i < modalSamples; i++) {
+				kernels.step(amplitudes.data(), evolution.data(), e.data(), x.data(), numChannels, o.data(), y.data(), numChannels, modes);
+			}
+			const double time = std::chrono::duration<double>(Clock::now() - t0).count();
+			result.secondsPerModeSample = std::min(result.secondsPerModeSample, time / (double(modes) * modalSamples));
+		}
+
+		Convolver convolver;
+		convolver.prepare(irLength);
+		convolver.beginImpulseResponse(irLength);
+		typename Convolver::PathFrame h;
+		for (int m = 0; m < irLength; m++) {
+			h.fill(static_cast<SampleType>(std::exp(-1e-3 * m) * std::cos(.1 * m)));
+			convolver.appendImpulseResponse(h);
+		}
+		Frame input;
+		input.fill(SampleType(1e-3));
+		for (int run = 0; run < runs; run++) {
+			const auto t0 = Clock::now();
+			for (int i = 0; i < convolverSamples; i++) {
+				convolver.process(input);
+			}
+			const double time = std::chrono::duration<double>(Clock::now() - t0).count();
+			result.secondsPerConvolverFlop = std::min(result.secondsPerConvolverFlop, time / (convolverSamples * Convolver::flopsPerSample(irLength)));
+		}
+		return result;
+	}
+
+	// Background thread
+	static void renderJob(void* context) {
+		static_cast<ResonatorConvolutionEngine*>(context)->renderImpulseResponse();
+	}
+
+	// Background thread
+	void renderImpulseResponse() {
+		convolver.beginImpulseResponse(irLength);
+		for (int i = 0; i < order; i++) {
+			phasors[i] = 1;
+		}
+		typename Convolver::PathFrame h;
+		for (int m = 0; m < irLength; m++) {
+			if ((m & 1023) == 0 && cancelled.load(std::memory_order_relaxed)) return;
+			for (int i = 0; i < order; i++) {
+				const complex w = phasors[i];
+				const complex t = timeFunctions[i];
+				phasors[i] = complex(w.real() * t.real() - w.imag() * t.imag(), w.real() * t.imag() + w.imag() * t.real());
+			}
+			for (int path = 0; path < numPaths; path++) {
+				const complex* c = coefficients[path].data();
+				double sum = 0;
+				for (int i = 0; i < order; i++) {
+					sum += c[i].real() * phasors[i].real() - c[i].imag() * phasors[i].imag();
+				}
+				h[path] = static_cast<SampleType>(sum);
+			}
+			convolver.appendImpulseResponse(h);
+		}
+	}
+
+	// Background thread
+	static void handBackJob(void* context) {
+		static_cast<ResonatorConvolutionEngine*>(context)->computeHandBackState();
+	}
+
+	// Background thread. The modal bank of the rendered parameters run over the input that was fed to
+	// the convolver (the impulse response length is all that is still audible) and advanced to the
+	// hand back time.
+	void computeHandBackState() {
+		handBackAt = -1;
+		const auto& kernels = Simd::kernels<SampleType>();
+		scalar* state = handBackState.data();
+		std::fill(handBackState.begin(), handBackState.end(), scalar(0));
+		for (int64_t k = handBackInputs; k > 0; k--) {
+			if ((k & 1023) == 0 && cancelled.load(std::memory_order_relaxed)) return;
+			const int pos = static_cast<int>((historyCount - k) & (maxLength - 1));
+			for (int ch = 0; ch < numChannels; ch++) {
+				const SampleType x = inputHistory[ch][pos];
+				if (x != 0) kernels.accumulate(state, inputEF[ch].data(), x, order);
+			}
+			kernels.rotate(state, evolution.data(), order);
+		}
+		// state after the last input, the hand back takes place before sample target
+		const int64_t target = handBackHorizon.load(std::memory_order_relaxed) + handBackMarginSamples;
+		for (int i = 0; i < order; i++) {
+			state[i] = scalar(complex(state[i]) * std::pow(timeFunctions[i], double(target)));
+		}
+		handBackAt = target;
+	}
+
+	// Upper bound for the output magnitude of the modal bank
+	static SampleType tailMagnitude(const Resonator& resonator) {
+		SampleType sum = 0;
+		for (int i = 0; i < resonator.nOrder; i++) {
+			SampleType ef = 0;
+			for (int ch = 0; ch < numChannels; ch++) {
+				ef = std::max(ef, std::abs(resonator.outputPosEF[ch][i]));
+			}
+			sum += std::abs(resonator.amplitudes[i]) * ef;
+		}
+		return sum;
+	}
+
+	Convolver convolver;
+	Mode mode{ Mode::Modal };
+	bool modalTail{ false }; // modal bank still ringing out while convolving
+	bool attempted{ false }; // switching has been considered since the last change
+	int stableSamples{ 0 };
+	int stableSamplesNeeded{ 0 };
+
+	// impulse response rendering state (written by the audio thread while the worker is idle)
+	int order{ 0 };
+	int irLength{ 0 };
+	std::vector<complex> phasors;
+	std::vector<complex> timeFunctions;
+	std::array<std::vector<complex>, numPaths> coefficients;
+	std::vector<scalar> evolution; // timeFunctions in the precision of the modal bank
+	std::array<std::vector<scalar>, numChannels> inputEF;
+
+	// hand back state
+	std::array<std::vector<SampleType>, numChannels> inputHistory; // input fed to the convolver (ring buffer)
+	int64_t historyCount{ 0 };
+	int64_t handBackInputs{ 0 };  // number of recorded inputs that are used
+	int64_t handBackSamples{ 0 }; // samples processed since the hand back started
+	int64_t handBackTarget{ -1 }; // sample of the hand back, -1 until it is known
+	int64_t handBackAt{ -1 };	  // written by the background thread
+	int handBackMarginSamples{ 0 };
+	bool handBackPosted{ false };
+	std::vector<scalar> handBackState;
+	std::atomic<int64_t> handBackHorizon{ 0 };
+
+	std::atomic<bool> cancelled{ false };
+	std::unique_ptr<BackgroundWorker> worker; // last, destroyed first
+};
+
+}
+}
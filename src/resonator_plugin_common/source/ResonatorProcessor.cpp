@@ -11,6 +11,7 @@
 
 #include "ResonatorProcessor.h"
 #include <public.sdk/source/vst/vstaudioprocessoralgo.h>
+#include <algorithm>
 #include <chrono>
 
 namespace Uberton {
@@ -43,6 +44,14 @@ ResonatorProcessorBase::ResonatorProcessorBase() {
 	initValue(ParamSpecs::hcFreq);
 	initValue(ParamSpecs::hcQ);
 	initValue(ParamSpecs::limiterOn);
+	initValue(ParamSpecs::monoExcitation);
+	initValue(ParamSpecs::cpuBudget);
+	initValue(ParamSpecs::inModRate);
+	initValue(ParamSpecs::inModDepth);
+	initValue(ParamSpecs::inModEnv);
+	initValue(ParamSpecs::outModRate);
+	initValue(ParamSpecs::outModDepth);
+	initValue(ParamSpecs::outModEnv);
 }
 
 tresult PLUGIN_API ResonatorProcessorBase::initialize(FUnknown* context) {
@@ -51,15 +60,21 @@ tresult PLUGIN_API ResonatorProcessorBase::initialize(FUnknown* context) {
 		return kResultFalse;
 
 	addAudioInput(STR16("AudioInput"), SpeakerArr::kStereo);
+	addAudioInput(STR16("Sidechain"), SpeakerArr::kStereo, kAux, 0); // excites the resonator instead of the main input when active
 	addAudioOutput(STR16("AudioOutput"), SpeakerArr::kStereo);
 
 	return kResultTrue;
 }
 
 tresult PLUGIN_API ResonatorProcessorBase::setBusArrangements(SpeakerArrangement* inputs, int32 numIns, SpeakerArrangement* outputs, int32 numOuts) {
-	// Only support stereo in/stereo out
-	if (numIns == 1 && numOuts == 1 && inputs[0] == SpeakerArr::kStereo && inputs[0] == outputs[0]) {
-		return ProcessorBase::setBusArrangements(inputs, numIns, outputs, numOuts);
+	// Only support equal in/out arrangements with 2 to 16 channels (stereo, surround, multi-mono...)
+	// and an optional mono or stereo sidechain
+	if ((numIns == 1 || numIns == 2) && numOuts == 1 && inputs[0] == outputs[0]) {
+		const int32 numChannels = SpeakerArr::getChannelCount(outputs[0]);
+		const int32 numSidechainChannels = numIns == 2 ? SpeakerArr::getChannelCount(inputs[1]) : 1;
+		if (numChannels >= 2 && numChannels <= maxOutputChannels && numSidechainChannels >= 1 && numSidechainChannels <= 2) {
+			return ProcessorBase::setBusArrangements(inputs, numIns, outputs, numOuts);
+		}
 	}
 	return kResultFalse;
 }
@@ -75,9 +90,15 @@ void ResonatorProcessorBase::processAudio(ProcessData& data) {
 	//auto t0 = steady_clock::now();
 
 
+	state.sidechainActive = data.numInputs > 1 && data.inputs[1].numChannels > 0 && getAudioInput(1)->isActive();
+
 	// Handle silence flags
 	{
-		if (data.inputs[0].silenceFlags != 0 && vuPPM < 0.0001) {
+		auto isSilent = [](const AudioBusBuffers& bus) {
+			return bus.silenceFlags == (uint64(1) << bus.numChannels) - 1;
+		};
+		const bool excitationSilent = isSilent(data.inputs[0]) && !(state.sidechainActive && !isSilent(data.inputs[1]));
+		if (excitationSilent && vuPPM < 0.0001) {
 			data.outputs[0].silenceFlags = data.inputs[0].silenceFlags;
 
 			uint32 sampleFramesSize = getSampleFramesSizeInBytes(processSetup, data.numSamples);
@@ -95,12 +116,28 @@ void ResonatorProcessorBase::processAudio(ProcessData& data) {
 	}
 
 	vuPPM = processorImpl->processAll(data, state);
+	reportPositionUpdateStats(data);
 
 	//std::chrono::duration<double> duration = steady_clock::now() - t0;
 	//addOutputPoint(data, kParamProcessTime, (duration.count() / data.numSamples) * 1000.0 / 10.0);
 }
 
+void ResonatorProcessorBase::reportPositionUpdateStats(ProcessData& data) {
+	// only sent when new changes arrived, most blocks have none
+	const PositionUpdateStats& stats = positionUpdateStats;
+	const uint64 changes = stats.inputChanges + stats.outputChanges;
+	if (changes == reportedPositionChanges) return;
+	reportedPositionChanges = changes;
+	const double updates = double(stats.inputUpdates + stats.outputUpdates);
+	addOutputPoint(data, kParamPositionUpdates, ParamSpecs::positionUpdates.toNormalized(std::min(100.0, 100 * updates / changes)));
+}
+
 void ResonatorProcessorBase::processParameterChanges(IParameterChanges* inputParameterChanges) {
+	// Position and dimension changes are only marked here and applied once after all queues have
+	// been read, automating all coordinates would otherwise reevaluate the eigenfunctions each time.
+	bool inputPositionChanged = false;
+	bool outputPositionChanged = false;
+	bool dimensionChanged = false;
 	Algo::foreach (inputParameterChanges, [&](IParamValueQueue& paramQueue) {
 		// Just process the latest parameter change and apply it immediately (ignoring sampleOffset)
 		// For sample-accurate automation this needs to be more precise.
@@ -111,18 +148,35 @@ void ResonatorProcessorBase::processParameterChanges(IParameterChanges* inputPar
 				paramState[id] = value;
 			}
 			if (id == Params::kParamInPosCurveL || id == Params::kParamInPosCurveR || (id >= Params::kParamInL0 && id <= Params::kParamInRN)) {
-				processorImpl->updateResonatorInputPosition(paramState);
+				inputPositionChanged = true;
+				++positionUpdateStats.inputChanges;
 			}
 			if (id == Params::kParamOutPosCurveL || id == Params::kParamOutPosCurveR || (id >= Params::kParamOutL0 && id <= Params::kParamOutRN)) {
-				processorImpl->updateResonatorOutputPosition(paramState);
+				outputPositionChanged = true;
+				++positionUpdateStats.outputChanges;
 			}
 			if (id == Params::kParamResonatorDim) {
-				updateResonatorDimension();
+				dimensionChanged = true;
 			}
 		}
 
 		);
 	});
+	if (dimensionChanged) {
+		updateResonatorDimension(); // updates both positions
+		++positionUpdateStats.inputUpdates;
+		++positionUpdateStats.outputUpdates;
+	}
+	else {
+		if (inputPositionChanged) {
+			processorImpl->updateResonatorInputPosition(paramState);
+			++positionUpdateStats.inputUpdates;
+		}
+		if (outputPositionChanged) {
+			processorImpl->updateResonatorOutputPosition(paramState);
+			++positionUpdateStats.outputUpdates;
+		}
+	}
 	if (inputParameterChanges && inputParameterChanges->getParameterCount() > 0)
 		recomputeInexpensiveParameters();
 }
@@ -146,6 +200,14 @@ void ResonatorProcessorBase::recomputeInexpensiveParameters() {
 	state.resonatorDamp = toScaled(ParamSpecs::resonatorDamp);
 	state.resonatorVel = toScaled(ParamSpecs::resonatorVel);
 	state.limiterOn = paramState[Params::kParamLimiterOn] != 0;
+	state.monoExcitation = paramState[Params::kParamMonoExcitation] != 0;
+	state.cpuBudget = toScaled(ParamSpecs::cpuBudget) / 100;
+	state.inModRate = toScaled(ParamSpecs::inModRate);
+	state.inModDepth = toScaled(ParamSpecs::inModDepth);
+	state.inModEnv = toScaled(ParamSpecs::inModEnv);
+	state.outModRate = toScaled(ParamSpecs::outModRate);
+	state.outModDepth = toScaled(ParamSpecs::outModDepth);
+	state.outModEnv = toScaled(ParamSpecs::outModEnv);
 	state.lcFreqNormalized = paramState[Params::kParamLCFreq];
 	state.hcFreqNormalized = paramState[Params::kParamHCFreq];
 	state.lcQ = toScaled(ParamSpecs::lcQ);
@@ -32,6 +32,18 @@ public:
 	void processParameterChanges(IParameterChanges* parameterChanges) override;
 	void beforeBypass(ProcessData& data) override;
 
+	// Number of position changes received from the host and of position updates actually done
+	// (at most one per side and block), the difference is what coalescing saved.
+	struct PositionUpdateStats
+	{
+		uint64 inputChanges{ 0 };
+		uint64 inputUpdates{ 0 };
+		uint64 outputChanges{ 0 };
+		uint64 outputUpdates{ 0 };
+	};
+	const PositionUpdateStats& getPositionUpdateStats() const { return positionUpdateStats; }
+	void reportPositionUpdateStats(ProcessData& data);
+
 
 protected:
 	// Inexpensive parameter udpates
@@ -50,6 +62,9 @@ protected:
 	State state; // Scaled parameters stored here
 
 	double vuPPM = 0; // contains max of left and right channel from last buffer to check if there is silence
+
+	PositionUpdateStats positionUpdateStats;
+	uint64 reportedPositionChanges{ 0 }; // changes at the last output of kParamPositionUpdates
 };
 
 }
@@ -12,7 +12,14 @@
 #pragma once
 
 #include "ResonatorProcessorImplBase.h"
+#include "ResonatorConvolutionEngine.h"
+#include <eigenfunction_cache.h>
+#include <pickups.h>
+#include <position_modulation.h>
 #include <processor_utilities.h>
+#include <simd.h>
+#include <chrono>
+#include <utility>
 
 
 namespace Uberton {
@@ -34,9 +41,9 @@ public:
 	using PositionVecArr = std::array<SpaceVec, numChannels>;
 
 	using Filter = Steinberg::Vst::NoteExpressionSynth::Filter;
+	using EigenFunctionCache = Math::EigenFunctionCache<SampleType, maxDimension, Resonator::maxOrder()>;
 
 
-	static_assert(numChannels == Resonator::numChannels());
 	static_assert(numChannels == Resonator::numChannels());
 
 	void init(float sampleRate) override {
@@ -49,28 +56,37 @@ public:
 		}
 
 		resonator.setSampleRate(sampleRate);
+		convolutionEngine.init(sampleRate);
+		inputModulator.setSampleRate(sampleRate);
+		outputModulator.setSampleRate(sampleRate);
 	}
 
 	void setResonatorDim(int resonatorDim) override {
 		if (resonatorDim != resonator.getDim()) {
 			resonator.setDim(resonatorDim);
 			resonator.setFreqDampeningAndVelocity(currentResFreq, currentResDamp, currentResVel); // need to update this when resonatorDim changed
+			resonatorFreqChanged = false;
 			updateCompensation();
+			resonatorChanged();
+			inputModulator.setDimension(resonator.getDim());
+			outputModulator.setDimension(resonator.getDim());
 		}
 	}
 
 	void setResonatorOrder(int resonatorOrder) override {
-		resonator.setOrder(resonatorOrder);
 		currentResonatorOrder = resonatorOrder;
+		applyOrder();
 		updateCompensation();
 	}
 
 	void setResonatorFreq(float freq, float damp, float vel) override {
 		if (freq != currentResFreq || damp != currentResDamp || vel != currentResVel) {
-			resonator.setFreqDampeningAndVelocity(freq, damp, vel);
+			// applied in processAll() as a glide over the block
+			resonatorFreqChanged = true;
 			currentResFreq = freq;
 			currentResDamp = damp;
 			currentResVel = vel;
+			resonatorChanged();
 		}
 	}
 
@@ -92,12 +108,24 @@ public:
 
 	// returns the max sample of the output buffer
 	float processAll(ProcessData& data, const State& state) final {
+		const auto startTime = std::chrono::steady_clock::now();
 		const int32 numSamples = data.numSamples;
 		const bool limiterOn = state.limiterOn;
 
 		SampleType** in = (SampleType**)data.inputs[0].channelBuffers32;
 		SampleType** out = (SampleType**)data.outputs[0].channelBuffers32;
+		const int numOutputs = std::clamp<int>(data.outputs[0].numChannels, numChannels, maxOutputChannels);
+		const bool multichannel = numOutputs > numChannels;
+		if (numOutputs != currentNumOutputs) {
+			setNumOutputs(numOutputs, state);
+		}
 
+		// The resonator is excited from the sidechain if it is active, otherwise from the main input
+		const AudioBusBuffers& excitationBus = state.sidechainActive ? data.inputs[1] : data.inputs[0];
+		SampleType** excitation = (SampleType**)excitationBus.channelBuffers32;
+		const int numExcitationChannels = excitationBus.numChannels;
+		const SampleType monoGain = SampleType(1) / numExcitationChannels;
+		const bool mono = state.monoExcitation;
 
 		// Ramping
 		using ProcessorUtilities::getRamp;
@@ -122,11 +150,41 @@ public:
 		SampleType lcRamp = getRamp(currentLCFreqNormalized, SampleType(state.lcFreqNormalized), rampTime_inv);
 		SampleType hcRamp = getRamp(currentHCFreqNormalized, SampleType(state.hcFreqNormalized), rampTime_inv);
 
+		// Position modulation, the resonator is time variant then and the convolution engine stays off
+		inputModulator.setLFO(SampleType(state.inModRate), SampleType(state.inModDepth));
+		inputModulator.setEnvelopeDepth(SampleType(state.inModEnv));
+		outputModulator.setLFO(SampleType(state.outModRate), SampleType(state.outModDepth));
+		outputModulator.setEnvelopeDepth(SampleType(state.outModEnv));
+		const bool inputModulated = inputModulator.active();
+		const bool outputModulated = outputModulator.active();
+		if (inputModulated || outputModulated) {
+			resonatorChanged();
+		}
+		if (!inputModulated && inputWasModulated) {
+			resonator.setInputPositions(currentInputPositions, eigenFunctionCache);
+		}
+		if (!outputModulated && outputWasModulated) {
+			applyOutputPositions(currentOutputPositions, true);
+		}
+		inputWasModulated = inputModulated;
+		outputWasModulated = outputModulated;
+
 		// Temporaries
 		std::array<SampleType, numChannels> input;
 		SampleVec tmp;
-		SampleType maxSampleLSq = 0;
-		SampleType maxSampleRSq = 0;
+		std::array<SampleType, maxOutputChannels> wet;
+
+		// Frequency, dampening and velocity changes glide over the block instead of stepping at
+		// its start which would be audible as zipper noise with automation.
+		if (resonatorFreqChanged) {
+			resonator.glideFreqDampeningAndVelocity(currentResFreq, currentResDamp, currentResVel, numSamples);
+			resonatorFreqChanged = false;
+		}
+
+		// modal tail is cleared by the convolution engine when it falls below -120 dB
+		if (!multichannel) {
+			convolutionEngine.beginBlock(resonator, numSamples, SampleType(1e-6) / volumeCompensation);
+		}
 
 		for (int32 i = 0; i < numSamples; i++) {
 			const SampleType dry = 1. - currentWet;
@@ -139,38 +197,73 @@ public:
 					if constexpr (numChannels > 1) {
 						currentInputPositions[1] += inputDiff[1];
 					}
-					resonator.setInputPositions(currentInputPositions);
+					if (!inputModulated) {
+						resonator.setInputPositions(currentInputPositions);
+					}
 				}
 				if (outCurveChanged) {
 					currentOutputPositions[0] += outputDiff[0];
 					if constexpr (numChannels > 1) {
 						currentOutputPositions[1] += outputDiff[1];
 					}
-					resonator.setOutputPositions(currentOutputPositions);
+					if (!outputModulated) {
+						applyOutputPositions(currentOutputPositions);
+					}
+				}
+			}
+			SampleType monoInput = 0;
+			if (mono) {
+				for (int ch = 0; ch < numExcitationChannels; ch++) {
+					monoInput += *(excitation[ch] + i);
 				}
+				monoInput *= monoGain;
 			}
-			for (int ch = 0; ch < numChannels; ch++) {
-				input[ch] = *(in[ch] + i);
+			else {
+				// a mono sidechain excites all input positions, additional channels excite them alternately
+				for (int ch = 0; ch < numChannels; ch++) {
+					input[ch] = *(excitation[std::min(ch, numExcitationChannels - 1)] + i);
+				}
+				for (int ch = numChannels; ch < numExcitationChannels; ch++) {
+					input[ch % numChannels] += *(excitation[ch] + i);
+				}
+			}
+			if (inputModulated || outputModulated) {
+				SampleType level = std::abs(monoInput);
+				if (!mono) {
+					for (int ch = 0; ch < numChannels; ch++) {
+						level = std::max(level, std::abs(input[ch]));
+					}
+				}
+				modulatePositions(i, level, multichannel);
 			}
-			resonator.delta(input);
-			tmp = resonator.next();
-			for (int ch = 0; ch < numChannels; ch++) {
-				tmp[ch] = lcFilters[ch].process(tmp[ch]);
-				tmp[ch] = hcFilters[ch].process(tmp[ch]);
-				tmp[ch] = currentVolume * (tmp[ch] * currentWet * volumeCompensation + dry * (*(in[ch] + i)));
+			if (multichannel) {
+				if (mono) {
+					resonator.deltaMono(monoInput);
+				}
+				else {
+					resonator.delta(input);
+				}
+				resonator.step();
+				pickups.project(resonator, wet.data());
+			}
+			else {
+				tmp = mono ? convolutionEngine.processMono(resonator, monoInput) : convolutionEngine.process(resonator, input);
+				for (int ch = 0; ch < numChannels; ch++) {
+					wet[ch] = tmp[ch];
+				}
+			}
+			for (int ch = 0; ch < numOutputs; ch++) {
+				wet[ch] = lcFilters[ch].process(wet[ch]);
+				wet[ch] = hcFilters[ch].process(wet[ch]);
+				wet[ch] = currentVolume * (wet[ch] * currentWet * volumeCompensation + dry * (*(in[ch] + i)));
 				if (limiterOn) {
-					tmp[ch] = std::tanh(tmp[ch]);
+					wet[ch] = std::tanh(wet[ch]);
 					// the tanh approximation is a few times faster but already for higher than the lowest few
 					// resonator orders the actual processing takes much more time than the limiting.
 					// And the approximation is softer / can exceed 1.
-					//tmp[ch] = tanh_approx(tmp[ch]);
+					//wet[ch] = tanh_approx(wet[ch]);
 				}
-				*(out[ch] + i) = tmp[ch];
-			}
-
-			maxSampleLSq = std::max(maxSampleLSq, tmp[0] * tmp[0]);
-			if constexpr (numChannels > 1) {
-				maxSampleRSq = std::max(maxSampleRSq, tmp[1] * tmp[1]);
+				*(out[ch] + i) = wet[ch];
 			}
 
 			currentVolume += volumeRamp;
@@ -179,33 +272,52 @@ public:
 			if (lcRamp) {
 				currentLCFreqNormalized += lcRamp;
 				double freq = ParamSpecs::lcFreq.toScaled(currentLCFreqNormalized);
-				for (auto& filter : lcFilters) {
-					filter.setFreqAndQ(freq, state.lcQ);
+				for (int ch = 0; ch < numOutputs; ch++) {
+					lcFilters[ch].setFreqAndQ(freq, state.lcQ);
 				}
 			}
 			if (hcRamp) {
 				currentHCFreqNormalized += hcRamp;
 				double freq = ParamSpecs::hcFreq.toScaled(currentHCFreqNormalized);
-				for (auto& filter : hcFilters) {
-					filter.setFreqAndQ(freq, state.hcQ);
+				for (int ch = 0; ch < numOutputs; ch++) {
+					hcFilters[ch].setFreqAndQ(freq, state.hcQ);
 				}
 			}
 		}
 		if (inCurveChanged) {
 			inCurveChanged = false;
 			currentInputPositions = newInputPositions;
-			resonator.setInputPositions(currentInputPositions);
+			if (!inputModulated) {
+				resonator.setInputPositions(currentInputPositions, eigenFunctionCache);
+			}
 		}
 		if (outCurveChanged) {
 			outCurveChanged = false;
 			currentOutputPositions = newOutputPositions;
-			resonator.setOutputPositions(currentOutputPositions);
+			if (!outputModulated) {
+				applyOutputPositions(currentOutputPositions, true);
+			}
 		}
+		// inaudible modes (below -160 dB each) are cleared before they become subnormal
+		resonator.flushDecayedModes(SampleType(1e-8) / volumeCompensation);
+
 		currentVolume = state.volume;
 		currentWet = state.mix;
 		currentLCFreqNormalized = state.lcFreqNormalized;
 		currentHCFreqNormalized = state.hcFreqNormalized;
 
+		const std::chrono::duration<double> processTime = std::chrono::steady_clock::now() - startTime;
+		adaptOrder(processTime.count(), numSamples, state.cpuBudget);
+
+		// VU peaks of the written block
+		const auto& kernels = Simd::kernels<SampleType>();
+		const SampleType maxSampleL = kernels.peak(out[0], numSamples);
+		const SampleType maxSampleLSq = maxSampleL * maxSampleL;
+		SampleType maxSampleRSq = 0;
+		if constexpr (numChannels > 1) {
+			const SampleType maxSampleR = kernels.peak(out[1], numSamples);
+			maxSampleRSq = maxSampleR * maxSampleR;
+		}
 		if (vuPPMLSq != maxSampleLSq || vuPPMRSq != maxSampleRSq) {
 			addOutputPoint(data, kParamVUPPM_L, std::sqrt(maxSampleLSq) * vuPPMNormalizedMultiplicatorInv);
 			addOutputPoint(data, kParamVUPPM_R, std::sqrt(maxSampleRSq) * vuPPMNormalizedMultiplicatorInv);
@@ -231,6 +343,7 @@ public:
 
 	void updateResonatorInputPosition(const ParamState& paramState) override {
 		inCurveChanged = true;
+		resonatorChanged();
 		for (int i = 0; i < maxDimension; i++) {
 			newInputPositions[0][i] = paramState[Params::kParamInL0 + i];
 			if constexpr (numChannels > 1) {
@@ -245,6 +358,7 @@ public:
 
 	void updateResonatorOutputPosition(const ParamState& paramState) override {
 		outCurveChanged = true;
+		resonatorChanged();
 		for (int i = 0; i < maxDimension; i++) {
 			newOutputPositions[0][i] = paramState[Params::kParamOutL0 + i];
 			if constexpr (numChannels > 1) {
@@ -257,9 +371,156 @@ public:
 		}
 	}
 
+	void preparePositions() override {
+		// nothing has been played yet, so there is nothing to ramp from
+		currentInputPositions = newInputPositions;
+		currentOutputPositions = newOutputPositions;
+		resonator.setInputPositions(currentInputPositions, eigenFunctionCache, true);
+		resonator.setOutputPositions(currentOutputPositions, eigenFunctionCache, true);
+		appliedOutputPositions = currentOutputPositions; // pickups are placed in the first block (setNumOutputs())
+		inCurveChanged = false;
+		outCurveChanged = false;
+	}
+
 
 
 protected:
+	// Needs to be called whenever the impulse response of the resonator changes
+	// (positions, dimension, order, frequency, damping or velocity).
+	void resonatorChanged() {
+		convolutionEngine.invalidate();
+	}
+
+	// The user order, limited by the adaptive order if a CPU budget is set. Order changes are
+	// faded so that dropped modes do not click. Adaptive steps only save CPU time of the modal
+	// bank and keep the impulse response of the convolution engine.
+	void applyOrder(bool adaptive = false) {
+		const int order = cpuBudget > 0 ? std::min(currentResonatorOrder, adaptiveOrder) : currentResonatorOrder;
+		if (order != appliedOrder) {
+			resonator.fadeToOrder(order, appliedOrder < 0 ? 0 : static_cast<int>(orderFadeTime * sampleRate));
+			appliedOrder = order;
+			if (!adaptive) {
+				resonatorChanged();
+			}
+		}
+	}
+
+	// Lowers the order when processing a block takes longer than the budget (a fraction of the
+	// block duration) and slowly raises it again up to the user order when there is headroom.
+	// The modes are sorted by frequency, so the highest ones are dropped first.
+	void adaptOrder(double processTime, int numSamples, double budget) {
+		if (budget != cpuBudget) {
+			cpuBudget = budget;
+			adaptiveOrder = Resonator::maxOrder();
+			averageLoad = 0;
+			applyOrder();
+		}
+		if (budget <= 0 || numSamples <= 0 || resonator.order() != appliedOrder) return; // off or still fading
+		// while convolving the load does not depend on the order
+		if (convolutionEngine.getMode() == decltype(convolutionEngine)::Mode::Convolving) return;
+
+		const double load = processTime * sampleRate / numSamples;
+		averageLoad += (load - averageLoad) * loadSmoothing;
+		if (averageLoad > budget && appliedOrder > minAdaptiveOrder) {
+			const int order = std::max(minAdaptiveOrder, static_cast<int>(appliedOrder * std::max(.5, .9 * budget / averageLoad)));
+			averageLoad *= double(order) / appliedOrder; // expected load, the modes dominate the cost
+			adaptiveOrder = order;
+			applyOrder(true);
+		}
+		else if (averageLoad < budget * .7 && adaptiveOrder < currentResonatorOrder) {
+			adaptiveOrder = std::min(currentResonatorOrder, adaptiveOrder + std::max(1, adaptiveOrder / 16));
+			applyOrder(true);
+		}
+	}
+
+	// Moves the modulated positions. Shapes with fast eigenfunction updates (the cube) are moved
+	// every sample, others every 8 samples like the position ramps. Pickups are always moved
+	// every 8 samples, one of them at a time (see ResonatorPickups::movePositions()).
+	void modulatePositions(int i, SampleType level, bool multichannel) {
+		constexpr int interval = Resonator::hasFastPositionUpdates() ? 1 : 8;
+		if (inputModulator.active()) {
+			const SpaceVec offset = inputModulator.next(level);
+			if (i % interval == 0) {
+				resonator.moveInputPositions(offsetPositions(currentInputPositions, offset));
+			}
+		}
+		if (outputModulator.active()) {
+			const SpaceVec offset = outputModulator.next(level);
+			if (multichannel) {
+				if (i % 8 == 0) {
+					applyOutputPositions(offsetPositions(currentOutputPositions, offset));
+				}
+			}
+			else if (i % interval == 0) {
+				resonator.moveOutputPositions(offsetPositions(currentOutputPositions, offset));
+			}
+		}
+	}
+
+	// The current (ramped) positions moved by the modulation offset, kept inside the shape
+	PositionVecArr offsetPositions(const PositionVecArr& positions, const SpaceVec& offset) const {
+		PositionVecArr result;
+		for (int ch = 0; ch < numChannels; ch++) {
+			result[ch] = positions[ch] + offset;
+			clampPosition(result[ch]);
+		}
+		return result;
+	}
+
+	// Limits each coordinate of x to the domain of the eigenfunctions. The cube eigenfunctions
+	// are defined (and periodic) everywhere, shapes with bounded coordinates override this.
+	virtual void clampPosition(SpaceVec& x) const {}
+
+	// Sets the output positions of the resonator and moves the pickups accordingly. Positions
+	// that are likely to be set again (not ramps or modulation) go through the eigenfunction cache.
+	void applyOutputPositions(const PositionVecArr& positions, bool cached = false) {
+		if (cached) {
+			resonator.setOutputPositions(positions, eigenFunctionCache);
+		}
+		else {
+			resonator.setOutputPositions(positions);
+		}
+		appliedOutputPositions = positions;
+		if (pickups.numPickups() > 0) {
+			updatePickups(pickups.numPickups(), !cached);
+		}
+	}
+
+	// Pickup k of n is placed at the fraction k/(n-1) of the way from the first to the last output
+	// position. Moving pickups (ramps, modulation) are re-evaluated one at a time.
+	void updatePickups(int n, bool moving = false) {
+		std::array<SpaceVec, maxOutputChannels> positions;
+		for (int k = 0; k < n; k++) {
+			const SampleType t = SampleType(k) / (n - 1);
+			positions[k] = appliedOutputPositions[0] + (appliedOutputPositions[numChannels - 1] - appliedOutputPositions[0]) * t;
+		}
+		if (moving) {
+			pickups.movePositions(resonator, positions.data(), n);
+		}
+		else {
+			pickups.setPositions(resonator, positions.data(), n);
+		}
+	}
+
+	void setNumOutputs(int numOutputs, const State& state) {
+		currentNumOutputs = numOutputs;
+		// pickups are only used if there are more outputs than resonator channels
+		updatePickups(numOutputs > numChannels ? numOutputs : 0);
+
+		// the filters of channels that were not in use missed the latest ramps
+		const double lcFreq = ParamSpecs::lcFreq.toScaled(currentLCFreqNormalized);
+		const double hcFreq = ParamSpecs::hcFreq.toScaled(currentHCFreqNormalized);
+		for (int ch = 0; ch < numOutputs; ch++) {
+			lcFilters[ch].setFreqAndQ(lcFreq, state.lcQ);
+			hcFilters[ch].setFreqAndQ(hcFreq, state.hcQ);
+		}
+	}
+
+	template<size_t... i>
+	static std::array<Filter, sizeof...(i)> makeFilters(typename Filter::Type type, std::index_sequence<i...>) {
+		return { (static_cast<void>(i), Filter(type))... };
+	}
+
 	// t in [0,1]; returns 0 vector for t = 0.5
 	SpaceVec inputPosSpaceCurve(ParamValue t) const {
 		constexpr SampleType pi = Math::pi<SampleType>();
@@ -284,11 +545,15 @@ protected:
 
 
 	Resonator resonator;
-	std::array<Filter, numChannels> lcFilters{ Filter::Type::kHighpass, Filter::Type::kHighpass };
-	std::array<Filter, numChannels> hcFilters{ Filter::Type::kLowpass, Filter::Type::kLowpass };
+	EigenFunctionCache& eigenFunctionCache = EigenFunctionCache::shared(); // shared by all instances
+	ResonatorConvolutionEngine<Resonator, SampleType, numChannels> convolutionEngine;
+	Math::ResonatorPickups<Resonator, maxOutputChannels> pickups;
+	std::array<Filter, maxOutputChannels> lcFilters = makeFilters(Filter::Type::kHighpass, std::make_index_sequence<maxOutputChannels>());
+	std::array<Filter, maxOutputChannels> hcFilters = makeFilters(Filter::Type::kLowpass, std::make_index_sequence<maxOutputChannels>());
 
 	double sampleRate{ 0 };
 
+	bool resonatorFreqChanged{ false };
 	bool inCurveChanged{ true };
 	bool outCurveChanged{ true };
 
@@ -298,6 +563,13 @@ protected:
 	PositionVecArr newInputPositions;
 	PositionVecArr currentOutputPositions;
 	PositionVecArr newOutputPositions;
+	PositionVecArr appliedOutputPositions; // as set to the resonator
+	int currentNumOutputs = numChannels;
+
+	Math::PositionModulator<SampleType, maxDimension> inputModulator;
+	Math::PositionModulator<SampleType, maxDimension> outputModulator;
+	bool inputWasModulated{ false };
+	bool outputWasModulated{ false };
 
 	// Output values (L/R)
 	SampleType vuPPMLSq{ 0 };
@@ -311,6 +583,15 @@ protected:
 	SampleType currentResFreq = 1, currentResDamp = 1, currentResVel = 1;
 	int currentResonatorOrder = 1;
 
+	// Adaptive order (see adaptOrder())
+	static constexpr double orderFadeTime = .02;  // in seconds
+	static constexpr double loadSmoothing = .2;	  // per block
+	static constexpr int minAdaptiveOrder = 8;
+	double cpuBudget{ 0 };						  // fraction of real time, 0 = fixed order
+	double averageLoad{ 0 };
+	int adaptiveOrder = Resonator::maxOrder();
+	int appliedOrder = -1;						  // as set to the resonator
+
 	// Volume compensation for higher volumes with higher resonator orders or lower dimensions
 	SampleType volumeCompensation = 0.03f / std::sqrt(currentResonatorOrder);
 };
@@ -34,8 +34,17 @@ struct State
 	double lcQ{ 1 };
 	double hcQ{ 1 };
 	bool limiterOn{ false };
+	bool monoExcitation{ false }; // excite with the mono sum at all input positions
+	bool sidechainActive{ false }; // excite from the sidechain bus instead of the main input
+	double cpuBudget{ 0 };		   // fraction of real time for processing, lowers the order if exceeded (0 = off)
+	double inModRate{ 0 }, inModDepth{ 0 }, inModEnv{ 0 };	  // input position modulation
+	double outModRate{ 0 }, outModDepth{ 0 }, outModEnv{ 0 }; // output position modulation
 };
 
+// Buses with more channels than the resonator has (i.e. surround) are fed by additional pickups
+// between the first and the last output position.
+constexpr int maxOutputChannels = 16;
+
 class ProcessorImplBase
 {
 public:
@@ -48,6 +57,8 @@ public:
 	//virtual void setHCFilterFreqAndQ(double freq, double q) = 0;
 	virtual void updateResonatorInputPosition(const ParamState& paramState) = 0;
 	virtual void updateResonatorOutputPosition(const ParamState& paramState) = 0;
+	// Applies the positions without a ramp, call from setActive() only (not while processing)
+	virtual void preparePositions() = 0;
 	virtual ~ProcessorImplBase() = default;
 };
 
@@ -66,6 +66,17 @@ enum Params : ParamID {
 	kParamResonatorLength, // OUT
 
 	kParamLimiterOn,
+	kParamMonoExcitation,
+	kParamCpuBudget,
+
+	kParamInModRate,
+	kParamInModDepth,
+	kParamInModEnv,
+	kParamOutModRate,
+	kParamOutModDepth,
+	kParamOutModEnv,
+
+	kParamPositionUpdates, // OUT
 	kNumGlobalParameters
 };
 
@@ -104,6 +115,19 @@ static const LinearParamSpec vuPPMR{ kParamVUPPM_R, 0.0, 1.0, 0.0, 0.0 };
 static const LinearParamSpec processTime{ kParamProcessTime, 0, 10, 0.0, 0.0 };
 
 static const ParamSpec limiterOn{ kParamLimiterOn, 0, 1, 1, 1 };
+static const ParamSpec monoExcitation{ kParamMonoExcitation, 0, 1, 0, 0 };
+static const LinearParamSpec cpuBudget{ kParamCpuBudget, 0, 100, 0, 0 }; // in percent of real time, 0 = fixed order
+
+// position modulation (LFO rate in Hz, LFO depth and envelope depth in position units)
+static const LogParamSpec inModRate{ kParamInModRate, 0.01, 50, 0.5, 0.5 };
+static const LinearParamSpec inModDepth{ kParamInModDepth, 0, 0.5, 0, 0 };
+static const LinearParamSpec inModEnv{ kParamInModEnv, 0, 1, 0, 0 };
+static const LogParamSpec outModRate{ kParamOutModRate, 0.01, 50, 0.5, 0.5 };
+static const LinearParamSpec outModDepth{ kParamOutModDepth, 0, 0.5, 0, 0 };
+static const LinearParamSpec outModEnv{ kParamOutModEnv, 0, 1, 0, 0 };
+
+// position updates done in percent of the position changes received (see PositionUpdateStats)
+static const LinearParamSpec positionUpdates{ kParamPositionUpdates, 0, 100, 100, 100 };
 }
 
 using ParamState = UniformParamState<kNumGlobalParameters>;
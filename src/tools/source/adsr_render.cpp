@@ -0,0 +1,146 @@
+﻿// -----------------------------------------------------------------------------------------------------------------------------
+// This file is part of the Überton project. Copyright (C) 2021 Überton
+//
+// Überton is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+// Überton is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details. You should
+// have received a copy of the GNU General Public License along with Überton. If not, see http://www.gnu.org/licenses/.
+// -----------------------------------------------------------------------------------------------------------------------------
+
+// Checks the block rendering of the ADSR envelopes against their per-sample next().
+//
+// Random envelopes (times from 2 to 20000 samples) are rendered with random block sizes and
+// released at random points, once with render() and once with next() per sample. render()
+// evaluates the ramps in closed form while next() accumulates them, so every rendered sample
+// must equal static_cast<float>(next()) up to the tolerance. The linear envelope additionally gets
+// its times changed during the ramps. Afterwards the time per sample of both ways is printed.
+//
+// Usage: adsr_render [envelopes]
+//
+// Returns 1 if any sample differs by more than the tolerance.
+
+#include <adsr.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace Uberton;
+
+namespace {
+
+constexpr int maxBlockSize = 1024;
+constexpr double tolerance = 1e-6; // a few float ulps of the envelope range [0, 1]
+
+struct Result
+{
+	long long samples{ 0 };
+	long long mismatches{ 0 };
+	double maxError{ 0 };
+};
+
+// Runs a and b (copies of the same envelope) side by side, a per sample, b per block
+template<class Envelope, class Change>
+void compare(Envelope& a, Envelope& b, std::mt19937& rng, Change change, Result& result) {
+	std::uniform_int_distribution<int> blockSize(1, maxBlockSize);
+	std::uniform_int_distribution<int> releaseAfter(0, 40000);
+	std::vector<float> block(maxBlockSize);
+	const long long releaseAt = releaseAfter(rng);
+	const long long end = releaseAt + 25000;
+	bool released = false;
+	for (long long n = 0; n < end;) {
+		if (!released && n >= releaseAt) {
+			a.release();
+			b.release();
+			released = true;
+		}
+		change(a, b);
+		const int length = blockSize(rng);
+		b.render(block.data(), length);
+		for (int i = 0; i < length; i++) {
+			const double error = std::abs(static_cast<float>(a.next()) - double(block[i]));
+			result.maxError = std::max(result.maxError, error);
+			if (error > tolerance) result.mismatches++;
+		}
+		result.samples += length;
+		n += length;
+	}
+}
+
+template<class Envelope>
+void time(const char* name, Envelope envelope) {
+	using Clock = std::chrono::steady_clock;
+	constexpr int blocks = 20000;
+	constexpr int blockSize = 256;
+	std::vector<float> block(blockSize);
+	volatile float sink = 0;
+
+	envelope.reset();
+	auto start = Clock::now();
+	for (int k = 0; k < blocks; k++) {
+		for (int i = 0; i < blockSize; i++) block[i] = static_cast<float>(envelope.next());
+		sink = sink + block[k % blockSize];
+	}
+	const std::chrono::duration<double, std::nano> perSample = (Clock::now() - start) / (double(blocks) * blockSize);
+
+	envelope.reset();
+	start = Clock::now();
+	for (int k = 0; k < blocks; k++) {
+		envelope.render(block.data(), blockSize);
+		sink = sink + block[k % blockSize];
+	}
+	const std::chrono::duration<double, std::nano> rendered = (Clock::now() - start) / (double(blocks) * blockSize);
+	std::printf("%-10s next() %6.2f ns/sample   render() %6.2f ns/sample\n", name, perSample.count(), rendered.count());
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+	const int envelopes = argc > 1 ? std::atoi(argv[1]) : 200;
+
+	std::mt19937 rng(1);
+	std::uniform_int_distribution<int> duration(2, 20000);
+	std::uniform_real_distribution<double> level(0, 1);
+	std::bernoulli_distribution changeNow(0.02);
+
+	Result quadratic;
+	for (int e = 0; e < envelopes; e++) {
+		QuadraticADSREnvelope a;
+		a.setParams(duration(rng), duration(rng), level(rng), duration(rng));
+		a.reset();
+		QuadraticADSREnvelope b = a;
+		compare(a, b, rng, [](auto&, auto&) {}, quadratic);
+	}
+
+	Result linear;
+	for (int e = 0; e < envelopes; e++) {
+		LinearADSREnvelope a;
+		a.set(duration(rng), duration(rng), level(rng), duration(rng));
+		a.reset();
+		LinearADSREnvelope b = a;
+		compare(a, b, rng, [&](LinearADSREnvelope& a, LinearADSREnvelope& b) {
+			if (!changeNow(rng)) return;
+			const int attack = duration(rng), decay = duration(rng), release = duration(rng);
+			const double sustain = level(rng);
+			a.set(attack, decay, sustain, release);
+			b.set(attack, decay, sustain, release);
+		}, linear);
+	}
+
+	std::printf("quadratic  %lld samples, %lld differ, max error %.1e\n", quadratic.samples, quadratic.mismatches, quadratic.maxError);
+	std::printf("linear     %lld samples, %lld differ, max error %.1e\n", linear.samples, linear.mismatches, linear.maxError);
+
+	QuadraticADSREnvelope quadraticEnvelope;
+	quadraticEnvelope.setParams(3000000, 3000000, .5, 1000);
+	time("quadratic", quadraticEnvelope);
+	LinearADSREnvelope linearEnvelope;
+	linearEnvelope.set(3000000, 3000000, .5, 1000);
+	time("linear", linearEnvelope);
+
+	return quadratic.mismatches == 0 && linear.mismatches == 0 ? 0 : 1;
+}
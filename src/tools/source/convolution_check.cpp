@@ -0,0 +1,135 @@
+﻿// -----------------------------------------------------------------------------------------------------------------------------
+// This file is part of the Überton project. Copyright (C) 2021 Überton
+//
+// Überton is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+// Überton is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details. You should
+// have received a copy of the GNU General Public License along with Überton. If not, see http://www.gnu.org/licenses/.
+// -----------------------------------------------------------------------------------------------------------------------------
+
+// Checks the partitioned convolver against direct convolution and measures its cost per block.
+//
+// Random impulse responses of several lengths (up to the uniform 8192 partitions) are loaded
+// for one and two channels, in float and double. The outputs for a noise input are compared with
+// the directly computed convolution at random times. Afterwards a long stereo impulse response
+// is run in blocks and the average and the largest time per block are printed next to the
+// estimates of flopsPerSample() and peakFlopsPerBlock(), to show that the stage work is spread
+// (the 99th percentile stays close to the average).
+//
+// Usage: convolution_check [block size]
+//
+// Returns 1 if the relative error exceeds the tolerance of the sample type.
+
+#include <convolution.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace Uberton;
+
+namespace {
+
+template<class T, int channels>
+bool check(int length, std::mt19937& rng, double tolerance) {
+	using Convolver = Math::PartitionedConvolver<T, channels>;
+	std::normal_distribution<double> noise;
+
+	std::vector<typename Convolver::PathFrame> h(length);
+	for (int m = 0; m < length; m++) {
+		const double decay = std::exp(-4.0 * m / length);
+		for (auto& x : h[m]) x = static_cast<T>(noise(rng) * decay);
+	}
+	auto convolver = std::make_unique<Convolver>();
+	convolver->prepare(length);
+	convolver->beginImpulseResponse(length);
+	for (const auto& frame : h) convolver->appendImpulseResponse(frame);
+
+	const int numSamples = 3 * length + 20000;
+	std::vector<typename Convolver::Frame> input(numSamples), output(numSamples);
+	for (auto& frame : input) {
+		for (auto& x : frame) x = static_cast<T>(noise(rng));
+	}
+	for (int n = 0; n < numSamples; n++) {
+		output[n] = convolver->process(input[n]);
+	}
+
+	double maxError = 0;
+	std::uniform_int_distribution<int> time(0, numSamples - 1);
+	for (int k = 0; k < 500; k++) {
+		const int n = time(rng);
+		for (int out = 0; out < channels; out++) {
+			double sum = 0, norm = 0;
+			for (int in = 0; in < channels; in++) {
+				for (int m = 0; m < length && m <= n; m++) {
+					const double term = double(h[m][out * channels + in]) * input[n - m][in];
+					sum += term;
+					norm += term * term;
+				}
+			}
+			maxError = std::max(maxError, std::abs(output[n][out] - sum) / std::sqrt(norm + 1e-30));
+		}
+	}
+	const bool ok = maxError <= tolerance;
+	std::printf("%-6s %d ch, length %6d: max relative error %.2e %s\n", sizeof(T) == 4 ? "float" : "double", channels, length, maxError, ok ? "" : "FAILED");
+	return ok;
+}
+
+void measure(int blockSize) {
+	using Convolver = Math::PartitionedConvolver<float, 2>;
+	constexpr int length = 1 << 18;
+	std::mt19937 rng(7);
+	std::normal_distribution<float> noise;
+	auto convolver = std::make_unique<Convolver>();
+	convolver->prepare(length);
+	convolver->beginImpulseResponse(length);
+	Convolver::PathFrame frame;
+	for (int m = 0; m < length; m++) {
+		for (auto& x : frame) x = noise(rng) * std::exp(-4.f * m / length);
+		convolver->appendImpulseResponse(frame);
+	}
+
+	using Clock = std::chrono::steady_clock;
+	const int numBlocks = 8 * 8192 * 4 / blockSize;
+	std::vector<double> times(numBlocks);
+	double total = 0;
+	float sink = 0;
+	for (int b = 0; b < numBlocks; b++) {
+		const auto start = Clock::now();
+		for (int i = 0; i < blockSize; i++) {
+			sink += convolver->process({ noise(rng), noise(rng) })[0];
+		}
+		times[b] = std::chrono::duration<double>(Clock::now() - start).count();
+		total += times[b];
+	}
+	// the largest times are mostly preemptions, the 99th percentile shows the periodic peaks
+	std::sort(times.begin(), times.end());
+	const double average = total / numBlocks;
+	const double p99 = times[numBlocks * 99 / 100];
+	std::printf("\nstereo, length %d, blocks of %d samples (%g)\n", length, blockSize, sink * 0);
+	std::printf("  time per block:  average %8.1f us, 99%%    %8.1f us (%.1fx), largest %.1f us\n", 1e6 * average, 1e6 * p99, p99 / average, 1e6 * times.back());
+	std::printf("  flops per block: average %8.0f,    bound  %8.0f    (%.1fx)\n", blockSize * Convolver::flopsPerSample(length),
+				Convolver::peakFlopsPerBlock(length, blockSize), Convolver::peakFlopsPerBlock(length, blockSize) / (blockSize * Convolver::flopsPerSample(length)));
+}
+
+}
+
+int main(int argc, char* argv[]) {
+	const int blockSize = argc > 1 ? std::max(1, std::atoi(argv[1])) : 64;
+	std::mt19937 rng(1);
+	bool ok = true;
+	for (int length : { 50, 300, 5000, 40000 }) {
+		ok &= check<double, 1>(length, rng, 1e-9);
+		ok &= check<double, 2>(length, rng, 1e-9);
+		ok &= check<float, 1>(length, rng, 1e-3);
+		ok &= check<float, 2>(length, rng, 1e-3);
+	}
+	measure(blockSize);
+	return ok ? 0 : 1;
+}
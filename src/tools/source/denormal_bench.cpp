@@ -0,0 +1,95 @@
+﻿// -----------------------------------------------------------------------------------------------------------------------------
+// This file is part of the Überton project. Copyright (C) 2021 Überton
+//
+// Überton is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+// Überton is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details. You should
+// have received a copy of the GNU General Public License along with Überton. If not, see http://www.gnu.org/licenses/.
+// -----------------------------------------------------------------------------------------------------------------------------
+
+// Benchmark of the decay tail of a float resonator while its amplitudes pass through the
+// subnormal range.
+//
+// A resonator with strong damping is struck once and then rings out. The processing time per
+// sample is printed for each second of the tail, once without any precautions, once inside a
+// ProcessorUtilities::DenormalScope (as in ProcessorBase::process()) and once with
+// flushDecayedModes() after each block (as in the resonator plugins) but without the scope.
+//
+// Usage: denormal_bench [dampening]
+
+#include <processor_utilities.h>
+#include <resonator.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace Uberton;
+using namespace Uberton::Math;
+
+namespace {
+
+constexpr int order = 200;
+constexpr int dim = 3;
+constexpr float sampleRate = 48000;
+constexpr int blockSize = 256;
+constexpr int seconds = 12;
+
+using Resonator = CubeResonator<float, dim, order, 2>;
+
+enum class Variant {
+	Plain,
+	DenormalScope,
+	FlushModes
+};
+
+void run(Resonator& r, Variant variant, double (&timePerSample)[seconds]) {
+	using Clock = std::chrono::steady_clock;
+	r.clear();
+	r.delta({ 1, 1 });
+
+	constexpr int blocksPerSecond = int(sampleRate) / blockSize;
+	volatile float sink = 0;
+	for (int s = 0; s < seconds; s++) {
+		const auto start = Clock::now();
+		for (int block = 0; block < blocksPerSecond; block++) {
+			if (variant == Variant::DenormalScope) {
+				ProcessorUtilities::DenormalScope denormalScope;
+				for (int i = 0; i < blockSize; i++) sink = sink + r.next()[0];
+			}
+			else {
+				for (int i = 0; i < blockSize; i++) sink = sink + r.next()[0];
+			}
+			if (variant == Variant::FlushModes) {
+				r.flushDecayedModes(1e-8f);
+			}
+		}
+		const std::chrono::duration<double, std::micro> duration = Clock::now() - start;
+		timePerSample[s] = duration.count() / (blocksPerSecond * blockSize);
+	}
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+	const float dampening = argc > 1 ? float(std::atof(argv[1])) : 10;
+
+	static Resonator r;
+	r.setSampleRate(sampleRate);
+	r.setFreqDampeningAndVelocity(100, dampening, 343);
+	r.setInputPositions({ Vector<float, dim>{ .3f, .4f, .2f }, Vector<float, dim>{ .6f, .3f, .7f } });
+	r.setOutputPositions({ Vector<float, dim>{ .7f, .1f, .5f }, Vector<float, dim>{ .2f, .8f, .4f } });
+
+	double plain[seconds], scope[seconds], flush[seconds];
+	run(r, Variant::Plain, plain);
+	run(r, Variant::DenormalScope, scope);
+	run(r, Variant::FlushModes, flush);
+
+	std::printf("order %d, dampening %g, microseconds per sample\n", order, dampening);
+	std::printf("%6s  %10s  %10s  %10s  %14s\n", "second", "plain", "FTZ/DAZ", "flush", "envelope (dB)");
+	for (int s = 0; s < seconds; s++) {
+		std::printf("%6d  %10.3f  %10.3f  %10.3f  %14.0f\n", s, plain[s], scope[s], flush[s], -8.686 * dampening * s);
+	}
+	return 0;
+}
@@ -0,0 +1,141 @@
+﻿// -----------------------------------------------------------------------------------------------------------------------------
+// This file is part of the Überton project. Copyright (C) 2021 Überton
+//
+// Überton is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+// Überton is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details. You should
+// have received a copy of the GNU General Public License along with Überton. If not, see http://www.gnu.org/licenses/.
+// -----------------------------------------------------------------------------------------------------------------------------
+
+// Benchmark of the dimension specialized eigenfunction kernels against eigenFunction() per mode.
+//
+// For the precomputed cube (as in Tesseract), the n-sphere (as in Hypersphere) and each dimension
+// as well as for the circular membrane and the cylinder, all eigenfunctions are evaluated at a
+// position moving along a curve, like it happens with modulated position curves. The time per
+// position update (all modes, one channel) and the largest difference between both ways are
+// printed, the latter should be 0 (membrane and cylinder: float rounding, their kernel computes
+// in double). For the cube also the rotated kernel (used for audio rate position modulation) and
+// its largest error.
+//
+// Usage: eigenfunction_bench [updates]
+
+#include <resonator.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+namespace Uberton {
+namespace Math {
+template<class T, int maxDim, int maxOrder>
+CubeEWPStorage<T, maxDim> getCubeEWPStorage();
+}
+}
+
+using namespace Uberton::Math;
+
+namespace {
+
+constexpr int order = 200;
+constexpr int maxDimension = 10;
+
+template<class Resonator, class Position>
+void run(Resonator& r, int dim, int updates, Position position) {
+	using Clock = std::chrono::steady_clock;
+	using scalar = typename Resonator::scalar;
+	std::vector<scalar> reference(order), fast(order), rotated(order);
+
+	double maxDiff = 0;
+	const auto t0 = Clock::now();
+	for (int u = 0; u < updates; u++) {
+		const auto x = position(u);
+		for (int i = 0; i < order; i++) {
+			reference[i] = r.eigenFunction(i, x);
+		}
+	}
+	const auto t1 = Clock::now();
+	for (int u = 0; u < updates; u++) {
+		r.evaluateEigenFunctions(position(u), fast.data(), order);
+	}
+	const auto t2 = Clock::now();
+	for (int u = 0; u < updates; u++) {
+		r.evaluateEigenFunctionsRotated(position(u), rotated.data(), order);
+	}
+	const auto t3 = Clock::now();
+	double maxRotatedDiff = 0;
+	for (int u = 0; u < updates; u += 97) {
+		const auto x = position(u);
+		r.evaluateEigenFunctions(x, fast.data(), order);
+		r.evaluateEigenFunctionsRotated(x, rotated.data(), order);
+		for (int i = 0; i < order; i++) {
+			const scalar exact = r.eigenFunction(i, x);
+			maxDiff = std::max(maxDiff, double(std::abs(fast[i] - exact)));
+			maxRotatedDiff = std::max(maxRotatedDiff, double(std::abs(rotated[i] - exact)));
+		}
+	}
+
+	const double perMode = std::chrono::duration<double, std::micro>(t1 - t0).count() / updates;
+	const double kernel = std::chrono::duration<double, std::micro>(t2 - t1).count() / updates;
+	const double rotatedKernel = std::chrono::duration<double, std::micro>(t3 - t2).count() / updates;
+	std::printf("%4d %14.2f %14.2f %8.1fx %12g %13.2f %12g\n", dim, perMode, kernel, perMode / kernel, maxDiff, rotatedKernel, maxRotatedDiff);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+	const int updates = argc > 1 ? std::atoi(argv[1]) : 2000;
+
+	std::printf("cube\n dim  per mode [us]    kernel [us]  speedup     max diff  rotated [us]  rotated diff\n");
+	{
+		using Resonator = PreComputedCubeResonator<float, maxDimension, order, 1>;
+		auto r = std::make_unique<Resonator>();
+		r->setStorage(getCubeEWPStorage<float, maxDimension, order>());
+		for (int dim = 1; dim <= maxDimension; dim++) {
+			r->setDim(dim);
+			run(*r, dim, updates, [](int u) {
+				Resonator::SpaceVec x;
+				for (int j = 0; j < maxDimension; j++) {
+					x[j] = .5f + .4f * std::sin(.001f * u + j);
+				}
+				return x;
+			});
+		}
+	}
+
+	std::printf("nsphere\n dim  per mode [us]    kernel [us]  speedup     max diff  rotated [us]  rotated diff\n");
+	{
+		using Resonator = NSphereResonator<float, maxDimension, order, 1>;
+		auto r = std::make_unique<Resonator>();
+		for (int dim = 2; dim <= maxDimension; dim++) {
+			r->setDim(dim);
+			run(*r, dim, updates / 4, [](int u) {
+				Resonator::SpaceVec x;
+				x[0] = .7f + .2f * std::sin(.001f * u);
+				x[1] = 3.f + 2.f * std::sin(.0013f * u);
+				for (int j = 2; j < maxDimension; j++) {
+					x[j] = 1.5f + std::sin(.001f * u + j); // strictly between 0 and π
+				}
+				return x;
+			});
+		}
+	}
+
+	std::printf("membrane (2), cylinder (3)\n dim  per mode [us]    kernel [us]  speedup     max diff  rotated [us]  rotated diff\n");
+	{
+		auto r = std::make_unique<MembraneResonator<float, order, 1>>();
+		run(*r, 2, updates, [](int u) {
+			return Vector<float, 2>{ .5f + .4f * std::sin(.001f * u), 3.f + 2.f * std::sin(.0013f * u) };
+		});
+	}
+	{
+		auto r = std::make_unique<CylinderResonator<float, order, 1>>();
+		run(*r, 3, updates, [](int u) {
+			return Vector<float, 3>{ .5f + .4f * std::sin(.001f * u), 3.f + 2.f * std::sin(.0013f * u), .5f + .3f * std::sin(.0007f * u) };
+		});
+	}
+	return 0;
+}
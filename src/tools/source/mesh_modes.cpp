@@ -0,0 +1,675 @@
+﻿// -----------------------------------------------------------------------------------------------------------------------------
+// This file is part of the Überton project. Copyright (C) 2021 Überton
+//
+// Überton is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+// Überton is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details. You should
+// have received a copy of the GNU General Public License along with Überton. If not, see http://www.gnu.org/licenses/.
+// -----------------------------------------------------------------------------------------------------------------------------
+
+// Offline computation of the lowest Laplacian eigenpairs of a mesh for MeshResonator.
+//
+// The mesh is discretized with linear finite elements (cotangent stiffness for triangles, also on
+// curved surfaces, and the analogue for tetrahedra) with a lumped mass matrix M. The generalized
+// problem K·u = λ·M·u is solved with shift-invert Lanczos: the operator M^½·(K + σM)⁻¹·M^½ is
+// applied with a skyline Cholesky factorization of K + σM after reverse Cuthill-McKee ordering,
+// the Lanczos vectors are fully reorthogonalized and the number of steps is increased until the
+// requested modes are converged.
+//
+// With a clamped boundary (default) the eigenfunctions vanish on boundary edges (triangles) or
+// faces (tetrahedra), with a free boundary the constant modes (λ = 0) are dropped. The
+// eigenfunctions are normalized to a mean square of 2⁻ᵈ over the mesh like the cube modes (d = 2
+// for triangles and 3 for tetrahedra) and written as MeshModeTable.
+//
+// Usage: mesh_modes <mesh> <out.modes> [options]
+//   --modes n            number of modes                                   default 200
+//   --boundary b         clamped or free                                   default clamped
+//
+// Meshes: Wavefront OBJ (v and f lines, polygons are split into triangles), ASCII PLY (x y z as
+// the first vertex properties, faces) or a text file with "numVertices numElements k" followed by
+// the vertices (x y z) and the elements (k = 3 or 4 zero based vertex indices). Lines starting
+// with # are ignored in text files.
+
+#include <mesh_resonator.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace Uberton::Math;
+
+namespace {
+
+using Vec3 = std::array<double, 3>;
+
+struct Mesh
+{
+	std::vector<Vec3> vertices;
+	int verticesPerElement{ 3 };
+	std::vector<std::array<int, 4>> elements;
+};
+
+struct Options
+{
+	std::string meshFile, outFile;
+	int modes{ 200 };
+	bool clamped{ true };
+};
+
+// ---- Mesh input ----
+
+bool endsWith(const std::string& s, const std::string& suffix) {
+	return s.size() >= suffix.size() && std::equal(suffix.rbegin(), suffix.rend(), s.rbegin(),
+													[](char a, char b) { return std::tolower(a) == std::tolower(b); });
+}
+
+void addPolygon(Mesh& mesh, const std::vector<int>& polygon) {
+	for (std::size_t k = 2; k < polygon.size(); k++) {
+		mesh.elements.push_back({ polygon[0], polygon[k - 1], polygon[k], 0 });
+	}
+}
+
+bool readObj(std::istream& in, Mesh& mesh) {
+	std::string line;
+	while (std::getline(in, line)) {
+		std::istringstream stream(line);
+		std::string type;
+		stream >> type;
+		if (type == "v") {
+			Vec3 v{};
+			stream >> v[0] >> v[1] >> v[2];
+			mesh.vertices.push_back(v);
+		} else if (type == "f") {
+			std::vector<int> polygon;
+			std::string token;
+			while (stream >> token) {
+				const int index = std::atoi(token.c_str()); // "i", "i/t" or "i/t/n"
+				polygon.push_back(index < 0 ? static_cast<int>(mesh.vertices.size()) + index : index - 1);
+			}
+			addPolygon(mesh, polygon);
+		}
+	}
+	return true;
+}
+
+bool readPly(std::istream& in, Mesh& mesh) {
+	std::string line, word;
+	int numVertices = 0, numFaces = 0;
+	std::string element;
+	while (std::getline(in, line)) {
+		std::istringstream stream(line);
+		stream >> word;
+		if (word == "format" && line.find("ascii") == std::string::npos) return false;
+		if (word == "element") {
+			int count = 0;
+			stream >> element >> count;
+			if (element == "vertex") numVertices = count;
+			if (element == "face") numFaces = count;
+		}
+		if (word == "end_header") break;
+	}
+	for (int i = 0; i < numVertices && std::getline(in, line); i++) {
+		std::istringstream stream(line);
+		Vec3 v{};
+		stream >> v[0] >> v[1] >> v[2];
+		mesh.vertices.push_back(v);
+	}
+	for (int i = 0; i < numFaces && std::getline(in, line); i++) {
+		std::istringstream stream(line);
+		int count = 0;
+		stream >> count;
+		std::vector<int> polygon(count);
+		for (auto& index : polygon) stream >> index;
+		addPolygon(mesh, polygon);
+	}
+	return static_cast<int>(mesh.vertices.size()) == numVertices;
+}
+
+bool readText(std::istream& in, Mesh& mesh) {
+	std::stringstream content;
+	std::string line;
+	while (std::getline(in, line)) {
+		if (!line.empty() && line[0] != '#') content << line << '\n';
+	}
+	int numVertices = 0, numElements = 0;
+	content >> numVertices >> numElements >> mesh.verticesPerElement;
+	if (mesh.verticesPerElement != 3 && mesh.verticesPerElement != 4) return false;
+	mesh.vertices.resize(numVertices);
+	for (auto& v : mesh.vertices) content >> v[0] >> v[1] >> v[2];
+	mesh.elements.resize(numElements);
+	for (auto& e : mesh.elements) {
+		for (int k = 0; k < mesh.verticesPerElement; k++) content >> e[k];
+	}
+	return static_cast<bool>(content);
+}
+
+bool readMesh(const std::string& filename, Mesh& mesh) {
+	std::ifstream file(filename);
+	if (!file) return false;
+	bool ok;
+	if (endsWith(filename, ".obj")) ok = readObj(file, mesh);
+	else if (endsWith(filename, ".ply")) ok = readPly(file, mesh);
+	else ok = readText(file, mesh);
+	if (!ok || mesh.vertices.empty() || mesh.elements.empty()) return false;
+	for (const auto& e : mesh.elements) {
+		for (int k = 0; k < mesh.verticesPerElement; k++) {
+			if (e[k] < 0 || e[k] >= static_cast<int>(mesh.vertices.size())) return false;
+		}
+	}
+	return true;
+}
+
+// ---- Finite elements ----
+
+Vec3 sub(const Vec3& a, const Vec3& b) { return { a[0] - b[0], a[1] - b[1], a[2] - b[2] }; }
+double dot(const Vec3& a, const Vec3& b) { return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]; }
+Vec3 cross(const Vec3& a, const Vec3& b) { return { a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0] }; }
+
+// Symmetric sparse matrix as sorted rows
+struct SparseMatrix
+{
+	std::vector<std::vector<std::pair<int, double>>> rows;
+
+	void add(int i, int j, double value) { rows[i].push_back({ j, value }); }
+
+	void compress() {
+		for (auto& row : rows) {
+			std::sort(row.begin(), row.end(), [](auto& a, auto& b) { return a.first < b.first; });
+			std::size_t out = 0;
+			for (std::size_t k = 0; k < row.size(); k++) {
+				if (out > 0 && row[out - 1].first == row[k].first) row[out - 1].second += row[k].second;
+				else row[out++] = row[k];
+			}
+			row.resize(out);
+		}
+	}
+};
+
+// Stiffness matrix K and lumped mass M (diagonal) per vertex, returns the number of skipped
+// degenerate elements
+int assemble(const Mesh& mesh, SparseMatrix& K, std::vector<double>& M) {
+	const int n = static_cast<int>(mesh.vertices.size());
+	K.rows.assign(n, {});
+	M.assign(n, 0);
+	int degenerate = 0;
+	for (const auto& e : mesh.elements) {
+		const Vec3& p0 = mesh.vertices[e[0]];
+		if (mesh.verticesPerElement == 3) {
+			const Vec3& p1 = mesh.vertices[e[1]];
+			const Vec3& p2 = mesh.vertices[e[2]];
+			// K_ij = e_i·e_j / 4A with the edges e_i opposite of vertex i
+			const std::array<Vec3, 3> edges = { sub(p2, p1), sub(p0, p2), sub(p1, p0) };
+			const Vec3 normal = cross(sub(p1, p0), sub(p2, p0));
+			const double area = .5 * std::sqrt(dot(normal, normal));
+			if (area <= 0) {
+				degenerate++;
+				continue;
+			}
+			for (int i = 0; i < 3; i++) {
+				for (int j = 0; j < 3; j++) K.add(e[i], e[j], dot(edges[i], edges[j]) / (4 * area));
+				M[e[i]] += area / 3;
+			}
+		} else {
+			// K_ij = V·∇λ_i·∇λ_j, the gradients of the barycentric coordinates are the rows of J⁻¹
+			const Vec3 a = sub(mesh.vertices[e[1]], p0), b = sub(mesh.vertices[e[2]], p0), c = sub(mesh.vertices[e[3]], p0);
+			const double det = dot(a, cross(b, c));
+			const double volume = std::abs(det) / 6;
+			if (volume <= 0) {
+				degenerate++;
+				continue;
+			}
+			std::array<Vec3, 4> gradients;
+			gradients[1] = cross(b, c);
+			gradients[2] = cross(c, a);
+			gradients[3] = cross(a, b);
+			for (int i = 1; i < 4; i++) {
+				for (int x = 0; x < 3; x++) gradients[i][x] /= det;
+			}
+			for (int x = 0; x < 3; x++) gradients[0][x] = -(gradients[1][x] + gradients[2][x] + gradients[3][x]);
+			for (int i = 0; i < 4; i++) {
+				for (int j = 0; j < 4; j++) K.add(e[i], e[j], volume * dot(gradients[i], gradients[j]));
+				M[e[i]] += volume / 4;
+			}
+		}
+	}
+	K.compress();
+	return degenerate;
+}
+
+// Vertices on edges of a single triangle (or faces of a single tetrahedron)
+std::vector<bool> boundaryVertices(const Mesh& mesh) {
+	std::map<std::array<int, 3>, int> count;
+	const int perElement = mesh.verticesPerElement;
+	for (const auto& e : mesh.elements) {
+		for (int skip = 0; skip < perElement; skip++) {
+			std::array<int, 3> side{ -1, -1, -1 }; // unused entries stay -1 and are sorted to the front
+			int k = 0;
+			for (int v = 0; v < perElement; v++) {
+				if (v != skip) side[k++] = e[v];
+			}
+			std::sort(side.begin(), side.end());
+			count[side]++;
+		}
+	}
+	std::vector<bool> boundary(mesh.vertices.size(), false);
+	for (const auto& [side, n] : count) {
+		if (n != 1) continue;
+		for (int v : side) {
+			if (v >= 0) boundary[v] = true;
+		}
+	}
+	return boundary;
+}
+
+// ---- Sparse solver ----
+
+// Reverse Cuthill-McKee ordering of the graph, order[new] = old
+std::vector<int> reverseCuthillMcKee(const std::vector<std::vector<int>>& graph) {
+	const int n = static_cast<int>(graph.size());
+	std::vector<int> order;
+	std::vector<int> level(n, -1);
+	std::vector<bool> placed(n, false);
+	auto bfs = [&](int start, std::vector<int>& visited) {
+		visited.assign(1, start);
+		std::fill(level.begin(), level.end(), -1);
+		level[start] = 0;
+		for (std::size_t k = 0; k < visited.size(); k++) {
+			std::vector<int> next;
+			for (int u : graph[visited[k]]) {
+				if (level[u] < 0) {
+					level[u] = level[visited[k]] + 1;
+					next.push_back(u);
+				}
+			}
+			std::sort(next.begin(), next.end(), [&](int a, int b) { return graph[a].size() < graph[b].size(); });
+			visited.insert(visited.end(), next.begin(), next.end());
+		}
+	};
+	std::vector<int> visited;
+	for (int seed = 0; seed < n; seed++) {
+		if (placed[seed]) continue;
+		// pseudo peripheral start: repeatedly the least connected vertex of the last level
+		int start = seed;
+		for (int iteration = 0; iteration < 3; iteration++) {
+			bfs(start, visited);
+			const int last = level[visited.back()];
+			for (int v : visited) {
+				if (level[v] == last && graph[v].size() < graph[start].size()) start = v;
+			}
+		}
+		bfs(start, visited);
+		for (int v : visited) placed[v] = true;
+		order.insert(order.end(), visited.begin(), visited.end());
+	}
+	std::reverse(order.begin(), order.end());
+	return order;
+}
+
+// Cholesky factorization L·Lᵀ of a symmetric positive definite matrix in skyline storage (row i
+// holds the columns first[i]...i)
+struct SkylineCholesky
+{
+	std::vector<int> first;
+	std::vector<std::size_t> rowStart;
+	std::vector<double> values;
+
+	double& at(int i, int j) { return values[rowStart[i] + (j - first[i])]; }
+	double at(int i, int j) const { return values[rowStart[i] + (j - first[i])]; }
+
+	bool factorize() {
+		const int n = static_cast<int>(first.size());
+		for (int i = 0; i < n; i++) {
+			for (int j = first[i]; j <= i; j++) {
+				const int lo = std::max(first[i], first[j]);
+				const double* li = &values[rowStart[i] + (lo - first[i])];
+				const double* lj = &values[rowStart[j] + (lo - first[j])];
+				double sum = at(i, j);
+				for (int k = 0; k < j - lo; k++) sum -= li[k] * lj[k];
+				if (j < i) {
+					at(i, j) = sum / at(j, j);
+				} else {
+					if (sum <= 0) return false;
+					at(i, i) = std::sqrt(sum);
+				}
+			}
+		}
+		return true;
+	}
+
+	// x = (L·Lᵀ)⁻¹·x
+	void solve(std::vector<double>& x) const {
+		const int n = static_cast<int>(first.size());
+		for (int i = 0; i < n; i++) {
+			double sum = x[i];
+			for (int k = first[i]; k < i; k++) sum -= at(i, k) * x[k];
+			x[i] = sum / at(i, i);
+		}
+		for (int i = n - 1; i >= 0; i--) {
+			x[i] /= at(i, i);
+			for (int k = first[i]; k < i; k++) x[k] -= at(i, k) * x[i];
+		}
+	}
+};
+
+// Eigenvalues d and eigenvectors (rows of z, m×m) of the symmetric tridiagonal matrix with the
+// diagonal d and the off-diagonal e (e[i] couples i and i + 1), implicit QL with shifts
+void tridiagonalEigen(std::vector<double>& d, std::vector<double> e, std::vector<double>& z) {
+	const int m = static_cast<int>(d.size());
+	e.resize(m, 0);
+	z.assign(static_cast<std::size_t>(m) * m, 0);
+	for (int i = 0; i < m; i++) z[static_cast<std::size_t>(i) * m + i] = 1;
+	for (int l = 0; l < m; l++) {
+		int iterations = 0, k;
+		do {
+			for (k = l; k < m - 1; k++) {
+				const double dd = std::abs(d[k]) + std::abs(d[k + 1]);
+				if (std::abs(e[k]) <= std::numeric_limits<double>::epsilon() * dd) break;
+			}
+			if (k == l || iterations++ == 60) break;
+			double g = (d[l + 1] - d[l]) / (2 * e[l]);
+			double r = std::hypot(g, 1.0);
+			g = d[k] - d[l] + e[l] / (g + std::copysign(r, g));
+			double s = 1, c = 1, p = 0;
+			int i;
+			for (i = k - 1; i >= l; i--) {
+				const double f = s * e[i], b = c * e[i];
+				r = std::hypot(f, g);
+				e[i + 1] = r;
+				if (r == 0) {
+					d[i + 1] -= p;
+					e[k] = 0;
+					break;
+				}
+				s = f / r;
+				c = g / r;
+				g = d[i + 1] - p;
+				r = (d[i] - g) * s + 2 * c * b;
+				p = s * r;
+				d[i + 1] = g + p;
+				g = c * r - b;
+				double* z0 = &z[static_cast<std::size_t>(i) * m];
+				double* z1 = &z[static_cast<std::size_t>(i + 1) * m];
+				for (int row = 0; row < m; row++) {
+					const double t = z1[row];
+					z1[row] = s * z0[row] + c * t;
+					z0[row] = c * z0[row] - s * t;
+				}
+			}
+			if (r == 0 && i >= l) continue;
+			d[l] -= p;
+			e[l] = g;
+			e[k] = 0;
+		} while (k != l);
+	}
+}
+
+double dotProduct(const std::vector<double>& a, const std::vector<double>& b) {
+	return std::inner_product(a.begin(), a.end(), b.begin(), 0.0);
+}
+
+struct EigenPairs
+{
+	std::vector<double> values;				  // λ ascending
+	std::vector<std::vector<double>> vectors; // M-orthonormal, per degree of freedom
+	int steps{ 0 };
+	int converged{ 0 };
+};
+
+// Lowest count eigenpairs of K·u = λ·M·u (M diagonal) with shift-invert Lanczos on
+// M^½·(K + σM)⁻¹·M^½ whose largest eigenvalues are 1/(λ + σ)
+bool lanczos(const SparseMatrix& K, const std::vector<double>& M, double sigma, int count, EigenPairs& result) {
+	const int n = static_cast<int>(M.size());
+	count = std::min(count, n);
+
+	std::vector<std::vector<int>> graph(n);
+	for (int i = 0; i < n; i++) {
+		for (const auto& [j, value] : K.rows[i]) {
+			if (j != i) graph[i].push_back(j);
+		}
+	}
+	const std::vector<int> order = reverseCuthillMcKee(graph);
+	std::vector<int> position(n);
+	for (int k = 0; k < n; k++) position[order[k]] = k;
+
+	SkylineCholesky A;
+	A.first.resize(n);
+	A.rowStart.resize(n + 1, 0);
+	for (int k = 0; k < n; k++) {
+		A.first[k] = k;
+		for (const auto& entry : K.rows[order[k]]) A.first[k] = std::min(A.first[k], position[entry.first]);
+		A.rowStart[k + 1] = A.rowStart[k] + (k - A.first[k] + 1);
+	}
+	A.values.assign(A.rowStart[n], 0);
+	for (int k = 0; k < n; k++) {
+		for (const auto& [j, value] : K.rows[order[k]]) {
+			if (position[j] <= k) A.at(k, position[j]) += value;
+		}
+		A.at(k, k) += sigma * M[order[k]];
+	}
+	std::fprintf(stderr, "%d degrees of freedom, skyline %zu entries\n", n, A.values.size());
+	if (!A.factorize()) return false;
+
+	std::vector<double> sqrtM(n);
+	for (int i = 0; i < n; i++) sqrtM[i] = std::sqrt(M[i]);
+	std::vector<double> permuted(n);
+	auto apply = [&](const std::vector<double>& x, std::vector<double>& y) {
+		for (int k = 0; k < n; k++) permuted[k] = sqrtM[order[k]] * x[order[k]];
+		A.solve(permuted);
+		for (int k = 0; k < n; k++) y[order[k]] = sqrtM[order[k]] * permuted[k];
+	};
+
+	std::mt19937 random(1);
+	std::normal_distribution<double> normal;
+	int steps = std::min(n, 2 * count + 50);
+	while (true) {
+		std::vector<std::vector<double>> Q;
+		std::vector<double> alpha, beta;
+		std::vector<double> q(n), w(n);
+		for (auto& x : q) x = normal(random);
+		double norm = std::sqrt(dotProduct(q, q));
+		for (auto& x : q) x /= norm;
+		double lastBeta = 0;
+		for (int j = 0; j < steps; j++) {
+			Q.push_back(q);
+			apply(q, w);
+			alpha.push_back(dotProduct(w, q));
+			// full reorthogonalization (twice) also removes the α and β terms
+			for (int pass = 0; pass < 2; pass++) {
+				for (const auto& v : Q) {
+					const double projection = dotProduct(w, v);
+					for (int i = 0; i < n; i++) w[i] -= projection * v[i];
+				}
+			}
+			lastBeta = std::sqrt(dotProduct(w, w));
+			if (j + 1 == steps || lastBeta <= 1e-12 * std::abs(alpha.back())) break; // invariant subspace
+			beta.push_back(lastBeta);
+			for (int i = 0; i < n; i++) q[i] = w[i] / lastBeta;
+		}
+		const int m = static_cast<int>(alpha.size());
+
+		std::vector<double> theta = alpha, z;
+		tridiagonalEigen(theta, beta, z);
+		std::vector<int> ritz(m);
+		std::iota(ritz.begin(), ritz.end(), 0);
+		std::sort(ritz.begin(), ritz.end(), [&](int a, int b) { return theta[a] > theta[b]; });
+
+		// residual of the Ritz pair k: β_m·|last component of its eigenvector|
+		int converged = 0;
+		while (converged < std::min(count, m) && lastBeta * std::abs(z[static_cast<std::size_t>(ritz[converged]) * m + m - 1]) <= 1e-9 * theta[ritz[converged]]) {
+			converged++;
+		}
+		if (converged < count && m == steps && steps < n) {
+			steps = std::min(n, steps * 3 / 2);
+			std::fprintf(stderr, "%d of %d modes converged, retrying with %d Lanczos steps\n", converged, count, steps);
+			continue;
+		}
+
+		result.steps = m;
+		result.converged = converged;
+		const int numPairs = std::min(count, m);
+		result.values.resize(numPairs);
+		result.vectors.assign(numPairs, std::vector<double>(n, 0));
+		for (int k = 0; k < numPairs; k++) {
+			const double* s = &z[static_cast<std::size_t>(ritz[k]) * m];
+			auto& vector = result.vectors[k];
+			for (int j = 0; j < m; j++) {
+				for (int i = 0; i < n; i++) vector[i] += s[j] * Q[j][i];
+			}
+			for (int i = 0; i < n; i++) vector[i] /= sqrtM[i]; // u = M^-½·y
+			result.values[k] = 1 / theta[ritz[k]] - sigma;
+		}
+		return true;
+	}
+}
+
+int usage() {
+	std::fprintf(stderr, "usage: mesh_modes <mesh.obj|mesh.ply|mesh.txt> <out.modes> [--modes n] [--boundary clamped|free]\n");
+	return 1;
+}
+
+int run(const Options& options) {
+	const auto start = std::chrono::steady_clock::now();
+	Mesh mesh;
+	if (!readMesh(options.meshFile, mesh)) {
+		std::fprintf(stderr, "cannot read %s\n", options.meshFile.c_str());
+		return 1;
+	}
+	std::fprintf(stderr, "%zu vertices, %zu %s\n", mesh.vertices.size(), mesh.elements.size(), mesh.verticesPerElement == 3 ? "triangles" : "tetrahedra");
+
+	SparseMatrix fullK;
+	std::vector<double> fullM;
+	const int degenerate = assemble(mesh, fullK, fullM);
+	if (degenerate > 0) std::fprintf(stderr, "skipped %d degenerate elements\n", degenerate);
+
+	// degrees of freedom: vertices of elements, without the boundary if it is clamped
+	const auto boundary = boundaryVertices(mesh);
+	const int numVertices = static_cast<int>(mesh.vertices.size());
+	std::vector<int> dof(numVertices, -1), vertexOf;
+	for (int v = 0; v < numVertices; v++) {
+		if (fullM[v] > 0 && !(options.clamped && boundary[v])) {
+			dof[v] = static_cast<int>(vertexOf.size());
+			vertexOf.push_back(v);
+		}
+	}
+	const int n = static_cast<int>(vertexOf.size());
+	if (n == 0) {
+		std::fprintf(stderr, "no interior vertices\n");
+		return 1;
+	}
+	SparseMatrix K;
+	K.rows.resize(n);
+	std::vector<double> M(n);
+	for (int i = 0; i < n; i++) {
+		M[i] = fullM[vertexOf[i]];
+		for (const auto& [j, value] : fullK.rows[vertexOf[i]]) {
+			if (dof[j] >= 0) K.rows[i].push_back({ dof[j], value });
+		}
+	}
+
+	// a free boundary has one constant mode per connected part, shift them away from 0
+	int numConstant = 0;
+	double sigma = 0;
+	double diameter = 0;
+	{
+		Vec3 lo = mesh.vertices[0], hi = mesh.vertices[0];
+		for (const auto& v : mesh.vertices) {
+			for (int a = 0; a < 3; a++) {
+				lo[a] = std::min(lo[a], v[a]);
+				hi[a] = std::max(hi[a], v[a]);
+			}
+		}
+		diameter = std::sqrt(dot(sub(hi, lo), sub(hi, lo)));
+	}
+	if (!options.clamped) {
+		std::vector<int> part(n, -1);
+		for (int s = 0; s < n; s++) {
+			if (part[s] >= 0) continue;
+			std::vector<int> stack{ s };
+			part[s] = numConstant;
+			while (!stack.empty()) {
+				const int u = stack.back();
+				stack.pop_back();
+				for (const auto& entry : K.rows[u]) {
+					if (part[entry.first] < 0) {
+						part[entry.first] = numConstant;
+						stack.push_back(entry.first);
+					}
+				}
+			}
+			numConstant++;
+		}
+		sigma = 1e-2 / (diameter * diameter); // far below the lowest non-zero λ ~ (π/diameter)²
+	}
+
+	EigenPairs pairs;
+	if (!lanczos(K, M, sigma, options.modes + numConstant, pairs)) {
+		std::fprintf(stderr, "the stiffness matrix is singular (clamped boundary without interior?)\n");
+		return 1;
+	}
+	std::fprintf(stderr, "%d Lanczos steps, %d of %d modes converged\n", pairs.steps, pairs.converged, options.modes + numConstant);
+
+	// table, normalized to a mean square of 2^-d
+	const int d = mesh.verticesPerElement == 3 ? 2 : 3;
+	const double measure = std::accumulate(fullM.begin(), fullM.end(), 0.0);
+	const double scale = std::sqrt(measure / std::pow(2.0, d));
+	const int numModes = static_cast<int>(pairs.values.size()) - numConstant;
+	MeshModeTable table;
+	table.verticesPerElement = mesh.verticesPerElement;
+	for (const auto& v : mesh.vertices) table.vertices.push_back({ float(v[0]), float(v[1]), float(v[2]) });
+	for (const auto& e : mesh.elements) {
+		for (int k = 0; k < mesh.verticesPerElement; k++) table.elements.push_back(static_cast<std::uint32_t>(e[k]));
+	}
+	table.values.assign(static_cast<std::size_t>(numVertices) * numModes, 0);
+	for (int mode = 0; mode < numModes; mode++) {
+		const auto& vector = pairs.vectors[mode + numConstant];
+		// sign convention: the largest value is positive
+		const double largest = *std::max_element(vector.begin(), vector.end(), [](double a, double b) { return std::abs(a) < std::abs(b); });
+		const double sign = largest < 0 ? -1 : 1;
+		table.eigenvalues.push_back(pairs.values[mode + numConstant]);
+		for (int i = 0; i < n; i++) {
+			table.values[static_cast<std::size_t>(vertexOf[i]) * numModes + mode] = static_cast<float>(sign * scale * vector[i]);
+		}
+	}
+	if (!table.save(options.outFile)) {
+		std::fprintf(stderr, "cannot write %s\n", options.outFile.c_str());
+		return 1;
+	}
+
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::fprintf(stderr, "%d modes in %.2f s, k/k0:", numModes, seconds);
+	for (int mode = 0; mode < std::min(numModes, 8); mode++) {
+		std::fprintf(stderr, " %.4f", std::sqrt(table.eigenvalues[mode] / table.eigenvalues[0]));
+	}
+	std::fprintf(stderr, numModes > 8 ? " ...\n" : "\n");
+	return 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+	if (argc < 3) return usage();
+	Options options;
+	options.meshFile = argv[1];
+	options.outFile = argv[2];
+	for (int i = 3; i < argc; i++) {
+		const char* arg = argv[i];
+		if (i + 1 >= argc) return usage();
+		const char* value = argv[++i];
+		if (!std::strcmp(arg, "--modes")) options.modes = std::max(1, std::atoi(value));
+		else if (!std::strcmp(arg, "--boundary") && !std::strcmp(value, "clamped")) options.clamped = true;
+		else if (!std::strcmp(arg, "--boundary") && !std::strcmp(value, "free")) options.clamped = false;
+		else return usage();
+	}
+	return run(options);
+}
@@ -0,0 +1,215 @@
+﻿// -----------------------------------------------------------------------------------------------------------------------------
+// This file is part of the Überton project. Copyright (C) 2021 Überton
+//
+// Überton is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+// Überton is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details. You should
+// have received a copy of the GNU General Public License along with Überton. If not, see http://www.gnu.org/licenses/.
+// -----------------------------------------------------------------------------------------------------------------------------
+
+// Dumps the mode table of a resonator configuration as CSV or JSON.
+//
+// The resonator is set up like in the plugins (string, precomputed cube as in Tesseract or n-sphere
+// as in Hypersphere, maximum order 200, stereo) and for each of the first order modes the
+// eigenvalue k, the frequency, the T60 decay time, whether it is above the Nyquist frequency and
+// the coupling (|eigenfunction|) at the input and output positions are printed. A summary with
+// the number of audible modes is written to stderr.
+//
+// Usage: mode_table <string|cube|nsphere> [options]
+//   --dim d              dimension (cube: 1-10, nsphere: 2-10)              default 3
+//   --order n            number of modes (1-200)                           default 128
+//   --freq f             base frequency in Hz                              default 100
+//   --damp b             dampening                                         default 1
+//   --vel c              velocity                                          default 343
+//   --rate fs            sample rate in Hz                                 default 44100
+//   --in x,y,...         input position, given once per channel (L, R)
+//   --out x,y,...        output position, given once per channel (L, R)
+//   --format csv|json                                                      default csv
+//
+// Positions are normalized coordinates for string and cube and (r, φ, ϑ₁, ...) for the n-sphere.
+// Missing coordinates are filled with the defaults.
+
+#include <resonator.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace Uberton {
+namespace Math {
+template<class T, int maxDim, int maxOrder>
+CubeEWPStorage<T, maxDim> getCubeEWPStorage();
+}
+}
+
+using namespace Uberton::Math;
+
+namespace {
+
+constexpr int maxOrder = 200;
+constexpr int maxDimension = 10;
+constexpr int channels = 2;
+
+struct Options
+{
+	std::string shape;
+	int dim{ 3 };
+	int order{ 128 };
+	float freq{ 100 };
+	float damp{ 1 };
+	float vel{ 343 };
+	float sampleRate{ 44100 };
+	std::vector<std::vector<float>> in, out;
+	bool json{ false };
+};
+
+std::vector<float> parseVector(const char* text) {
+	std::vector<float> result;
+	std::stringstream stream(text);
+	std::string item;
+	while (std::getline(stream, item, ',')) {
+		result.push_back(float(std::atof(item.c_str())));
+	}
+	return result;
+}
+
+template<class Vec>
+Vec makePosition(const std::vector<std::vector<float>>& given, int ch, const Vec& defaults) {
+	Vec result = defaults;
+	if (ch < static_cast<int>(given.size())) {
+		for (int j = 0; j < std::min(static_cast<int>(given[ch].size()), static_cast<int>(result.size())); j++) {
+			result[j] = given[ch][j];
+		}
+	}
+	return result;
+}
+
+template<class Resonator>
+void configure(Resonator& r, const Options& options, const typename Resonator::SpaceVec (&defaults)[4]) {
+	using SpaceVec = typename Resonator::SpaceVec;
+	r.setSampleRate(options.sampleRate);
+	r.setFreqDampeningAndVelocity(options.freq, options.damp, options.vel);
+	r.setOrder(options.order);
+	std::array<SpaceVec, channels> in, out;
+	for (int ch = 0; ch < channels; ch++) {
+		in[ch] = makePosition(options.in, ch, defaults[ch]);
+		out[ch] = makePosition(options.out, ch, defaults[2 + ch]);
+	}
+	r.setInputPositions(in);
+	r.setOutputPositions(out);
+}
+
+template<class Resonator>
+void print(const Resonator& r, const Options& options) {
+	const int order = r.order();
+	int audible = 0;
+	if (options.json) {
+		std::printf("{\n  \"shape\": \"%s\", \"dim\": %d, \"order\": %d, \"freq\": %g, \"damp\": %g, \"vel\": %g, \"sampleRate\": %g,\n  \"modes\": [\n",
+					options.shape.c_str(), options.dim, order, options.freq, options.damp, options.vel, options.sampleRate);
+	}
+	else {
+		std::printf("index,k,frequency,decay_time,above_nyquist,in_l,in_r,out_l,out_r\n");
+	}
+	for (int i = 0; i < order; i++) {
+		const auto m = r.modeInfo(i);
+		if (!m.aboveNyquist) ++audible;
+		if (options.json) {
+			// JSON has no infinity, undamped modes get null
+			char decay[32] = "null";
+			if (std::isfinite(m.decayTime)) std::snprintf(decay, sizeof(decay), "%.6g", m.decayTime);
+			std::printf("    { \"index\": %d, \"k\": %.6g, \"frequency\": %.6g, \"decayTime\": %s, \"aboveNyquist\": %s, \"in\": [%.6g, %.6g], \"out\": [%.6g, %.6g] }%s\n",
+						i, m.k, m.frequency, decay, m.aboveNyquist ? "true" : "false",
+						m.inputCoupling[0], m.inputCoupling[1], m.outputCoupling[0], m.outputCoupling[1], i + 1 < order ? "," : "");
+		}
+		else {
+			std::printf("%d,%.6g,%.6g,%.6g,%d,%.6g,%.6g,%.6g,%.6g\n", i, m.k, m.frequency, m.decayTime, m.aboveNyquist ? 1 : 0,
+						m.inputCoupling[0], m.inputCoupling[1], m.outputCoupling[0], m.outputCoupling[1]);
+		}
+	}
+	if (options.json) {
+		std::printf("  ]\n}\n");
+	}
+	std::fprintf(stderr, "%d modes, %d below and %d above the Nyquist frequency\n", order, audible, order - audible);
+}
+
+void runString(const Options& options) {
+	using Resonator = StringResonator<float, maxOrder, channels>;
+	using V = Resonator::SpaceVec;
+	auto r = std::make_unique<Resonator>();
+	const V defaults[4] = { V{ .3f }, V{ .6f }, V{ .7f }, V{ .15f } };
+	configure(*r, options, defaults);
+	print(*r, options);
+}
+
+void runCube(const Options& options) {
+	using Resonator = PreComputedCubeResonator<float, maxDimension, maxOrder, channels>;
+	using V = Resonator::SpaceVec;
+	auto r = std::make_unique<Resonator>();
+	r->setStorage(getCubeEWPStorage<float, maxDimension, maxOrder>());
+	r->setDim(options.dim);
+	V defaults[4];
+	for (int j = 0; j < maxDimension; j++) {
+		defaults[0][j] = .3f + .04f * j, defaults[1][j] = .6f - .04f * j;
+		defaults[2][j] = .7f - .05f * j, defaults[3][j] = .15f + .06f * j;
+	}
+	configure(*r, options, defaults);
+	print(*r, options);
+}
+
+void runNSphere(const Options& options) {
+	using Resonator = NSphereResonator<float, maxDimension, maxOrder, channels>;
+	using V = Resonator::SpaceVec;
+	auto r = std::make_unique<Resonator>();
+	r->setDim(options.dim);
+	V defaults[4];
+	for (int ch = 0; ch < 4; ch++) {
+		defaults[ch][0] = ch < 2 ? .5f : .8f; // radius relative to the sphere
+		defaults[ch][1] = 1.f + ch;			 // φ
+		for (int j = 2; j < maxDimension; j++) {
+			defaults[ch][j] = .5f + .5f * ch + .1f * j; // ϑ strictly between 0 and π
+		}
+	}
+	configure(*r, options, defaults);
+	print(*r, options);
+}
+
+int usage() {
+	std::fprintf(stderr, "usage: mode_table <string|cube|nsphere> [--dim d] [--order n] [--freq f] [--damp b] [--vel c] [--rate fs]\n"
+						 "                  [--in x,y,...] [--out x,y,...] [--format csv|json]\n");
+	return 1;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+	if (argc < 2) return usage();
+	Options options;
+	options.shape = argv[1];
+	for (int i = 2; i < argc; i++) {
+		const char* arg = argv[i];
+		if (i + 1 >= argc) return usage();
+		const char* value = argv[++i];
+		if (!std::strcmp(arg, "--dim")) options.dim = std::atoi(value);
+		else if (!std::strcmp(arg, "--order")) options.order = std::atoi(value);
+		else if (!std::strcmp(arg, "--freq")) options.freq = float(std::atof(value));
+		else if (!std::strcmp(arg, "--damp")) options.damp = float(std::atof(value));
+		else if (!std::strcmp(arg, "--vel")) options.vel = float(std::atof(value));
+		else if (!std::strcmp(arg, "--rate")) options.sampleRate = float(std::atof(value));
+		else if (!std::strcmp(arg, "--in")) options.in.push_back(parseVector(value));
+		else if (!std::strcmp(arg, "--out")) options.out.push_back(parseVector(value));
+		else if (!std::strcmp(arg, "--format")) options.json = !std::strcmp(value, "json");
+		else return usage();
+	}
+
+	if (options.shape == "string") runString(options);
+	else if (options.shape == "cube") runCube(options);
+	else if (options.shape == "nsphere") runNSphere(options);
+	else return usage();
+	return 0;
+}
@@ -0,0 +1,206 @@
+﻿// -----------------------------------------------------------------------------------------------------------------------------
+// This file is part of the Überton project. Copyright (C) 2021 Überton
+//
+// Überton is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+// Überton is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details. You should
+// have received a copy of the GNU General Public License along with Überton. If not, see http://www.gnu.org/licenses/.
+// -----------------------------------------------------------------------------------------------------------------------------
+
+// Checks the multithreaded resonator bank and the resonator network against a plain resonator.
+//
+// A stereo cube with a few thousand modes is excited by a noise burst and run through a
+// ParallelResonatorBank with one thread and with several threads (the bank uses at most one per
+// hardware thread, so on a single core both run inline), the outputs are compared with delta()
+// and next() of a single resonator. Between two halves of the signal the bank is left
+// idle and the CPU time used by the process in the meantime is measured, the blocked workers
+// should use none. Then a string and a cube are coupled in a ResonatorNetwork (with the fused
+// single pass per resonator) and compared with the same coupling written out with delta() and
+// next(). The processing times are printed.
+//
+// Usage: parallel_check [threads] [seconds]
+//
+// Returns 1 if a relative error exceeds the float tolerance or the idle workers use CPU time.
+
+#include <parallel_resonator.h>
+#include <resonator_network.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace Uberton;
+using namespace Uberton::Math;
+
+namespace {
+
+constexpr float sampleRate = 48000;
+constexpr int blockSize = 256;
+constexpr int burstLength = 4800;
+constexpr double tolerance = 1e-4;	 // relative RMS error, float with a different summation order
+constexpr double maxIdleTime = 5e-3; // CPU seconds while idle
+
+using Clock = std::chrono::steady_clock;
+
+template<int d, class Resonator>
+void configure(Resonator& r, float freq) {
+	r.setSampleRate(sampleRate);
+	r.setFreqDampeningAndVelocity(freq, 1, 343);
+	Vector<float, d> in0, in1, out0, out1;
+	for (int j = 0; j < d; j++) {
+		in0[j] = .3f + .1f * j, in1[j] = .6f - .1f * j;
+		out0[j] = .7f - .15f * j, out1[j] = .15f + .2f * j;
+	}
+	if constexpr (Resonator::numChannels() == 1) {
+		r.setInputPositions({ in0 });
+		r.setOutputPositions({ out0 });
+	}
+	else {
+		r.setInputPositions({ in0, in1 });
+		r.setOutputPositions({ out0, out1 });
+	}
+	r.clear();
+}
+
+double relativeError(const std::vector<float>& output, const std::vector<float>& expected) {
+	double error = 0, energy = 0;
+	for (size_t i = 0; i < output.size(); i++) {
+		const double diff = double(output[i]) - expected[i];
+		error += diff * diff;
+		energy += double(expected[i]) * expected[i];
+	}
+	if (!(energy > 0 && energy < 1e30)) return INFINITY; // silent or unstable
+	return std::sqrt(error / energy);
+}
+
+bool checkBank(int numThreads, int numSamples) {
+	using Resonator = CubeResonator<float, 3, 4096, 2>;
+	std::mt19937 generator(1);
+	std::normal_distribution<float> noise;
+	std::vector<float> input[2], expected[2];
+	for (int ch = 0; ch < 2; ch++) {
+		input[ch].assign(numSamples, 0);
+		expected[ch].resize(numSamples);
+		for (int i = 0; i < std::min(burstLength, numSamples); i++) input[ch][i] = noise(generator);
+	}
+
+	auto reference = std::make_unique<Resonator>();
+	configure<3>(*reference, 30);
+	const auto t0 = Clock::now();
+	for (int i = 0; i < numSamples; i++) {
+		reference->delta({ input[0][i], input[1][i] });
+		const auto y = reference->next();
+		expected[0][i] = y[0], expected[1][i] = y[1];
+	}
+	const double referenceTime = std::chrono::duration<double>(Clock::now() - t0).count();
+	std::printf("bank: %d modes, single resonator %.1f ms\n", reference->order(), referenceTime * 1e3);
+
+	bool ok = true;
+	for (int threads : { 1, numThreads }) {
+		ParallelResonatorBank<Resonator> bank(threads, blockSize);
+		configure<3>(bank.resonator(), 30);
+		std::vector<float> output[2] = { std::vector<float>(numSamples), std::vector<float>(numSamples) };
+		const int half = numSamples / 2 / blockSize * blockSize;
+		double time = 0, idleTime = 0;
+		for (int offset : { 0, half }) {
+			const int length = offset == 0 ? half : numSamples - half;
+			const float* in[] = { input[0].data() + offset, input[1].data() + offset };
+			float* out[] = { output[0].data() + offset, output[1].data() + offset };
+			const auto t1 = Clock::now();
+			for (int n = 0; n < length; n += blockSize) {
+				const float* blockIn[] = { in[0] + n, in[1] + n };
+				float* blockOut[] = { out[0] + n, out[1] + n };
+				bank.process(blockIn, blockOut, std::min(blockSize, length - n));
+			}
+			time += std::chrono::duration<double>(Clock::now() - t1).count();
+			if (offset == 0) {
+				// workers give up napping after 50 ms and block
+				std::this_thread::sleep_for(std::chrono::milliseconds(200));
+				const std::clock_t c0 = std::clock();
+				std::this_thread::sleep_for(std::chrono::milliseconds(500));
+				idleTime = double(std::clock() - c0) / CLOCKS_PER_SEC;
+			}
+		}
+		const double error = std::max(relativeError(output[0], expected[0]), relativeError(output[1], expected[1]));
+		const bool passed = error <= tolerance && idleTime <= maxIdleTime;
+		std::printf("  %d thread%s: error %.1e  time %6.1f ms (%.2fx)  idle CPU %.1f ms %s\n", bank.numThreads(), bank.numThreads() > 1 ? "s" : " ",
+					error, time * 1e3, referenceTime / time, idleTime * 1e3, passed ? "" : "FAILED");
+		ok &= passed;
+	}
+	return ok;
+}
+
+bool checkNetwork(int numSamples) {
+	using String = StringResonator<float, 100, 1>;
+	using Cube = CubeResonator<float, 3, 200, 2>;
+	using Network = ResonatorNetwork<String, Cube>;
+	constexpr float gain = 1e-4f;
+
+	auto network = std::make_unique<Network>();
+	configure<1>(network->resonator<0>(), 110);
+	configure<3>(network->resonator<1>(), 60);
+	network->connect(0, 1, gain); // string pickup -> first cube input
+	network->connect(2, 0, gain); // second cube pickup -> string
+
+	auto string = std::make_unique<String>();
+	auto cube = std::make_unique<Cube>();
+	configure<1>(*string, 110);
+	configure<3>(*cube, 60);
+
+	std::mt19937 generator(2);
+	std::normal_distribution<float> noise;
+	std::vector<Network::Frame> input(numSamples, Network::Frame{});
+	for (int i = 0; i < std::min(burstLength, numSamples); i++) input[i][0] = noise(generator);
+
+	std::vector<float> output[3], expected[3];
+	for (int ch = 0; ch < 3; ch++) {
+		output[ch].resize(numSamples);
+		expected[ch].resize(numSamples);
+	}
+
+	const auto t0 = Clock::now();
+	std::array<float, 1> s{};
+	std::array<float, 2> c{};
+	for (int i = 0; i < numSamples; i++) {
+		string->delta({ input[i][0] + gain * c[1] });
+		cube->delta({ input[i][1] + gain * s[0], input[i][2] });
+		s = string->next();
+		c = cube->next();
+		expected[0][i] = s[0], expected[1][i] = c[0], expected[2][i] = c[1];
+	}
+	const double referenceTime = std::chrono::duration<double>(Clock::now() - t0).count();
+
+	const auto t1 = Clock::now();
+	for (int i = 0; i < numSamples; i++) {
+		const auto y = network->next(input[i]);
+		for (int ch = 0; ch < 3; ch++) output[ch][i] = y[ch];
+	}
+	const double time = std::chrono::duration<double>(Clock::now() - t1).count();
+
+	double error = 0;
+	for (int ch = 0; ch < 3; ch++) error = std::max(error, relativeError(output[ch], expected[ch]));
+	const bool ok = error <= tolerance;
+	std::printf("network: error %.1e  delta/next %6.1f ms  fused %6.1f ms (%.2fx) %s\n", error, referenceTime * 1e3, time * 1e3, referenceTime / time, ok ? "" : "FAILED");
+	return ok;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+	const int numThreads = argc > 1 ? std::max(2, std::atoi(argv[1])) : std::max(2, WorkerPool::hardwareConcurrency());
+	const double seconds = argc > 2 ? std::atof(argv[2]) : 1.0;
+	const int numSamples = std::max(2 * burstLength, static_cast<int>(seconds * sampleRate));
+
+	bool ok = checkBank(numThreads, numSamples);
+	ok &= checkNetwork(numSamples);
+	return ok ? 0 : 1;
+}
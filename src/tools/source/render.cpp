@@ -0,0 +1,295 @@
+﻿// -----------------------------------------------------------------------------------------------------------------------------
+// This file is part of the Überton project. Copyright (C) 2021 Überton
+//
+// Überton is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+// Überton is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details. You should
+// have received a copy of the GNU General Public License along with Überton. If not, see http://www.gnu.org/licenses/.
+// -----------------------------------------------------------------------------------------------------------------------------
+
+// Offline rendering of a WAV file through a stereo resonator on all cores (see renderSegmented()).
+//
+// The resonator is set up like in mode_table (string, precomputed cube as in Tesseract or n-sphere
+// as in Hypersphere, maximum order 200). The input excites the two input positions (a mono file
+// excites both), the wet signal of the two output positions is written as 32 bit float WAV at the
+// sample rate of the input. With --verify the file is rendered serially as well and the largest
+// difference and both times are printed.
+//
+// Usage: render <string|cube|nsphere> <in.wav> <out.wav> [options]
+//   --dim d              dimension (cube: 1-10, nsphere: 2-10)              default 3
+//   --order n            number of modes (1-200)                           default 128
+//   --freq f             base frequency in Hz                              default 100
+//   --damp b             dampening                                         default 1
+//   --vel c              velocity                                          default 343
+//   --gain g             output gain                                       default .03/√order
+//   --tail s             seconds of silence appended to the input          default 0
+//   --threads t          number of threads                                 default all cores
+//   --verify             compare with serial rendering
+//
+// Input files can be 16, 24 or 32 bit PCM or 32 bit float.
+
+#include <segmented_render.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Uberton {
+namespace Math {
+template<class T, int maxDim, int maxOrder>
+CubeEWPStorage<T, maxDim> getCubeEWPStorage();
+}
+}
+
+using namespace Uberton::Math;
+
+namespace {
+
+constexpr int maxOrder = 200;
+constexpr int maxDimension = 10;
+constexpr int channels = 2;
+
+struct Options
+{
+	std::string shape, inFile, outFile;
+	int dim{ 3 };
+	int order{ 128 };
+	float freq{ 100 };
+	float damp{ 1 };
+	float vel{ 343 };
+	float gain{ 0 }; // 0: like Tesseract's volume compensation
+	float tail{ 0 };
+	int threads{ static_cast<int>(std::max(1u, std::thread::hardware_concurrency())) };
+	bool verify{ false };
+};
+
+struct Audio
+{
+	int sampleRate{ 0 };
+	std::vector<std::vector<float>> channels;
+};
+
+std::uint32_t readLE(const unsigned char* p, int bytes) {
+	std::uint32_t value = 0;
+	for (int i = 0; i < bytes; i++) value |= std::uint32_t(p[i]) << (8 * i);
+	return value;
+}
+
+bool readWav(const std::string& path, Audio& audio) {
+	std::ifstream file(path, std::ios::binary);
+	std::vector<unsigned char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	if (data.size() < 12 || std::memcmp(data.data(), "RIFF", 4) || std::memcmp(data.data() + 8, "WAVE", 4)) return false;
+
+	int format = 0, numChannels = 0, bits = 0;
+	for (std::size_t pos = 12; pos + 8 <= data.size();) {
+		const std::size_t size = readLE(&data[pos + 4], 4);
+		const unsigned char* chunk = &data[pos + 8];
+		if (pos + 8 + size > data.size()) return false;
+		if (!std::memcmp(&data[pos], "fmt ", 4) && size >= 16) {
+			format = readLE(chunk, 2);
+			numChannels = readLE(chunk + 2, 2);
+			audio.sampleRate = readLE(chunk + 4, 4);
+			bits = readLE(chunk + 14, 2);
+			if (format == 0xFFFE && size >= 26) format = readLE(chunk + 24, 2); // WAVE_FORMAT_EXTENSIBLE
+		}
+		else if (!std::memcmp(&data[pos], "data", 4)) {
+			const bool isFloat = format == 3 && bits == 32;
+			const bool isPCM = format == 1 && (bits == 16 || bits == 24 || bits == 32);
+			if (numChannels <= 0 || !(isFloat || isPCM)) return false;
+			const int bytes = bits / 8;
+			const std::size_t frames = size / (bytes * numChannels);
+			audio.channels.assign(numChannels, std::vector<float>(frames));
+			for (std::size_t n = 0; n < frames; n++) {
+				for (int ch = 0; ch < numChannels; ch++) {
+					const std::uint32_t raw = readLE(chunk + (n * numChannels + ch) * bytes, bytes);
+					float value;
+					if (isFloat) {
+						std::memcpy(&value, &raw, 4);
+					}
+					else {
+						const int shift = 32 - bits; // sign extension
+						value = float(std::int32_t(raw << shift) >> shift) / float(std::uint32_t(1) << (bits - 1));
+					}
+					audio.channels[ch][n] = value;
+				}
+			}
+			return true;
+		}
+		pos += 8 + size + (size & 1);
+	}
+	return false;
+}
+
+void writeLE(std::ofstream& file, std::uint32_t value, int bytes) {
+	for (int i = 0; i < bytes; i++) file.put(static_cast<char>((value >> (8 * i)) & 0xFF));
+}
+
+bool writeWav(const std::string& path, const Audio& audio) {
+	std::ofstream file(path, std::ios::binary);
+	if (!file) return false;
+	const int numChannels = static_cast<int>(audio.channels.size());
+	const std::uint32_t frames = static_cast<std::uint32_t>(audio.channels[0].size());
+	const std::uint32_t dataSize = frames * numChannels * 4;
+	file.write("RIFF", 4);
+	writeLE(file, 36 + dataSize, 4);
+	file.write("WAVEfmt ", 8);
+	writeLE(file, 16, 4);
+	writeLE(file, 3, 2); // IEEE float
+	writeLE(file, numChannels, 2);
+	writeLE(file, audio.sampleRate, 4);
+	writeLE(file, audio.sampleRate * numChannels * 4, 4);
+	writeLE(file, numChannels * 4, 2);
+	writeLE(file, 32, 2);
+	file.write("data", 4);
+	writeLE(file, dataSize, 4);
+	for (std::uint32_t n = 0; n < frames; n++) {
+		for (int ch = 0; ch < numChannels; ch++) {
+			std::uint32_t raw;
+			std::memcpy(&raw, &audio.channels[ch][n], 4);
+			writeLE(file, raw, 4);
+		}
+	}
+	return bool(file);
+}
+
+template<class Resonator>
+int render(Resonator& r, const Options& options, const typename Resonator::SpaceVec (&positions)[4]) {
+	Audio input;
+	if (!readWav(options.inFile, input)) {
+		std::fprintf(stderr, "cannot read %s (16/24/32 bit PCM or 32 bit float WAV)\n", options.inFile.c_str());
+		return 1;
+	}
+	const std::int64_t numSamples = static_cast<std::int64_t>(input.channels[0].size()) + std::int64_t(options.tail * input.sampleRate);
+	for (auto& channel : input.channels) channel.resize(numSamples);
+
+	r.setSampleRate(float(input.sampleRate));
+	r.setFreqDampeningAndVelocity(options.freq, options.damp, options.vel);
+	r.setOrder(options.order);
+	r.setInputPositions({ positions[0], positions[1] });
+	r.setOutputPositions({ positions[2], positions[3] });
+
+	const float* in[channels] = { input.channels[0].data(), input.channels[std::min<std::size_t>(1, input.channels.size() - 1)].data() };
+	Audio output;
+	output.sampleRate = input.sampleRate;
+	output.channels.assign(channels, std::vector<float>(numSamples));
+	float* out[channels] = { output.channels[0].data(), output.channels[1].data() };
+
+	using Clock = std::chrono::steady_clock;
+	const auto t0 = Clock::now();
+	const auto stats = renderSegmented(r, in, out, numSamples, options.threads);
+	const double seconds = std::chrono::duration<double>(Clock::now() - t0).count();
+	std::fprintf(stderr, "%lld samples in %.2f s (%.0fx real time), %d segments, %lld tail samples\n",
+				 (long long)numSamples, seconds, numSamples / (seconds * input.sampleRate), stats.segments, (long long)stats.tailSamples);
+
+	if (options.verify) {
+		std::vector<std::vector<float>> serial(channels, std::vector<float>(numSamples));
+		float* serialOut[channels] = { serial[0].data(), serial[1].data() };
+		const auto t1 = Clock::now();
+		renderSegmented(r, in, serialOut, numSamples, 1);
+		const double serialSeconds = std::chrono::duration<double>(Clock::now() - t1).count();
+		double maxDiff = 0, peak = 0;
+		for (int ch = 0; ch < channels; ch++) {
+			for (std::int64_t n = 0; n < numSamples; n++) {
+				maxDiff = std::max(maxDiff, double(std::abs(serial[ch][n] - out[ch][n])));
+				peak = std::max(peak, double(std::abs(serial[ch][n])));
+			}
+		}
+		std::fprintf(stderr, "serial %.2f s (speedup %.1fx), max difference %g (peak %g)\n", serialSeconds, serialSeconds / seconds, maxDiff, peak);
+	}
+
+	const float gain = options.gain != 0 ? options.gain : .03f / std::sqrt(float(r.order()));
+	for (auto& channel : output.channels) {
+		for (auto& sample : channel) sample *= gain;
+	}
+	if (!writeWav(options.outFile, output)) {
+		std::fprintf(stderr, "cannot write %s\n", options.outFile.c_str());
+		return 1;
+	}
+	return 0;
+}
+
+int runString(const Options& options) {
+	using Resonator = StringResonator<float, maxOrder, channels>;
+	using V = Resonator::SpaceVec;
+	auto r = std::make_unique<Resonator>();
+	const V positions[4] = { V{ .3f }, V{ .6f }, V{ .7f }, V{ .15f } };
+	return render(*r, options, positions);
+}
+
+int runCube(const Options& options) {
+	using Resonator = PreComputedCubeResonator<float, maxDimension, maxOrder, channels>;
+	using V = Resonator::SpaceVec;
+	auto r = std::make_unique<Resonator>();
+	r->setStorage(getCubeEWPStorage<float, maxDimension, maxOrder>());
+	r->setDim(options.dim);
+	V positions[4];
+	for (int j = 0; j < maxDimension; j++) {
+		positions[0][j] = .3f + .04f * j, positions[1][j] = .6f - .04f * j;
+		positions[2][j] = .7f - .05f * j, positions[3][j] = .15f + .06f * j;
+	}
+	return render(*r, options, positions);
+}
+
+int runNSphere(const Options& options) {
+	using Resonator = NSphereResonator<float, maxDimension, maxOrder, channels>;
+	using V = Resonator::SpaceVec;
+	auto r = std::make_unique<Resonator>();
+	r->setDim(options.dim);
+	V positions[4];
+	for (int ch = 0; ch < 4; ch++) {
+		positions[ch][0] = ch < 2 ? .5f : .8f; // radius relative to the sphere
+		positions[ch][1] = 1.f + ch;		   // φ
+		for (int j = 2; j < maxDimension; j++) {
+			positions[ch][j] = .5f + .5f * ch + .1f * j; // ϑ strictly between 0 and π
+		}
+	}
+	return render(*r, options, positions);
+}
+
+int usage() {
+	std::fprintf(stderr, "usage: render <string|cube|nsphere> <in.wav> <out.wav> [--dim d] [--order n] [--freq f] [--damp b] [--vel c]\n"
+						 "              [--gain g] [--tail s] [--threads t] [--verify]\n");
+	return 1;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+	if (argc < 4) return usage();
+	Options options;
+	options.shape = argv[1];
+	options.inFile = argv[2];
+	options.outFile = argv[3];
+	for (int i = 4; i < argc; i++) {
+		const char* arg = argv[i];
+		if (!std::strcmp(arg, "--verify")) {
+			options.verify = true;
+			continue;
+		}
+		if (i + 1 >= argc) return usage();
+		const char* value = argv[++i];
+		if (!std::strcmp(arg, "--dim")) options.dim = std::atoi(value);
+		else if (!std::strcmp(arg, "--order")) options.order = std::atoi(value);
+		else if (!std::strcmp(arg, "--freq")) options.freq = float(std::atof(value));
+		else if (!std::strcmp(arg, "--damp")) options.damp = float(std::atof(value));
+		else if (!std::strcmp(arg, "--vel")) options.vel = float(std::atof(value));
+		else if (!std::strcmp(arg, "--gain")) options.gain = float(std::atof(value));
+		else if (!std::strcmp(arg, "--tail")) options.tail = float(std::atof(value));
+		else if (!std::strcmp(arg, "--threads")) options.threads = std::max(1, std::atoi(value));
+		else return usage();
+	}
+
+	if (options.shape == "string") return runString(options);
+	if (options.shape == "cube") return runCube(options);
+	if (options.shape == "nsphere") return runNSphere(options);
+	return usage();
+}
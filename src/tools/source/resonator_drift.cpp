@@ -0,0 +1,107 @@
+﻿// -----------------------------------------------------------------------------------------------------------------------------
+// This file is part of the Überton project. Copyright (C) 2021 Überton
+//
+// Überton is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+// Überton is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details. You should
+// have received a copy of the GNU General Public License along with Überton. If not, see http://www.gnu.org/licenses/.
+// -----------------------------------------------------------------------------------------------------------------------------
+
+// Long-run drift test of the float modal recursion.
+//
+// An undamped (or weakly damped) float resonator is struck once and then runs freely for the given
+// number of hours, with periodic resynchronization once sample by sample with next() (as the
+// plugins do) and once in blocks with processModes(), and without resynchronization. Every
+// simulated half hour the mode amplitudes are compared to the exact solution a₀·exp(iωt), using
+// the resonator's own ω and Δt so that only the accumulated rounding error is measured. The
+// worst magnitude error (in dB) and phase error (in rad) over all modes are printed.
+//
+// Usage: resonator_drift [hours] [dampening]
+
+#include <resonator.h>
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace Uberton::Math;
+
+namespace {
+
+constexpr int order = 16;
+constexpr float sampleRate = 44100;
+constexpr int blockSize = 4096;
+constexpr int resyncInterval = 4096;
+
+using Resonator = StringResonator<float, order, 1>;
+using Complex = std::complex<double>;
+
+struct Drift
+{
+	double magnitudeDb{ 0 };
+	double phase{ 0 };
+};
+
+Drift measure(const Resonator& r, const std::vector<Complex>& start, int64_t n) {
+	Drift drift;
+	const double t = double(r.deltaT) * n;
+	for (int i = 0; i < order; i++) {
+		const Complex exact = start[i] * std::exp(Complex(0, 1) * Complex(r.frequencies[i]) * t);
+		const Complex ratio = Complex(r.amplitudes[i]) / exact;
+		drift.magnitudeDb = std::max(drift.magnitudeDb, std::abs(20 * std::log10(std::abs(ratio))));
+		drift.phase = std::max(drift.phase, std::abs(std::arg(ratio)));
+	}
+	return drift;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+	const double hours = argc > 1 ? std::atof(argv[1]) : 1;
+	const float dampening = argc > 2 ? float(std::atof(argv[2])) : 0;
+	const int64_t numSamples = int64_t(hours * 3600 * sampleRate);
+	const int64_t reportInterval = int64_t(1800 * sampleRate) / blockSize * blockSize;
+
+	std::vector<Resonator> resonators(3);
+	for (auto& r : resonators) {
+		r.setSampleRate(sampleRate);
+		r.setFreqDampeningAndVelocity(110, dampening, 343);
+		r.setInputPositions({ Vector<float, 1>{ .31f } });
+		r.setOutputPositions({ Vector<float, 1>{ .77f } });
+		r.delta({ 1 });
+	}
+	resonators[0].setResyncInterval(resyncInterval);
+	resonators[1].setResyncInterval(resyncInterval);
+	const std::vector<Complex> start(resonators[0].amplitudes.begin(), resonators[0].amplitudes.end());
+
+	std::vector<float> silence(blockSize), output(blockSize);
+	const float* in[] = { silence.data() };
+	float* out[] = { output.data() };
+
+	std::printf("%8s  %-28s  %-28s  %-28s\n", "hours", "next(), resync  (dB, rad)", "processModes(), resync", "no resync");
+	for (int64_t n = 0; n < numSamples;) {
+		const int blockLength = int(std::min<int64_t>(blockSize, numSamples - n));
+		for (int i = 0; i < blockLength; i++) {
+			resonators[0].next();
+		}
+		for (int k : { 1, 2 }) {
+			Resonator& r = resonators[k];
+			r.processModes(in, out, blockLength, 0, r.order());
+			r.finishModes(in, blockLength);
+		}
+		n += blockLength;
+		if (n % reportInterval == 0 || n == numSamples) {
+			std::printf("%8.2f", n / sampleRate / 3600);
+			for (const auto& r : resonators) {
+				const Drift drift = measure(r, start, n);
+				std::printf("  %12.3g  %12.3g  ", drift.magnitudeDb, drift.phase);
+			}
+			std::printf("\n");
+		}
+	}
+	return 0;
+}